@@ -0,0 +1,340 @@
+/** Benchmarks of the packet extraction and I/O paths
+ *
+ * Built as benchmark_Driver when google-benchmark is available. Use
+ * google-benchmark's own options to get machine-readable results, e.g.
+ *
+ * <code>
+ * benchmark_Driver --benchmark_format=json --benchmark_out=results.json
+ * benchmark_Driver --benchmark_filter=Extraction
+ * </code>
+ *
+ * Unless stated otherwise, the benchmark arguments are the packet size in
+ * bytes and the amount of garbage between the packets, in percent of the
+ * packet size.
+ */
+#include <benchmark/benchmark.h>
+
+#include <ros_driver_base/driver.hpp>
+#include <ros_driver_base/bus.hpp>
+#include <ros_driver_base/test_stream.hpp>
+
+#include <unistd.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+using namespace ros_driver_base;
+
+namespace
+{
+    static const uint8_t PACKET_START = 0xA5;
+    static const int PACKET_BUFFER_SIZE = 4096;
+    static const int BATCH_SIZE = 64;
+
+    /** Extraction of packets made of a start byte, a 16-bit little-endian
+     * size and a payload. Any other byte is garbage
+     */
+    int extractSizedPacket(uint8_t const* buffer, size_t buffer_size)
+    {
+        if (buffer[0] != PACKET_START)
+        {
+            uint8_t const* start = static_cast<uint8_t const*>(
+                    memchr(buffer, PACKET_START, buffer_size));
+            return start ? -(start - buffer) : -static_cast<int>(buffer_size);
+        }
+        else if (buffer_size < 3)
+            return 0;
+
+        size_t size = buffer[1] | (buffer[2] << 8);
+        if (buffer_size < size)
+            return 0;
+        return size;
+    }
+
+    struct BenchmarkDriver : public Driver
+    {
+        BenchmarkDriver(bool extract_last = false)
+            : Driver(PACKET_BUFFER_SIZE, extract_last) {}
+
+        int extractPacket(uint8_t const* buffer, size_t buffer_size) const
+        { return extractSizedPacket(buffer, buffer_size); }
+
+        using Driver::findPacket;
+    };
+
+    vector<uint8_t> makePacket(size_t size, uint8_t address = 0)
+    {
+        vector<uint8_t> packet(size, address);
+        packet[0] = PACKET_START;
+        packet[1] = size & 0xFF;
+        packet[2] = size >> 8;
+        return packet;
+    }
+
+    /** Returns \c count packets, each preceded by the given percentage of
+     * garbage
+     */
+    vector<uint8_t> makeStream(size_t packet_size, int garbage_percent, int count)
+    {
+        vector<uint8_t> packet = makePacket(packet_size);
+        size_t garbage_size = packet_size * garbage_percent / 100;
+        vector<uint8_t> stream;
+        for (int i = 0; i < count; ++i)
+        {
+            stream.insert(stream.end(), garbage_size, 0);
+            stream.insert(stream.end(), packet.begin(), packet.end());
+        }
+        return stream;
+    }
+
+    void setCounters(benchmark::State& state, size_t packet_size)
+    {
+        state.SetItemsProcessed(state.iterations());
+        state.SetBytesProcessed(state.iterations() * packet_size);
+    }
+
+    void extractionArguments(benchmark::internal::Benchmark* benchmark)
+    {
+        int const sizes[] = { 16, 256, 1024 };
+        int const garbage[] = { 0, 10, 100 };
+        for (int i = 0; i < 3; ++i)
+            for (int j = 0; j < 3; ++j)
+                benchmark->Args({ sizes[i], garbage[j] });
+    }
+
+    void sizeArguments(benchmark::internal::Benchmark* benchmark)
+    {
+        benchmark->Arg(16)->Arg(256)->Arg(1024);
+    }
+
+    /** Returns a socket bound to an ephemeral port on the loopback
+     * interface, and the port in \c addr
+     */
+    int bindLoopback(int type, sockaddr_in& addr)
+    {
+        int fd = socket(AF_INET, type, 0);
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t addr_size = sizeof(addr);
+        if (fd == -1
+                || bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1
+                || getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &addr_size) == -1)
+            throw std::runtime_error("cannot bind a loopback socket");
+        return fd;
+    }
+
+    void writeAll(int fd, vector<uint8_t> const& data)
+    {
+        if (write(fd, &data[0], data.size()) != static_cast<ssize_t>(data.size()))
+            throw std::runtime_error("failed to write the benchmark data");
+    }
+}
+
+/** findPacket on a buffer that starts with a packet */
+static void BM_FindPacket(benchmark::State& state)
+{
+    BenchmarkDriver driver;
+    vector<uint8_t> stream = makeStream(state.range(0), state.range(1), 1);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(driver.findPacket(&stream[0], stream.size()));
+    setCounters(state, state.range(0));
+}
+BENCHMARK(BM_FindPacket)->Apply(extractionArguments);
+
+/** readPacket on a TestStream, i.e. doPacketExtraction and the internal
+ * buffer handling without system calls
+ */
+static void BM_Extraction(benchmark::State& state)
+{
+    BenchmarkDriver driver;
+    driver.openTestMode();
+    TestStream* stream = dynamic_cast<TestStream*>(driver.getMainStream());
+    vector<uint8_t> data = makeStream(state.range(0), state.range(1), BATCH_SIZE);
+    vector<uint8_t> buffer(PACKET_BUFFER_SIZE);
+
+    int remaining = 0;
+    for (auto _ : state)
+    {
+        if (!remaining)
+        {
+            state.PauseTiming();
+            stream->pushDataToDriver(data);
+            remaining = BATCH_SIZE;
+            state.ResumeTiming();
+        }
+        benchmark::DoNotOptimize(driver.readPacket(&buffer[0], buffer.size(), ros::Duration(1)));
+        --remaining;
+    }
+    setCounters(state, state.range(0));
+}
+BENCHMARK(BM_Extraction)->Apply(extractionArguments);
+
+/** readPacket in extract-last mode, on batches of packets */
+static void BM_ExtractLast(benchmark::State& state)
+{
+    BenchmarkDriver driver(true);
+    driver.openTestMode();
+    TestStream* stream = dynamic_cast<TestStream*>(driver.getMainStream());
+    // Keep the batch within one read of the internal buffer
+    int count = std::max<int>(1, PACKET_BUFFER_SIZE / state.range(0) - 1);
+    vector<uint8_t> data = makeStream(state.range(0), 0, count);
+    vector<uint8_t> buffer(PACKET_BUFFER_SIZE);
+
+    for (auto _ : state)
+    {
+        stream->pushDataToDriver(data);
+        benchmark::DoNotOptimize(driver.readPacket(&buffer[0], buffer.size(), ros::Duration(1)));
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+    state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_ExtractLast)->Apply(sizeArguments);
+
+/** Write of a packet on a pipe, and readPacket on the other end */
+static void BM_Pipe(benchmark::State& state)
+{
+    int pipes[2];
+    if (pipe(pipes) == -1)
+        throw std::runtime_error("cannot create a pipe");
+    FileGuard tx(pipes[1]);
+    BenchmarkDriver driver;
+    driver.setFileDescriptor(pipes[0]);
+
+    vector<uint8_t> packet = makePacket(state.range(0));
+    vector<uint8_t> buffer(PACKET_BUFFER_SIZE);
+    for (auto _ : state)
+    {
+        writeAll(tx.get(), packet);
+        benchmark::DoNotOptimize(driver.readPacket(&buffer[0], buffer.size(), ros::Duration(1)));
+    }
+    setCounters(state, state.range(0));
+}
+BENCHMARK(BM_Pipe)->Apply(sizeArguments);
+
+/** Datagram sent on the loopback interface, and readPacket on the receiving
+ * socket
+ */
+static void BM_UDPLoopback(benchmark::State& state)
+{
+    sockaddr_in addr;
+    int rx = bindLoopback(SOCK_DGRAM, addr);
+    FileGuard tx(socket(AF_INET, SOCK_DGRAM, 0));
+    if (connect(tx.get(), reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1)
+        throw std::runtime_error("cannot connect the UDP socket");
+    BenchmarkDriver driver;
+    driver.setFileDescriptor(rx);
+
+    vector<uint8_t> packet = makePacket(state.range(0));
+    vector<uint8_t> buffer(PACKET_BUFFER_SIZE);
+    for (auto _ : state)
+    {
+        writeAll(tx.get(), packet);
+        benchmark::DoNotOptimize(driver.readPacket(&buffer[0], buffer.size(), ros::Duration(1)));
+    }
+    setCounters(state, state.range(0));
+}
+BENCHMARK(BM_UDPLoopback)->Apply(sizeArguments);
+
+/** Write on a TCP connection on the loopback interface, and readPacket on a
+ * driver opened with openTCP
+ */
+static void BM_TCPLoopback(benchmark::State& state)
+{
+    sockaddr_in addr;
+    FileGuard server(bindLoopback(SOCK_STREAM, addr));
+    if (listen(server.get(), 1) == -1)
+        throw std::runtime_error("cannot listen on the TCP socket");
+    BenchmarkDriver driver;
+    driver.openTCP("127.0.0.1", ntohs(addr.sin_port));
+    FileGuard tx(accept(server.get(), NULL, NULL));
+
+    vector<uint8_t> packet = makePacket(state.range(0));
+    vector<uint8_t> buffer(PACKET_BUFFER_SIZE);
+    for (auto _ : state)
+    {
+        writeAll(tx.get(), packet);
+        benchmark::DoNotOptimize(driver.readPacket(&buffer[0], buffer.size(), ros::Duration(1)));
+    }
+    setCounters(state, state.range(0));
+}
+BENCHMARK(BM_TCPLoopback)->Apply(sizeArguments);
+
+namespace
+{
+    /** Parser of the packets whose payload bytes are its address */
+    struct AddressedParser : public Parser
+    {
+        uint8_t address;
+        AddressedParser(Bus* bus, uint8_t address)
+            : Parser(bus), address(address) {}
+
+        int extractPacket(uint8_t const* buffer, size_t buffer_size) const
+        {
+            int result = extractSizedPacket(buffer, buffer_size);
+            if (result > 3 && buffer[3] != address)
+                return -result;
+            return result;
+        }
+    };
+}
+
+/** readPacket on a pipelined Bus with N parsers, for packets that belong
+ * to the last parser. The argument is the number of parsers
+ */
+static void BM_Bus(benchmark::State& state)
+{
+    Bus bus(PACKET_BUFFER_SIZE);
+    bus.openTestMode();
+    bus.setPipelined(true);
+    TestStream* stream = dynamic_cast<TestStream*>(bus.getMainStream());
+
+    vector<AddressedParser*> parsers;
+    for (int i = 0; i < state.range(0); ++i)
+    {
+        parsers.push_back(new AddressedParser(&bus, i + 1));
+        bus.addParser(parsers.back());
+    }
+
+    vector<uint8_t> packet = makePacket(64, state.range(0));
+    vector<uint8_t> data;
+    for (int i = 0; i < BATCH_SIZE; ++i)
+        data.insert(data.end(), packet.begin(), packet.end());
+    vector<uint8_t> buffer(PACKET_BUFFER_SIZE);
+
+    int remaining = 0;
+    for (auto _ : state)
+    {
+        if (!remaining)
+        {
+            state.PauseTiming();
+            stream->pushDataToDriver(data);
+            remaining = BATCH_SIZE;
+            state.ResumeTiming();
+        }
+        benchmark::DoNotOptimize(parsers.back()->readPacket(&buffer[0], buffer.size(), 1000));
+        --remaining;
+    }
+    setCounters(state, packet.size());
+
+    for (size_t i = 0; i < parsers.size(); ++i)
+    {
+        bus.removeParser(parsers[i]);
+        delete parsers[i];
+    }
+}
+BENCHMARK(BM_Bus)->Arg(1)->Arg(4)->Arg(16);
+
+int main(int argc, char** argv)
+{
+    ros::Time::init();
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
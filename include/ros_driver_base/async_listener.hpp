@@ -0,0 +1,200 @@
+#ifndef ROS_DRIVER_BASE_ASYNC_LISTENER_HPP
+#define ROS_DRIVER_BASE_ASYNC_LISTENER_HPP
+
+#include <ros_driver_base/io_listener.hpp>
+#include <ros/time.h>
+#include <vector>
+#include <boost/atomic.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/lockfree/queue.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+namespace ros_driver_base
+{
+    /** An IOListener that passes the data on to other listeners from
+     * dedicated threads
+     *
+     * Register it on the driver with Driver::addListener, and register the
+     * actual listeners on it. The driver's readData/writeData calls only copy
+     * the data in preallocated lock-free queues, so slow listeners (e.g.
+     * loggers) do not add latency to the driver's reads and writes.
+     *
+     * Each listener gets its own queue and its own dispatch thread, which
+     * hands the queued data over in batches, merging consecutive chunks of
+     * the same direction into a single call. A slow listener therefore
+     * neither delays the others nor makes them lose data: once its queue is
+     * full, new data is dropped for this listener only, and accounted in its
+     * statistics.
+     *
+     * As with any listener, the driver takes ownership of the AsyncListener,
+     * so it must be allocated with new. It does not own the listeners
+     * registered on it, which must outlive it:
+     *
+     * <code>
+     * FileLogger logger;
+     * AsyncListener* async = new AsyncListener(1024);
+     * async->addListener(&logger, AsyncListener::WRITE);
+     * async->start();
+     * driver.addListener(async);
+     * </code>
+     */
+    class AsyncListener : public IOListener
+    {
+    public:
+        /** Which data a listener receives */
+        enum Direction
+        {
+            READ  = 1,
+            WRITE = 2,
+            BOTH  = READ | WRITE
+        };
+
+        /** Dispatch statistics, summed over all listeners */
+        struct Statistics
+        {
+            /** Count of chunks waiting to be dispatched */
+            size_t queued_chunks;
+            /** Count of chunks passed to the listeners */
+            uint64_t dispatched_chunks;
+            /** Count of dispatch batches */
+            uint64_t batches;
+            /** Count of chunks dropped because a queue was full */
+            uint64_t dropped_chunks;
+            /** Count of bytes dropped because a queue was full */
+            uint64_t dropped_bytes;
+        };
+
+        /** Statistics of a single listener */
+        struct ListenerStatistics
+        {
+            /** Count of chunks waiting to be passed to the listener */
+            size_t queued_chunks;
+            /** Count of bytes passed to the listener */
+            uint64_t received_bytes;
+            /** Count of bytes the listener lost because its queue was full */
+            uint64_t dropped_bytes;
+        };
+
+        /**
+         * @arg capacity the number of chunks that can be queued for each
+         *   listener
+         * @arg chunk_size the size of a chunk. Bigger data gets split over
+         *   several chunks
+         */
+        AsyncListener(size_t capacity, size_t chunk_size = 256);
+
+        /** Stops the dispatch threads, see stop() */
+        ~AsyncListener();
+
+        /** Registers a listener, with its own queue and dispatch thread
+         *
+         * The thread is started right away if the AsyncListener is running.
+         *
+         * @arg directions a combination of Direction flags
+         */
+        void addListener(IOListener* listener, int directions = BOTH);
+
+        /** Deregisters a listener. Its queued data is dispatched first, and
+         * it is not called anymore once this returns. Must not be called
+         * from within a listener
+         */
+        void removeListener(IOListener* listener);
+
+        /** Starts the dispatch threads */
+        void start();
+
+        /** Stops the dispatch threads once all queued data is dispatched */
+        void stop();
+
+        /** True if the dispatch threads are running */
+        bool isRunning() const;
+
+        /** Waits for the queued data to be dispatched to all listeners
+         *
+         * @return false if there was still data in a queue at the timeout
+         */
+        bool flush(ros::Duration const& timeout);
+
+        Statistics getStatistics() const;
+
+        /** Returns the statistics of a registered listener
+         *
+         * @throws std::invalid_argument if the listener is not registered
+         */
+        ListenerStatistics getListenerStatistics(IOListener* listener) const;
+
+        virtual void writeData(boost::uint8_t const* data, size_t size);
+        virtual void readData(boost::uint8_t const* data, size_t size);
+
+    private:
+        struct Slot
+        {
+            Direction direction;
+            size_t size;
+        };
+
+        typedef boost::lockfree::queue<uint32_t, boost::lockfree::fixed_sized<true> > SlotQueue;
+
+        /** The queue and dispatch thread of a single listener */
+        class Channel
+        {
+        public:
+            IOListener* const listener;
+            int const directions;
+
+            Channel(IOListener* listener, int directions,
+                    size_t capacity, size_t chunk_size);
+            ~Channel();
+
+            void push(Direction direction, boost::uint8_t const* data, size_t size);
+            void start();
+            void stop();
+
+            void addStatistics(Statistics& stats) const;
+            ListenerStatistics getListenerStatistics() const;
+
+        private:
+            size_t const m_chunk_size;
+            std::vector<Slot> m_slots;
+            std::vector<uint8_t> m_data;
+            SlotQueue m_free;
+            SlotQueue m_queue;
+
+            boost::atomic<size_t> m_queued;
+            boost::atomic<uint64_t> m_dispatched;
+            boost::atomic<uint64_t> m_batches;
+            boost::atomic<uint64_t> m_received_bytes;
+            boost::atomic<uint64_t> m_dropped_chunks;
+            boost::atomic<uint64_t> m_dropped_bytes;
+
+            boost::atomic<bool> m_quit;
+            boost::atomic<bool> m_sleeping;
+            boost::mutex m_wakeup_mutex;
+            boost::condition_variable m_wakeup;
+            boost::thread m_thread;
+
+            void run();
+            void dispatch(std::vector<uint32_t> const& batch, std::vector<uint8_t>& merged);
+        };
+
+        typedef std::vector< boost::shared_ptr<Channel> > Channels;
+
+        size_t const m_capacity;
+        size_t const m_chunk_size;
+
+        /** Protects the channel list and m_running. The producers only hold
+         * it while they copy the data in the queues, the dispatch threads
+         * never take it
+         */
+        mutable boost::mutex m_channels_mutex;
+        Channels m_channels;
+        bool m_running;
+
+        void push(Direction direction, boost::uint8_t const* data, size_t size);
+        boost::shared_ptr<Channel> findChannel(IOListener* listener) const;
+    };
+}
+
+#endif
@@ -0,0 +1,130 @@
+#ifndef ROS_DRIVER_BASE_ASYNC_READER_HPP
+#define ROS_DRIVER_BASE_ASYNC_READER_HPP
+
+#include <ros_driver_base/driver.hpp>
+#include <ros/time.h>
+#include <vector>
+#include <string>
+#include <boost/atomic.hpp>
+#include <boost/thread/thread.hpp>
+
+namespace ros_driver_base
+{
+    /** Runs a driver's readPacket loop on a dedicated thread
+     *
+     * Complete packets are timestamped and pushed in a bounded lock-free
+     * single-producer/single-consumer ring, which the application drains with
+     * readPacket. This way, stalls in the application's processing do not
+     * delay the reads on the device, and therefore do not let the kernel
+     * buffers overflow.
+     *
+     * Only one thread may call readPacket. While the reader is running, the
+     * driver's readPacket must not be called from anywhere else.
+     *
+     * <code>
+     * AsyncReader reader(driver, 128);
+     * reader.start();
+     * ...
+     * ros::Time stamp;
+     * while (int size = reader.readPacket(buffer, sizeof(buffer), &stamp))
+     *     process(buffer, size, stamp);
+     * </code>
+     */
+    class AsyncReader
+    {
+    public:
+        /** What to do with a new packet when the ring is full */
+        enum OverflowPolicy
+        {
+            /** Discard the new packet */
+            DROP_NEWEST,
+            /** Discard the oldest packet in the ring to make room */
+            DROP_OLDEST
+        };
+
+        /**
+         * @arg driver the driver to read from. It must outlive the reader
+         * @arg capacity the number of packets the ring can hold
+         * @arg policy what to do when the ring is full
+         */
+        AsyncReader(Driver& driver, size_t capacity, OverflowPolicy policy = DROP_NEWEST);
+
+        /** Stops the reader thread */
+        ~AsyncReader();
+
+        /** Starts the reader thread
+         *
+         * This can be called again after an error stopped the thread. The
+         * packets still in the ring are kept.
+         */
+        void start();
+
+        /** Stops the reader thread and waits for it to finish */
+        void stop();
+
+        /** True if the reader thread is running */
+        bool isRunning() const;
+
+        /** Sets how long the reader thread blocks in the driver's readPacket
+         * before checking whether it should stop. Defaults to 100ms.
+         */
+        void setPollPeriod(ros::Duration const& period);
+
+        /** Pops the oldest packet from the ring. This never blocks.
+         *
+         * @arg stamp if non-null, set to the time at which the packet was
+         *   received
+         * @return the packet size, or 0 if the ring is empty
+         * @throws std::runtime_error if the reader thread stopped because of
+         *   an error, once all queued packets have been read
+         */
+        int readPacket(uint8_t* buffer, int buffer_size, ros::Time* stamp = 0);
+
+        /** The number of packets currently in the ring */
+        size_t getQueueSize() const;
+
+        /** The number of packets dropped because the ring was full */
+        uint64_t getDroppedPackets() const;
+
+        /** The number of packets pushed in the ring since the reader
+         * was created
+         */
+        uint64_t getReceivedPackets() const;
+
+    private:
+        struct Slot
+        {
+            int size;
+            ros::Time stamp;
+        };
+
+        Driver& m_driver;
+        size_t const m_capacity;
+        OverflowPolicy const m_policy;
+        ros::Duration m_poll_period;
+
+        std::vector<Slot> m_slots;
+        std::vector<uint8_t> m_data;
+
+        // The producer and consumer indexes are on separate cache lines so
+        // that the reader thread and the application do not invalidate
+        // each other's cache on every operation
+        char m_padding0[64];
+        boost::atomic<uint64_t> m_head;
+        char m_padding1[64];
+        boost::atomic<uint64_t> m_tail;
+        char m_padding2[64];
+
+        boost::atomic<uint64_t> m_dropped;
+        boost::atomic<uint64_t> m_received;
+        boost::atomic<bool> m_quit;
+        boost::atomic<bool> m_failed;
+        std::string m_error;
+        boost::thread m_thread;
+
+        void run();
+        void push(uint8_t const* packet, int size, ros::Time const& stamp);
+    };
+}
+
+#endif
@@ -0,0 +1,144 @@
+#ifndef ROS_DRIVER_BASE_ASYNC_WRITER_HPP
+#define ROS_DRIVER_BASE_ASYNC_WRITER_HPP
+
+#include <ros_driver_base/driver.hpp>
+#include <ros/time.h>
+#include <vector>
+#include <string>
+#include <boost/atomic.hpp>
+#include <boost/lockfree/queue.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+namespace ros_driver_base
+{
+    /** Writes packets to a driver from a dedicated thread
+     *
+     * Any number of threads may queue packets with writePacket, which copies
+     * the packet in a preallocated slot and never blocks. The writer thread
+     * sends all queued packets at once with Driver::writePackets (i.e. in a
+     * single writev call on stream devices), urgent packets first.
+     *
+     * While the writer is running, the driver's write methods must not be
+     * called from anywhere else.
+     */
+    class AsyncWriter
+    {
+    public:
+        /** The queue a packet goes into. URGENT packets are always sent
+         * before NORMAL ones
+         */
+        enum Priority { URGENT, NORMAL };
+
+        /** Writer statistics */
+        struct Statistics
+        {
+            /** Count of packets waiting to be written */
+            size_t queued_packets;
+            /** Count of packets written to the driver */
+            uint64_t written_packets;
+            /** Count of Driver::writePackets calls, i.e. of batches */
+            uint64_t write_calls;
+            /** Count of packets rejected because the queue was full */
+            uint64_t dropped_packets;
+            /** Count of packets lost because of write timeouts or errors */
+            uint64_t failed_packets;
+            /** Average time between writePacket and the end of the write */
+            ros::Duration mean_latency;
+            /** Maximum time between writePacket and the end of the write */
+            ros::Duration max_latency;
+        };
+
+        /**
+         * @arg driver the driver to write to. It must outlive the writer
+         * @arg capacity the number of packets that can be queued
+         * @arg max_packet_size the maximum size of a queued packet. If zero,
+         *   the driver's MAX_PACKET_SIZE is used
+         */
+        AsyncWriter(Driver& driver, size_t capacity, size_t max_packet_size = 0);
+
+        /** Stops the writer thread, see stop() */
+        ~AsyncWriter();
+
+        /** Starts the writer thread
+         *
+         * This can be called again after an error stopped the thread. The
+         * packets that were still queued then are dropped and counted in
+         * failed_packets.
+         */
+        void start();
+
+        /** Stops the writer thread once all queued packets are written
+         */
+        void stop();
+
+        /** True if the writer thread is running */
+        bool isRunning() const;
+
+        /** Sets the timeout used for each write on the driver. Defaults to
+         * one second
+         */
+        void setWriteTimeout(ros::Duration const& timeout);
+
+        /** Queues a packet. Thread-safe and non-blocking.
+         *
+         * @return false if the queue was full and the packet dropped
+         * @throws std::length_error if the packet is bigger than the maximum
+         *   packet size
+         * @throws std::runtime_error if the writer thread stopped because of
+         *   an error
+         */
+        bool writePacket(uint8_t const* buffer, size_t size, Priority priority = NORMAL);
+
+        /** Returns the writer statistics */
+        Statistics getStatistics() const;
+
+    private:
+        struct Slot
+        {
+            size_t size;
+            int64_t queued_time;
+        };
+
+        typedef boost::lockfree::queue<uint32_t, boost::lockfree::fixed_sized<true> > SlotQueue;
+
+        Driver& m_driver;
+        size_t const m_capacity;
+        size_t const m_max_packet_size;
+        ros::Duration m_write_timeout;
+
+        std::vector<Slot> m_slots;
+        std::vector<uint8_t> m_data;
+        SlotQueue m_free;
+        SlotQueue m_urgent;
+        SlotQueue m_normal;
+
+        boost::atomic<size_t> m_queued;
+        boost::atomic<uint64_t> m_written;
+        boost::atomic<uint64_t> m_write_calls;
+        boost::atomic<uint64_t> m_dropped;
+        boost::atomic<uint64_t> m_failed_packets;
+        boost::atomic<int64_t> m_mean_latency;
+        boost::atomic<int64_t> m_max_latency;
+
+        boost::atomic<bool> m_quit;
+        boost::atomic<bool> m_failed;
+        std::string m_error;
+
+        /** Set while the writer thread sleeps, so that producers only pay for
+         * the wakeup when needed
+         */
+        boost::atomic<bool> m_sleeping;
+        boost::mutex m_wakeup_mutex;
+        boost::condition_variable m_wakeup;
+        boost::thread m_thread;
+
+        void run();
+        /** Returns the slots of all queued packets to the free list */
+        void releaseQueuedPackets();
+        void writeBatch(std::vector<uint32_t>& batch, std::vector<struct iovec>& iov);
+    };
+}
+
+#endif
@@ -3,12 +3,44 @@
 
 #include <ros_driver_base/driver.hpp>
 #include <list>
+#include <map>
+#include <deque>
+#include <vector>
 #include <inttypes.h>
 #include <boost/thread/recursive_mutex.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
 
 namespace ros_driver_base {
 class Bus;
 
+/**
+ * RS-485 direction control settings, see Bus::setRS485
+ */
+struct RS485Configuration{
+	enum DirectionControl{
+		/** The application (or the hardware) switches the line direction */
+		DIRECTION_NONE,
+		/** The kernel serial driver switches RTS around each write (TIOCSRS485) */
+		DIRECTION_KERNEL,
+		/** Bus switches RTS itself around each write */
+		DIRECTION_RTS
+	};
+
+	DirectionControl direction_control;
+	/** RTS level while sending. The opposite level is used while receiving */
+	bool rts_on_send;
+	/** Time between enabling the transmitter and sending the first byte */
+	ros::Duration delay_before_send;
+	/** Time between the end of the last byte and going back to receive mode */
+	ros::Duration delay_after_send;
+	/** Number of bits on the line per byte (start, data, parity and stop bits) */
+	int bits_per_byte;
+
+	RS485Configuration()
+		: direction_control(DIRECTION_NONE), rts_on_send(true), bits_per_byte(10) {}
+};
+
 /**
  * This Class implements an Parser, classes they inherit this, are able to "dock" on an IOBus.
  * Its used for e.g. for RS-485 Communication busses, there may different devices on one bus.
@@ -78,14 +110,102 @@ class Bus : public Driver{
 public:
 	Bus(int max_packet_size, bool extract_last = false);
 	int readPacket(uint8_t* buffer, int buffer_size, int packet_timeout, int first_byte_timeout=-1, Parser *parser=0);
+	int readPacket(uint8_t* buffer, int buffer_size, ros::Duration const& packet_timeout, ros::Duration const& first_byte_timeout, Parser *parser=0);
 	void addParser(Parser *parser);
 	void removeParser(Parser *parser);
 	int extractPacket(uint8_t const* buffer, size_t buffer_size) const;
         bool writePacket(uint8_t const* buffer, int buffer_size, int timeout);
+        bool writePacket(uint8_t const* buffer, int buffer_size, ros::Duration const& timeout);
+
+	/**
+	 * Configures RS-485 direction control on the current serial port. Must be
+	 * called after the port is opened, and again if the baud rate changes.
+	 *
+	 * With DIRECTION_RTS, writePacket holds the line in transmit mode for
+	 * exactly the time needed to shift out the written bytes at the current
+	 * baud rate (see getTransmitDuration), instead of relying on fixed sleeps.
+	 *
+	 * Throws UnixError if the port does not support the requested mode
+	 */
+	void setRS485(RS485Configuration const& config);
+	RS485Configuration getRS485() const;
+
+	/**
+	 * Returns the time needed to send the given number of bytes on the line at
+	 * the baud rate read by setRS485
+	 */
+	ros::Duration getTransmitDuration(size_t byte_count) const;
+
+	/**
+	 * Enables pipelined operation, for protocols where several requests can be
+	 * in flight on the bus at the same time.
+	 *
+	 * In pipelined mode, writePacket does not wait for reads to finish, so
+	 * requests from different threads go out back to back. Received packets
+	 * are routed to the registered Parser whose extractPacket accepts them
+	 * (i.e. by address or sequence number, as the protocol defines it) rather
+	 * than to the thread that happens to be reading. Each Parser::readPacket
+	 * call returns the next packet routed to its parser. The thread that
+	 * reads on behalf of the others changes as calls return. Packets
+	 * accepted by a BusHandler are passed to packedReady, and returned by
+	 * readPacket calls made without a parser.
+	 *
+	 * All parsers must be registered with addParser. Only the packet timeout
+	 * is used in this mode. This must not be changed while reads are in
+	 * progress.
+	 *
+	 * Each parser keeps at most getMailboxSize() unread packets. Past that,
+	 * its oldest packet is dropped, and counted in
+	 * getDroppedRoutedPacketCount().
+	 */
+	void setPipelined(bool enable);
+	bool isPipelined() const;
+
+	/**
+	 * Sets how many unread packets are kept for each parser in pipelined
+	 * mode. Defaults to 16
+	 */
+	void setMailboxSize(size_t size);
+	size_t getMailboxSize() const;
+
+	/**
+	 * Returns the count of packets dropped in pipelined mode because their
+	 * parser did not read them in time
+	 */
+	uint64_t getDroppedRoutedPacketCount() const;
 protected:
 	std::list<Parser*> parser;
 	Parser *caller;
         boost::recursive_mutex mutex;
+	RS485Configuration rs485;
+	int rs485_baudrate;
+
+	/**
+	 * Sets the RTS line for DIRECTION_RTS. Overload it to switch the line
+	 * direction through another output, e.g. a GPIO
+	 */
+	virtual void setRTS(bool level);
+
+	bool pipelined;
+	/** Serializes the writes in pipelined mode */
+	boost::mutex write_mutex;
+	/** Protects the routing state below */
+	mutable boost::mutex route_mutex;
+	boost::condition_variable route_cond;
+	/** True while a thread reads on the device on behalf of the others */
+	bool route_reading;
+	/** Packets routed to each parser and not read yet. BusHandler packets
+	 * are stored under a NULL parser.
+	 */
+	std::map<Parser*, std::deque<std::vector<uint8_t> > > mailboxes;
+	/** Maximum number of packets in each mailbox */
+	size_t mailbox_size;
+	/** Count of packets dropped because their mailbox was full */
+	uint64_t dropped_routed_packets;
+
+	int readRoutedPacket(uint8_t* buffer, int buffer_size, ros::Duration const& timeout, Parser *parser);
+	/** Returns the parser that accepts the given packet, or NULL */
+	Parser* findPacketOwner(uint8_t const* packet, int size) const;
 };
 }
 
@@ -0,0 +1,120 @@
+#ifndef ROS_DRIVER_BASE_CAPTURE_LISTENER_HPP
+#define ROS_DRIVER_BASE_CAPTURE_LISTENER_HPP
+
+#include <ros_driver_base/io_listener.hpp>
+#include <string>
+#include <boost/shared_ptr.hpp>
+
+namespace ros_driver_base
+{
+    /** An IOListener that records the data in pcapng files
+     *
+     * Each chunk of data becomes an Enhanced Packet Block with a nanosecond
+     * timestamp. Its direction is stored in the block's flags (inbound for
+     * reads, outbound for writes), and the stream it comes from is the
+     * block's interface. All interfaces use the same link type, by default
+     * LINKTYPE_USER0, for which Wireshark can be given a custom dissector.
+     *
+     * The files are preallocated and memory-mapped, so recording a chunk is
+     * a copy into the mapping, without system calls or formatting. Once a
+     * file is full, the listener moves on to the next one. Files are named
+     * PREFIX.N.pcapng, with N starting at zero.
+     *
+     * A helper thread creates and maps the next file in advance, and
+     * truncates, closes and deletes the old ones, so that moving on to a new
+     * file does not add latency to the driver's reads and writes. Recording
+     * only waits for the helper if a file gets full before the next one is
+     * ready.
+     *
+     * The listener itself records stream 0. getStream returns listeners
+     * for the other streams, to record several drivers in the same files.
+     * Like the listener itself, they are meant to be handed over to a
+     * driver, which deletes them. The files are closed once the listener
+     * and all its streams are deleted, or when close() is called:
+     *
+     * <code>
+     * CaptureListener* capture = new CaptureListener("/var/log/robot/bus", 64 << 20, 2);
+     * driver0.addListener(capture);
+     * driver1.addListener(capture->getStream(1));
+     * </code>
+     *
+     * Recording is thread-safe. If a new file cannot be created, the
+     * recording stops.
+     */
+    class CaptureListener : public IOListener
+    {
+    public:
+        /** The first pcapng link type reserved for private use */
+        static const uint16_t LINKTYPE_USER0 = 147;
+
+        /**
+         * @arg path_prefix the path of the files, without the .N.pcapng suffix
+         * @arg file_size the size at which the listener moves on to a new file
+         * @arg stream_count the number of streams recorded in the files
+         * @arg link_type the pcapng link type of the streams
+         * @arg snaplen the maximum number of bytes recorded per chunk.
+         *   Bigger chunks are truncated
+         * @throws UnixError if the first file cannot be created
+         */
+        CaptureListener(std::string const& path_prefix,
+                size_t file_size = 64 << 20,
+                size_t stream_count = 1,
+                uint16_t link_type = LINKTYPE_USER0,
+                uint32_t snaplen = 65535);
+
+        /** Closes the files, unless streams returned by getStream still
+         * use them
+         */
+        ~CaptureListener();
+
+        /** Sets the number of files to keep. Once there are more, the
+         * oldest file gets deleted. Zero (the default) keeps all files
+         */
+        void setMaxFiles(size_t count);
+
+        /** Returns a new listener that records stream \c index
+         *
+         * The caller takes ownership of it, usually by passing it to
+         * Driver::addListener. It keeps the files open after the
+         * CaptureListener is deleted.
+         *
+         * @throws std::out_of_range if the index is not below the stream
+         *   count
+         */
+        IOListener* getStream(size_t index);
+
+        /** Truncates the current file to its actual size and closes it,
+         * and deletes the file prepared for the rollover. Nothing is
+         * recorded afterwards, including through the streams
+         */
+        void close();
+
+        /** The path of the file currently being written */
+        std::string getCurrentPath() const;
+
+        /** Count of files created so far */
+        size_t getFileCount() const;
+
+        /** Count of chunks recorded so far */
+        uint64_t getRecordedChunks() const;
+
+        /** Records a chunk of data
+         *
+         * @arg stream the stream index
+         * @arg outbound true if the data was written to the device
+         */
+        void record(size_t stream, bool outbound, boost::uint8_t const* data, size_t size);
+
+        virtual void writeData(boost::uint8_t const* data, size_t size);
+        virtual void readData(boost::uint8_t const* data, size_t size);
+
+    private:
+        /** The files and the helper thread, shared with the streams */
+        class Recorder;
+        class Stream;
+
+        boost::shared_ptr<Recorder> m_recorder;
+    };
+}
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef ROS_DRIVER_BASE_CLOCK_HPP
+#define ROS_DRIVER_BASE_CLOCK_HPP
+
+#include <stdint.h>
+#include <ros/time.h>
+
+namespace ros_driver_base {
+    /** Source of time of the library
+     *
+     * By default, the library uses the system's clocks: CLOCK_MONOTONIC for
+     * the timeouts and durations, and ros::Time::now() for the stamps. A
+     * Clock installed with setCurrent replaces them in:
+     *
+     * <ul>
+     * <li>Deadline::now(), and therefore Deadline, Timeout and the timeouts
+     *     and durations of Driver, Bus and the asynchronous helpers
+     * <li>the stamps of Status and of AsyncReader's packets
+     * <li>the waits of TestStream and ReplayStream, and the RS485 delays of
+     *     Bus, which go through waitUntil
+     * </ul>
+     *
+     * Waits on file descriptors still block on the system's clock. When they
+     * time out, the installed clock is advanced to the end of the wait, so
+     * that a Driver sees its deadlines pass.
+     *
+     * This is meant for tests, with a VirtualClock, e.g.
+     *
+     * <code>
+     * VirtualClock clock;
+     * ScopedClock scoped(clock);
+     * </code>
+     */
+    class Clock
+    {
+    public:
+        virtual ~Clock();
+
+        /** The current time on the clock's monotonic timeline, in
+         * nanoseconds
+         */
+        virtual int64_t now() const = 0;
+
+        /** The current wall time, used to stamp data and statistics */
+        virtual ros::Time getWallTime() const = 0;
+
+        /** Waits until now() reaches \c time */
+        virtual void sleepUntil(int64_t time) = 0;
+
+        /** The installed clock, or NULL if the system's clocks are used */
+        static Clock* getCurrent();
+
+        /** Installs the clock used by the library. NULL goes back to the
+         * system's clocks
+         *
+         * The clock must remain valid while it is installed. It is not
+         * meant to be changed while drivers are in use in other threads
+         */
+        static void setCurrent(Clock* clock);
+
+        /** The current wall time of the installed clock, or
+         * ros::Time::now()
+         */
+        static ros::Time wallTime();
+
+        /** Waits until Deadline::now() reaches \c time */
+        static void waitUntil(int64_t time);
+
+        /** Accounts for a wait of \c duration on the system's clock that
+         * timed out, by advancing the installed clock accordingly
+         */
+        static void waitTimedOut(ros::Duration const& duration);
+    };
+
+    /** Installs a clock for the lifetime of the object, and restores the
+     * previous one afterwards
+     */
+    class ScopedClock
+    {
+        Clock* m_previous;
+
+    public:
+        explicit ScopedClock(Clock& clock);
+        ~ScopedClock();
+    };
+}
+
+#endif
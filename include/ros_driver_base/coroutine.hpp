@@ -0,0 +1,163 @@
+#ifndef ROS_DRIVER_BASE_COROUTINE_HPP
+#define ROS_DRIVER_BASE_COROUTINE_HPP
+
+/** C++20 coroutine interface to Driver
+ *
+ * This header is usable only when compiling with coroutine support (e.g.
+ * -std=c++20). The library itself does not need it.
+ */
+
+#include <ros_driver_base/driver.hpp>
+#include <ros_driver_base/io_scheduler.hpp>
+#include <ros_driver_base/exceptions.hpp>
+#include <ros_driver_base/timeout.hpp>
+
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#include <exception>
+#include <stdexcept>
+
+namespace ros_driver_base
+{
+    /** Awaitable returned by co_readPacket */
+    class ReadPacketAwaitable
+    {
+        Driver& m_driver;
+        IOScheduler& m_scheduler;
+        uint8_t* m_buffer;
+        int m_buffer_size;
+        int64_t m_deadline;
+        int m_result;
+        std::exception_ptr m_error;
+
+        bool tryRead()
+        {
+            try { m_result = m_driver.tryReadPacket(m_buffer, m_buffer_size); }
+            catch(...) { m_error = std::current_exception(); }
+            return m_result || m_error;
+        }
+
+        void arm(std::coroutine_handle<> handle)
+        {
+            int fd = m_driver.getFileDescriptor();
+            if (fd < 0)
+                throw std::runtime_error("co_readPacket: the driver's stream has no file descriptor");
+
+            m_scheduler.waitFD(fd, IOScheduler::READ, m_deadline,
+                [this, handle](bool timed_out)
+                {
+                    if (timed_out)
+                        m_error = std::make_exception_ptr(TimeoutError(TimeoutError::PACKET,
+                                    "co_readPacket(): no packet before the deadline"));
+                    else if (!tryRead())
+                        return arm(handle);
+                    handle.resume();
+                });
+        }
+
+    public:
+        ReadPacketAwaitable(Driver& driver, IOScheduler& scheduler,
+                uint8_t* buffer, int buffer_size, ros::Duration const& timeout)
+            : m_driver(driver), m_scheduler(scheduler)
+            , m_buffer(buffer), m_buffer_size(buffer_size)
+            , m_deadline(Deadline(timeout).toNSec())
+            , m_result(0) {}
+
+        bool await_ready() { return tryRead(); }
+        void await_suspend(std::coroutine_handle<> handle) { arm(handle); }
+        int await_resume()
+        {
+            if (m_error)
+                std::rethrow_exception(m_error);
+            return m_result;
+        }
+    };
+
+    /** Awaitable returned by co_writePacket */
+    class WritePacketAwaitable
+    {
+        Driver& m_driver;
+        IOScheduler& m_scheduler;
+        uint8_t const* m_buffer;
+        int m_buffer_size;
+        int64_t m_deadline;
+        int m_written;
+        std::exception_ptr m_error;
+
+        bool tryWrite()
+        {
+            try { m_written += m_driver.tryWrite(m_buffer + m_written, m_buffer_size - m_written); }
+            catch(...) { m_error = std::current_exception(); }
+            return m_written == m_buffer_size || m_error;
+        }
+
+        void arm(std::coroutine_handle<> handle)
+        {
+            int fd = m_driver.getFileDescriptor();
+            if (fd < 0)
+                throw std::runtime_error("co_writePacket: the driver's stream has no file descriptor");
+
+            m_scheduler.waitFD(fd, IOScheduler::WRITE, m_deadline,
+                [this, handle](bool timed_out)
+                {
+                    if (timed_out)
+                        m_error = std::make_exception_ptr(TimeoutError(TimeoutError::PACKET,
+                                    "co_writePacket(): timeout"));
+                    else if (!tryWrite())
+                        return arm(handle);
+                    handle.resume();
+                });
+        }
+
+    public:
+        WritePacketAwaitable(Driver& driver, IOScheduler& scheduler,
+                uint8_t const* buffer, int buffer_size, ros::Duration const& timeout)
+            : m_driver(driver), m_scheduler(scheduler)
+            , m_buffer(buffer), m_buffer_size(buffer_size)
+            , m_deadline(Deadline(timeout).toNSec())
+            , m_written(0) {}
+
+        bool await_ready() { return tryWrite(); }
+        void await_suspend(std::coroutine_handle<> handle) { arm(handle); }
+        void await_resume()
+        {
+            if (m_error)
+                std::rethrow_exception(m_error);
+        }
+    };
+
+    /** Reads a packet from within a coroutine
+     *
+     * The coroutine is suspended until the driver's file descriptor is
+     * readable, and resumed by the scheduler once a full packet got
+     * extracted, or once \c timeout has passed. The awaited value is the
+     * packet size.
+     *
+     * <code>
+     * int size = co_await co_readPacket(driver, scheduler, buffer, sizeof(buffer), ros::Duration(0.1));
+     * </code>
+     *
+     * @throws TimeoutError on timeout, and the errors of readPacket
+     */
+    inline ReadPacketAwaitable co_readPacket(Driver& driver, IOScheduler& scheduler,
+            uint8_t* buffer, int buffer_size, ros::Duration const& timeout)
+    {
+        return ReadPacketAwaitable(driver, scheduler, buffer, buffer_size, timeout);
+    }
+
+    /** Writes a packet from within a coroutine
+     *
+     * The coroutine is suspended only if the stream does not accept the
+     * whole packet right away.
+     *
+     * @throws TimeoutError on timeout, and the errors of writePacket
+     */
+    inline WritePacketAwaitable co_writePacket(Driver& driver, IOScheduler& scheduler,
+            uint8_t const* buffer, int buffer_size, ros::Duration const& timeout)
+    {
+        return WritePacketAwaitable(driver, scheduler, buffer, buffer_size, timeout);
+    }
+}
+
+#endif
+#endif
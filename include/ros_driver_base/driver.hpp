@@ -8,11 +8,21 @@
 #include <vector>
 #include <unistd.h>
 #include <ros_driver_base/status.hpp>
+#include <ros_driver_base/status_counters.hpp>
 #include <ros_driver_base/exceptions.hpp>
+#include <ros_driver_base/serial_configuration.hpp>
+#include <ros_driver_base/polling_policy.hpp>
 #include <set>
+#include <map>
+#include <list>
 #include <ros/time.h>
+#include <boost/function.hpp>
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/future.hpp>
 
 struct addrinfo;
+struct iovec;
 
 namespace ros_driver_base {
 
@@ -73,6 +83,19 @@ public:
     /** For backward compatibility only */
     typedef ros_driver_base::Status Statistics;
 
+    /** Returns true if the given packet is the reply to a transaction
+     *
+     * @see startTransaction
+     */
+    typedef boost::function<bool (uint8_t const* packet, size_t size)> ReplyMatcher;
+
+    /** Called when a transaction completes, with the reply packet, or with a
+     * NULL packet if the transaction timed out
+     *
+     * @see startTransaction
+     */
+    typedef boost::function<void (uint8_t const* packet, size_t size)> ReplyCallback;
+
     static const int INVALID_FD = -1;
 
 private:
@@ -155,10 +178,79 @@ protected:
      */
     int doPacketExtraction(uint8_t* buffer);
 
-    mutable Status m_stats;
+    /** The I/O statistics
+     *
+     * @see getStatus
+     */
+    mutable StatusCounters m_stats;
+    /** Time at which the first byte currently in the internal buffer was
+     * received, or zero if unknown
+     */
+    int64_t m_first_byte_time;
+
+    /** Busy-polling settings for readPacket
+     *
+     * @see setPollingPolicy
+     */
+    PollingPolicy m_polling;
+
+    /** Current spin budget in nanoseconds */
+    int64_t m_spin_budget;
+
+    /** Moving average of the time readPacket waits for data, in
+     * nanoseconds. Used to adapt m_spin_budget
+     */
+    int64_t m_wait_estimate;
+
+    /** Updates the wait estimate and the spin budget after readPacket
+     * waited \c wait_ns nanoseconds for data
+     */
+    void updateSpinBudget(int64_t wait_ns);
+
+    /** Updates the statistics after a call to the stream's write method
+     *
+     * @arg after_wait whether the call follows a waitWrite
+     */
+    void countWriteCall(size_t requested, size_t written, bool after_wait);
+    /** Updates the statistics before a call to the stream's waitWrite */
+    void countWriteWait();
 
     void openIPClient(std::string const& hostname, int port, addrinfo const& hints);
 
+    struct PendingTransaction
+    {
+        uint64_t id;
+        ReplyMatcher matcher;
+        ReplyCallback callback;
+        int64_t deadline;
+    };
+
+    /** Transactions waiting for their reply, in the order they were
+     * started
+     */
+    std::list<PendingTransaction> m_transactions;
+    /** Size of m_transactions, readable without taking the lock */
+    boost::atomic<size_t> m_transaction_count;
+    uint64_t m_next_transaction_id;
+    boost::mutex m_transaction_mutex;
+    /** Serializes the registration and request write of the transactions,
+     * so that requests are not interleaved and go on the wire in the order
+     * their matchers are tried
+     */
+    boost::mutex m_transaction_write_mutex;
+
+    /** Completes the first pending transaction whose matcher accepts the
+     * given packet
+     *
+     * @return true if a transaction matched
+     */
+    bool matchTransaction(uint8_t const* packet, int size);
+
+    /** Returns the earliest deadline of the pending transactions, on the
+     * monotonic clock. Only valid if there are pending transactions.
+     */
+    int64_t getNextTransactionDeadline();
+
 public:
     /** Creates an Driver class for a packet-based protocol
      *
@@ -187,16 +279,41 @@ public:
     /** Get the default read timeout */
     ros::Duration getWriteTimeout() const;
 
+    /** Enables or disables busy-polling in readPacket
+     *
+     * @see PollingPolicy
+     */
+    void setPollingPolicy(PollingPolicy const& policy);
+
+    /** Returns the current busy-polling settings */
+    PollingPolicy getPollingPolicy() const;
+
+    /** Returns how long readPacket currently busy-polls before blocking */
+    ros::Duration getSpinBudget() const;
+
     /** Removes all data that is pending on the file descriptor */
     void clear();
 
     /** Returns the I/O statistics
      *
-     * Use resetStats() to set them back to 0
+     * It can be called from any thread, also while the driver is reading or
+     * writing, without slowing it down. Use resetStats() to set them back to
+     * 0
      */
     Status getStatus() const;
 
+    /** Copies the I/O statistics in \c status
+     *
+     * Unlike getStatus(), it does not allocate memory once \c status got
+     * constructed, which matters when polling the statistics of many
+     * drivers
+     */
+    void getStatus(Status& status) const;
+
     /** Reset the I/O statistics to 0
+     *
+     * Unlike getStatus(), it must not be called while the driver is reading
+     * or writing
      */
     void resetStatus();
 
@@ -226,13 +343,22 @@ public:
      *
      * The following formats are recognized:
      *
-     * * serial://path/to/device:baudrate
+     * * serial://path/to/device:baudrate[?option=value&...]
      * * tcp://hostname:port
      * * udp://hostname:remote_port[:local_port]
      * * udpserver://port
+     * * replay://path/to/capture.pcapng[?speed=factor&stream=index]
+     *
+     * The serial:// options are low_latency, vmin, vtime and latency_timer,
+     * see SerialConfiguration. The replay:// options are those of
+     * openReplay
      */
     virtual void openURI(std::string const& uri);
 
+    /** Parses the option=value&option=value part of an URI
+     */
+    static std::map<std::string, std::string> parseURIOptions(std::string const& options);
+
     /**
     * @deprecated
     *
@@ -273,18 +399,46 @@ public:
      *
      * The return value is kept here for backward compatibility only.
      */
-    bool openSerial(std::string const& port, int baudrate);
+    bool openSerial(std::string const& port, int baudrate,
+            SerialConfiguration const& config = SerialConfiguration());
 
     /** Opens a file from a path. It can be used for read-only tests of a
      * driver, or to connect to a named FIFO or an already-created Unix socket
      */
     void openFile(std::string const& path);
 
+    /** Plays back a capture made with CaptureListener, see ReplayStream
+     *
+     * @arg speed the replay speed relative to the original timing, or zero
+     *   to replay as fast as possible
+     * @arg stream the recorded stream to replay
+     */
+    void openReplay(std::string const& path, double speed = 1, unsigned int stream = 0);
+
     /** Opens a serial port and sets it up to a sane configuration
      *
      * Returns INVALID_FD on failure, or the file descriptor on success
      */
-    static int openSerialIO(std::string const& port, int baudrate);
+    static int openSerialIO(std::string const& port, int baudrate,
+            SerialConfiguration const& config = SerialConfiguration());
+
+    /** Sets or clears the ASYNC_LOW_LATENCY flag of a tty
+     *
+     * It also clears the ASYNC_SPD_* flags, so that a custom divisor set
+     * by a previous user of the port does not override the baud rate
+     *
+     * @return false if the device does not support it (or on non-Linux
+     *   systems)
+     */
+    static bool setSerialLowLatency(int fd, bool enable);
+
+    /** Sets the latency timer of the USB-serial adapter behind the given
+     * device, in milliseconds
+     *
+     * Throws UnixError if the adapter has no latency timer or it cannot
+     * be written
+     */
+    static void setSerialLatencyTimer(std::string const& port, int latency_ms);
 
     /** Sets the O_NONBLOCK flag on a file descriptor
      *
@@ -338,11 +492,19 @@ public:
 
     /** Sets the baud rate value for the given file descriptor
      *
-     * @arg the baud rate. It can be one of the values in SERIAL_RATES
+     * @arg the baud rate. It can be one of the values in SERIAL_RATES. On
+     *   Linux, any other rate the hardware can generate is also accepted
      * @return true on success, false on failure
      */
     static bool setSerialBaudrate(int fd, int rate);
 
+    /** Returns the output baud rate currently set on the given file
+     * descriptor
+     *
+     * Throws UnixError if it cannot be read
+     */
+    static int getSerialBaudrate(int fd);
+
     /** Closes the file descriptor */
     virtual void close();
 
@@ -372,7 +534,8 @@ public:
     /** Tries to read a packet from the file descriptor and to save it in the
      * provided buffer. +packet_timeout+ is the timeout to receive a complete
      * packet. There is no infinite timeout value, and 0 is non-blocking at all
-     * (but might throw without data)
+     * (but might throw without data). Timeouts are tracked on the monotonic
+     * clock, so sub-millisecond values are honored.
      *
      * first_byte_timeout defines the timeout to receive at least one byte. Set
      * to a value greater than packet_timeout (or call the readPacket variant
@@ -400,14 +563,97 @@ public:
     bool writePacket(uint8_t const* buffer, int bufsize, int timeout);
 
     /** Tries to write a packet to the file descriptor. +timeout+ is the
-     * timeout in milliseconds. There is not infinite timeout value, and 0
-     * is non-blocking at all
+     * timeout, tracked on the monotonic clock with sub-millisecond
+     * resolution. There is not infinite timeout value, and 0 is
+     * non-blocking at all
      *
      * @throws timeout_error on timeout and unix_error on reading problems
      * @returns always true. The return value is kept for backward compatibility only
      */
     bool writePacket(uint8_t const* buffer, int bufsize, ros::Duration const& timeout);
 
+    /** Writes several packets at once
+     *
+     * The packets are written back to back, using a single writev call when
+     * the underlying stream supports it. Datagram streams still send one
+     * datagram per packet.
+     *
+     * @throws TimeoutError on timeout and UnixError on writing problems
+     */
+    void writePackets(struct iovec const* packets, int count, ros::Duration const& timeout);
+
+    /** Extracts a packet from the data that is available right now, without
+     * waiting
+     *
+     * This is the building block for event-driven reads (see
+     * co_readPacket): call it when the stream is readable.
+     *
+     * @throws std::length_error if bufsize is smaller than MAX_PACKET_SIZE
+     * @throws UnixError on reading problems
+     * @returns the size of the packet, or 0 if there is no full packet yet
+     */
+    int tryReadPacket(uint8_t* buffer, int bufsize);
+
+    /** Writes as much of the given buffer as the stream accepts without
+     * waiting
+     *
+     * @throws UnixError on writing problems
+     * @returns the number of bytes written
+     */
+    int tryWrite(uint8_t const* buffer, int bufsize);
+
+    /** Writes a request and registers a transaction waiting for its reply
+     *
+     * While transactions are pending, every packet extracted by readPacket
+     * is passed to their matchers in the order the transactions were
+     * started. The first matching transaction gets the packet through its
+     * callback, and readPacket goes on with the next packet. Packets that
+     * match no transaction are returned by readPacket as usual.
+     *
+     * Replies are therefore only processed while some thread calls
+     * readPacket (e.g. an AsyncReader). Several transactions can be
+     * outstanding at the same time, and they can be started from other
+     * threads than the one calling readPacket.
+     *
+     * Concurrent calls to startTransaction are serialized, and the
+     * requests are written in the order the transactions are registered.
+     * They must however not run concurrently with the other writing
+     * methods (writePacket, writePackets), as the driver's write side
+     * supports only one writer at a time.
+     *
+     * Matchers are called with an internal lock held and must not start or
+     * cancel transactions. Callbacks are called without the lock.
+     *
+     * @arg timeout after this time, the callback is called with a NULL
+     *   packet. Timeouts are checked by readPacket and
+     *   processTransactionTimeouts.
+     * @return the transaction ID, to be used with cancelTransaction
+     */
+    uint64_t startTransaction(uint8_t const* request, int request_size,
+            ReplyMatcher const& matcher, ReplyCallback const& callback,
+            ros::Duration const& timeout);
+
+    /** @overload
+     *
+     * Returns a future that holds the reply, or a TimeoutError if the
+     * transaction timed out
+     */
+    boost::unique_future< std::vector<uint8_t> > startTransaction(
+            uint8_t const* request, int request_size,
+            ReplyMatcher const& matcher, ros::Duration const& timeout);
+
+    /** Removes a pending transaction without calling its callback
+     *
+     * @return false if the transaction was not pending anymore
+     */
+    bool cancelTransaction(uint64_t id);
+
+    /** Returns the number of transactions waiting for their reply */
+    size_t getPendingTransactionCount() const;
+
+    /** Calls the callbacks of the transactions that timed out */
+    void processTransactionTimeouts();
+
     /** Find a packet into the currently accumulated data.
      *
      * This method should be provided by subclasses. The @a buffer argument is
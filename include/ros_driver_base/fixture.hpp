@@ -4,6 +4,8 @@
 #include <ros_driver_base/test_stream.hpp>
 #include <vector>
 #include <ros_driver_base/exceptions.hpp>
+#include <ros_driver_base/clock.hpp>
+#include <boost/scoped_ptr.hpp>
 
 namespace ros_driver_base
 {
@@ -79,6 +81,8 @@ namespace ros_driver_base
 
         std::vector<uint8_t> packetBuffer;
         Driver driver;
+        /** Installation of the TestStream's clock by useVirtualClock */
+        boost::scoped_ptr<ScopedClock> virtualClock;
 
         Fixture()
         {
@@ -94,6 +98,25 @@ namespace ros_driver_base
             return dynamic_cast<TestStream*>(driver.getMainStream());
         }
 
+        /** Runs the library's timeouts on the TestStream's VirtualClock
+         * until the end of the test, so that they are deterministic and do
+         * not take real time. The driver must not be reopened afterwards
+         */
+        void useVirtualClock()
+        {
+            if (!virtualClock)
+                virtualClock.reset(new ScopedClock(getStream()->getClock()));
+        }
+
+        /** The TestStream's clock
+         *
+         * @see useVirtualClock
+         */
+        VirtualClock& getClock()
+        {
+            return getStream()->getClock();
+        }
+
         /** Read a packet from the driver and return it as an std::vector
          */
         std::vector<uint8_t> readPacket()
@@ -134,7 +157,25 @@ namespace ros_driver_base
         void pushDataToDriver(Iterator begin, Iterator end)
         {
             std::vector<uint8_t> buffer(begin, end);
-            pushDataToDriver(buffer);
+            getStream()->swapDataToDriver(buffer);
+        }
+
+        /** Push data to the driver "as-if" it was coming from the device,
+         * without copying it. \c data is left empty
+         */
+        void swapDataToDriver(std::vector<uint8_t>& data)
+        {
+            getStream()->swapDataToDriver(data);
+        }
+
+        /** Controls how the pushed data gets split between the reads of the
+         * driver
+         *
+         * @see TestStream::setFragmentation
+         */
+        void setFragmentation(TestStream::Fragmentation mode, size_t max_size = 1, uint32_t seed = 0)
+        {
+            getStream()->setFragmentation(mode, max_size, seed);
         }
 
         /** Read data that the driver sent to the device
@@ -168,6 +209,26 @@ namespace ros_driver_base
             getStream()->EXPECT_REPLY(expectation,reply);
         }
 
+        /** @see TestStream::EXPECT_REPLY */
+        void EXPECT_REPLY(std::vector<uint8_t> const& expectation, std::vector<uint8_t> const& mask,
+                std::vector<uint8_t> const& reply)
+        {
+            getStream()->EXPECT_REPLY(expectation, mask, reply);
+        }
+
+        /** @see TestStream::EXPECT_UNORDERED_REPLY */
+        void EXPECT_UNORDERED_REPLY(std::vector<uint8_t> const& expectation, std::vector<uint8_t> const& reply)
+        {
+            getStream()->EXPECT_UNORDERED_REPLY(expectation, reply);
+        }
+
+        /** @see TestStream::EXPECT_UNORDERED_REPLY */
+        void EXPECT_UNORDERED_REPLY(std::vector<uint8_t> const& expectation, std::vector<uint8_t> const& mask,
+                std::vector<uint8_t> const& reply)
+        {
+            getStream()->EXPECT_UNORDERED_REPLY(expectation, mask, reply);
+        }
+
         /**
          * Check if the test has any expectation set and throw if positive.
          * It should be used to check if the test reached its end without
@@ -0,0 +1,112 @@
+#ifndef ROS_DRIVER_BASE_HISTOGRAM_HPP
+#define ROS_DRIVER_BASE_HISTOGRAM_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace ros_driver_base {
+    /** A histogram of positive integer values with a bounded relative error
+     *
+     * Values are counted in logarithmic buckets, each power of two being
+     * split in 2^sub_bucket_bits linear sub-buckets (as in HdrHistogram).
+     * The relative error of the percentiles is therefore at most
+     * 2^-sub_bucket_bits, and the memory usage is fixed at construction.
+     * Recording a value is a few arithmetic operations and an increment.
+     *
+     * Values above 2^max_value_bits - 1 are counted in the last bucket.
+     *
+     * A histogram is recorded by one thread at a time. The values are stored
+     * with relaxed atomic writes so that load() can copy it from another
+     * thread; this costs nothing over plain writes on common platforms.
+     */
+    class Histogram
+    {
+    public:
+        /**
+         * @arg sub_bucket_bits log2 of the number of sub-buckets per power
+         *   of two. The default of 5 gives a relative error of about 3%
+         * @arg max_value_bits log2 of the largest value that is counted
+         *   accurately. The default of 40 covers 18 minutes in nanoseconds
+         */
+        explicit Histogram(unsigned int sub_bucket_bits = 5, unsigned int max_value_bits = 40);
+
+        /** Counts a value */
+        void record(uint64_t value)
+        {
+            if (value > m_max_value)
+                value = m_max_value;
+            uint64_t& bucket = m_counts[getBucketIndex(value)];
+            set(bucket, bucket + 1);
+            set(m_count, m_count + 1);
+            set(m_sum, m_sum + value);
+            if (value < m_min)
+                set(m_min, value);
+            if (value > m_max)
+                set(m_max, value);
+        }
+
+        /** Count of recorded values */
+        uint64_t getCount() const { return m_count; }
+        /** The smallest recorded value, or 0 if there is none */
+        uint64_t getMin() const { return m_count ? m_min : 0; }
+        /** The largest recorded value */
+        uint64_t getMax() const { return m_max; }
+        /** The mean of the recorded values */
+        double getMean() const;
+
+        /** Returns a value that is greater than or equal to the given
+         * percentage of the recorded values, with the histogram's
+         * resolution
+         *
+         * @arg percentile in [0, 100], e.g. 99.9
+         */
+        uint64_t getPercentile(double percentile) const;
+
+        /** Adds the values of another histogram, which must have the same
+         * resolution
+         */
+        void merge(Histogram const& other);
+
+        void reset();
+
+        /** Copies a histogram of the same resolution that may be being
+         * recorded by another thread
+         *
+         * The copy is not consistent by itself if a value gets recorded
+         * concurrently; the caller has to detect this, e.g. with a seqlock
+         * as StatusCounters does. Unlike the assignment operator, it does
+         * not allocate memory.
+         */
+        void load(Histogram const& source);
+
+    private:
+        unsigned int m_sub_bucket_bits;
+        uint64_t m_max_value;
+        std::vector<uint64_t> m_counts;
+        uint64_t m_count;
+        uint64_t m_sum;
+        uint64_t m_min;
+        uint64_t m_max;
+
+        static uint64_t get(uint64_t const& value)
+        { return __atomic_load_n(&value, __ATOMIC_RELAXED); }
+        static void set(uint64_t& value, uint64_t new_value)
+        { __atomic_store_n(&value, new_value, __ATOMIC_RELAXED); }
+
+        size_t getBucketIndex(uint64_t value) const
+        {
+            uint64_t sub_bucket_count = uint64_t(1) << m_sub_bucket_bits;
+            if (value < sub_bucket_count)
+                return value;
+            // 'shift' is the number of low bits the bucket does not resolve
+            unsigned int shift = (63 - __builtin_clzll(value)) - m_sub_bucket_bits;
+            return shift * sub_bucket_count + (value >> shift);
+        }
+
+        /** The largest value counted in the given bucket */
+        uint64_t getBucketMaxValue(size_t index) const;
+    };
+}
+
+#endif
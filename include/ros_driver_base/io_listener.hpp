@@ -1,7 +1,8 @@
-#ifndef ROS_DRIVER_BASE_DRIVER_HPP
-#define ROS_DRIVER_BASE_DRIVER_HPP
+#ifndef ROS_DRIVER_BASE_IO_LISTENER_HPP
+#define ROS_DRIVER_BASE_IO_LISTENER_HPP
 
 #include <boost/cstdint.hpp>
+#include <ros/time.h>
 #include <vector>
 
 namespace ros_driver_base
@@ -41,6 +42,123 @@ namespace ros_driver_base
          */
         virtual void readData(boost::uint8_t const* data, size_t size);
     };
+
+    /** Implementation of an IOListener that keeps the last data read and
+     * written in fixed-size ring buffers
+     *
+     * Unlike BufferListener, it never allocates after construction, so it
+     * can stay attached to a driver permanently, e.g. to dump the last
+     * exchanges with the device when something goes wrong.
+     *
+     * Each ring is stored twice back to back, which makes its content
+     * contiguous in memory whatever its position. This way, the views
+     * returned by readView and writeView need no copy.
+     *
+     * The rings are bounded in size. setMaxAge also bounds them in time, to
+     * keep e.g. only the last seconds before a fault.
+     */
+    class RingBufferListener : public IOListener
+    {
+    public:
+        /** What to do with new data when a ring is full */
+        enum OverflowPolicy
+        {
+            /** Discard the oldest data to make room */
+            OVERWRITE_OLDEST,
+            /** Discard the new data */
+            DROP_NEWEST
+        };
+
+        /** A contiguous view on the content of a ring, oldest byte first.
+         * It is invalidated by the next call to the listener
+         */
+        struct View
+        {
+            boost::uint8_t const* data;
+            size_t size;
+        };
+
+        /**
+         * @arg capacity the size of each of the read and write rings, in bytes
+         */
+        RingBufferListener(size_t capacity, OverflowPolicy policy = OVERWRITE_OLDEST);
+
+        /** The data read from the device */
+        View readView() const;
+        /** The data written to the device */
+        View writeView() const;
+
+        /** Discards the data older than \c max_age, or disables the time
+         * bound if it is zero (the default)
+         *
+         * The time of each call to the listener is recorded in a ring of \c
+         * max_chunks entries, allocated here. If more calls are in the
+         * rings, consecutive calls share the time of the newest one, which
+         * makes their data stay longer than \c max_age.
+         */
+        void setMaxAge(ros::Duration const& max_age, size_t max_chunks = 1024);
+
+        /** Count of read bytes discarded because of the overflow policy */
+        boost::uint64_t getDroppedRead() const;
+        /** Count of written bytes discarded because of the overflow policy */
+        boost::uint64_t getDroppedWrite() const;
+
+        /** Empties both rings */
+        void clear();
+
+        virtual void writeData(boost::uint8_t const* data, size_t size);
+        virtual void readData(boost::uint8_t const* data, size_t size);
+
+    private:
+        class Ring
+        {
+            /** The time at which the data up to \c end was received */
+            struct Stamp
+            {
+                boost::uint64_t end;
+                boost::int64_t time;
+            };
+
+            std::vector<boost::uint8_t> m_data;
+            size_t m_capacity;
+            size_t m_start;
+            size_t m_size;
+            boost::uint64_t m_dropped;
+            /** Count of bytes that went through the ring, i.e. the position
+             * of its end in the stream
+             */
+            boost::uint64_t m_position;
+
+            std::vector<Stamp> m_stamps;
+            size_t m_stamp_start;
+            size_t m_stamp_count;
+
+            void copy(size_t position, boost::uint8_t const* data, size_t size);
+            /** Count of bytes at the start of the ring received before \c time */
+            size_t countOlderThan(boost::int64_t time) const;
+
+        public:
+            explicit Ring(size_t capacity);
+            void setStampCapacity(size_t capacity);
+            void push(boost::uint8_t const* data, size_t size, OverflowPolicy policy, boost::int64_t now);
+            /** Discards the data received before \c time */
+            void evict(boost::int64_t time);
+            /** Returns the data received from \c time on */
+            View view(boost::int64_t time) const;
+            boost::uint64_t dropped() const { return m_dropped; }
+            void clear();
+        };
+
+        /** Returns the time before which data is discarded */
+        boost::int64_t getOldestTime() const;
+        void pushData(Ring& ring, boost::uint8_t const* data, size_t size);
+
+        OverflowPolicy const m_policy;
+        /** Maximum age of the data in nanoseconds, or zero */
+        boost::int64_t m_max_age;
+        Ring m_read;
+        Ring m_write;
+    };
 }
 
 #endif
@@ -0,0 +1,113 @@
+#ifndef ROS_DRIVER_BASE_IO_SCHEDULER_HPP
+#define ROS_DRIVER_BASE_IO_SCHEDULER_HPP
+
+#include <ros_driver_base/driver.hpp>
+#include <map>
+#include <boost/function.hpp>
+
+namespace ros_driver_base
+{
+    /** Interface to the event loops that drive event-based I/O
+     *
+     * A scheduler calls back once a file descriptor becomes readable or
+     * writable, or once a deadline on the Deadline clock is reached. This is
+     * what co_readPacket and co_writePacket suspend on, so integrating them
+     * with an existing executor only requires implementing this interface.
+     */
+    class IOScheduler
+    {
+    public:
+        enum Event { READ, WRITE };
+
+        /** Called once, with timed_out set if the deadline was reached before
+         * the file descriptor got ready
+         */
+        typedef boost::function<void (bool timed_out)> Callback;
+
+        virtual ~IOScheduler() {}
+
+        /** Registers a one-shot wait
+         *
+         * There can be at most one READ and one WRITE wait per file
+         * descriptor. The callback may register new waits, including on the
+         * same file descriptor.
+         *
+         * @arg deadline the time at which the wait times out, as returned by
+         *   Deadline::toNSec
+         */
+        virtual void waitFD(int fd, Event event, int64_t deadline, Callback const& callback) = 0;
+
+        /** Removes a wait without calling its callback
+         *
+         * @return false if there was no such wait
+         */
+        virtual bool cancel(int fd, Event event) = 0;
+    };
+
+    /** Single-threaded IOScheduler based on Linux's epoll
+     *
+     * Waits are dispatched by run() or runOnce(), which must be called from
+     * the thread that registers the waits.
+     *
+     * <code>
+     * EpollScheduler scheduler;
+     * for (size_t i = 0; i < devices.size(); ++i)
+     *     pollDevice(devices[i], scheduler); // coroutines that co_await co_readPacket
+     * scheduler.run();
+     * </code>
+     */
+    class EpollScheduler : public IOScheduler
+    {
+    public:
+        EpollScheduler();
+
+        void waitFD(int fd, Event event, int64_t deadline, Callback const& callback);
+        bool cancel(int fd, Event event);
+
+        /** Waits at most \c timeout for events and processes them
+         *
+         * @return the number of callbacks called
+         */
+        size_t runOnce(ros::Duration const& timeout);
+
+        /** Processes events until stop() is called or there are no waits
+         * left
+         */
+        void run();
+
+        /** Makes run() return after the current iteration */
+        void stop();
+
+        /** Number of registered waits */
+        size_t getWaitCount() const;
+
+    private:
+        typedef std::multimap<int64_t, std::pair<int, Event> > Timers;
+
+        struct Wait
+        {
+            bool active;
+            Callback callback;
+            Timers::iterator timer;
+            Wait() : active(false) {}
+        };
+
+        struct Registration
+        {
+            Wait waits[2];
+            /** Events the epoll set currently watches for this FD */
+            uint32_t events;
+            Registration() : events(0) {}
+        };
+
+        FileGuard m_epoll_fd;
+        std::map<int, Registration> m_fds;
+        Timers m_timers;
+        bool m_quit;
+
+        void updateInterest(int fd);
+        bool dispatch(int fd, Event event, bool timed_out);
+    };
+}
+
+#endif
@@ -6,6 +6,7 @@
 #include <stdio.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 
 #include <ros/time.h>
 
@@ -26,6 +27,22 @@ namespace ros_driver_base
         virtual size_t write(uint8_t const* buffer, size_t buffer_size) = 0;
         virtual void clear() = 0;
 
+        /** Writes several buffers and returns the count of bytes written
+         *
+         * The default implementation calls write() for each buffer in turn,
+         * and stops at the first partial write. Streams for which it makes
+         * sense override it to write all buffers in a single call.
+         */
+        virtual size_t writev(struct iovec const* iov, int iovcnt);
+
+        /** True if writev writes all buffers in a single call
+         *
+         * Otherwise, Driver::writePackets writes the packets one by one, so
+         * that each call is accounted for in its statistics. The default
+         * implementation returns false
+         */
+        virtual bool hasVectoredWrite() const;
+
         /** If this IOStream is attached to a file descriptor, return it. Otherwise,
          * returns INVALID_FD;
          *
@@ -38,6 +55,10 @@ namespace ros_driver_base
     class FDStream : public IOStream
     {
         bool m_auto_close;
+        /** True if the file descriptor is a datagram socket, in which case
+         * buffers must not be merged by writev
+         */
+        bool m_datagram;
 
     protected:
 	int m_fd;
@@ -51,6 +72,8 @@ namespace ros_driver_base
         virtual void waitWrite(ros::Duration const& timeout);
         virtual size_t read(uint8_t* buffer, size_t buffer_size);
         virtual size_t write(uint8_t const* buffer, size_t buffer_size);
+        virtual size_t writev(struct iovec const* iov, int iovcnt);
+        virtual bool hasVectoredWrite() const;
         virtual void clear();
 
         /** Sets the NONBLOCK flag on the given file descriptor and returns true if
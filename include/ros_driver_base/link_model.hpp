@@ -0,0 +1,43 @@
+#ifndef ROS_DRIVER_BASE_LINK_MODEL_HPP
+#define ROS_DRIVER_BASE_LINK_MODEL_HPP
+
+#include <stdint.h>
+#include <ros/time.h>
+
+namespace ros_driver_base {
+    /** Timing and error model of the link simulated by TestStream
+     *
+     * It applies to the data pushed to the driver, which is released byte
+     * by byte on the stream's VirtualClock. Random draws use a generator
+     * initialized with \c seed, so that a test gives the same result on
+     * every run.
+     *
+     * @see TestStream::setLinkModel
+     */
+    struct LinkModel
+    {
+        /** Bit rate of the link, with 10 bits per byte as on a 8N1 serial
+         * line. Zero transfers the bytes instantly (the default)
+         */
+        unsigned int baud_rate;
+        /** Delay between the time data is sent and the time its first byte
+         * starts being transferred. For mock replies, the data is sent when
+         * the last byte of the expectation reached the device
+         */
+        ros::Duration latency;
+        /** Maximum random delay added to the latency of each chunk of data.
+         * The order of the bytes is preserved
+         */
+        ros::Duration jitter;
+        /** Probability that a byte is lost */
+        double drop_rate;
+        /** Probability that a byte has one of its bits flipped */
+        double corruption_rate;
+        uint32_t seed;
+
+        LinkModel()
+            : baud_rate(0), drop_rate(0), corruption_rate(0), seed(0) {}
+    };
+}
+
+#endif
@@ -0,0 +1,139 @@
+#ifndef ROS_DRIVER_BASE_PARALLEL_EXTRACTOR_HPP
+#define ROS_DRIVER_BASE_PARALLEL_EXTRACTOR_HPP
+
+#include <ros_driver_base/driver.hpp>
+#include <string>
+#include <vector>
+#include <sys/uio.h>
+
+namespace ros_driver_base
+{
+    /** Extracts the packets of recorded data using a driver's extractPacket,
+     * on several threads
+     *
+     * The data is split in as many segments as there are threads, and each
+     * thread scans its segment as if the data started there. Since the scan
+     * only depends on the position it is at, a segment's scan gives the same
+     * result as the sequential one from the first position they share. The
+     * segments are then merged in order, rescanning sequentially from the
+     * end of the previous segment until such a resynchronization point is
+     * found. The result is therefore always identical to extractSequential.
+     *
+     * The scan is the one of Driver::readPacket when all the data is
+     * already available: it looks for packets in windows of MAX_PACKET_SIZE
+     * bytes, and stops at the first incomplete packet at the end of the
+     * data. If extractPacket waits for more data in a full window, which
+     * would make readPacket throw, the scan skips one byte instead.
+     *
+     * The driver's extractPacket is called concurrently, so it must not
+     * modify the driver. Unlike readPacket, the driver's statistics are not
+     * updated.
+     *
+     * The data can be given as several buffers, which are scanned as if they
+     * were contiguous. This allows to scan a ReplayStream's mapped chunks
+     * without copying them:
+     *
+     * <code>
+     * ReplayStream replay("bus.0.pcapng", 0);
+     * ParallelExtractor extractor(driver);
+     * std::vector<ParallelExtractor::Packet> packets =
+     *     extractor.extract(replay.getBuffers());
+     * </code>
+     */
+    class ParallelExtractor
+    {
+    public:
+        /** A packet, as a range in the data given to extract(). When the
+         * data is given as several buffers, the offset is the one in their
+         * concatenation
+         */
+        struct Packet
+        {
+            size_t offset;
+            size_t size;
+
+            bool operator ==(Packet const& other) const
+            { return offset == other.offset && size == other.size; }
+        };
+
+        /**
+         * @arg driver the driver whose extractPacket is used. It must outlive
+         *   the extractor
+         * @arg thread_count the number of threads. Zero uses one per core
+         */
+        ParallelExtractor(Driver const& driver, size_t thread_count = 0);
+
+        /** Returns the packets found in the data, in order */
+        std::vector<Packet> extract(uint8_t const* data, size_t size) const;
+
+        /** Returns the packets found in the concatenation of the buffers,
+         * in order. Only the windows that span several buffers get copied
+         */
+        std::vector<Packet> extract(std::vector<struct iovec> const& buffers) const;
+
+        /** Single-threaded implementation of extract() */
+        std::vector<Packet> extractSequential(uint8_t const* data, size_t size) const;
+
+        /** Single-threaded implementation of extract() */
+        std::vector<Packet> extractSequential(std::vector<struct iovec> const& buffers) const;
+
+    private:
+        /** Per-scan position in the input */
+        struct Cursor
+        {
+            /** Index of the buffer the last window started in */
+            size_t buffer;
+            /** Copy of the last window that spanned several buffers */
+            std::vector<uint8_t> scratch;
+        };
+
+        /** The buffers given to extract(), seen as a single byte range */
+        struct Input
+        {
+            std::vector<struct iovec> const& buffers;
+            /** Offset of each buffer in the range */
+            std::vector<size_t> starts;
+            size_t size;
+
+            Input(std::vector<struct iovec> const& buffers);
+
+            /** Returns \c length contiguous bytes starting at \c position */
+            uint8_t const* window(size_t position, size_t length, Cursor& cursor) const;
+        };
+
+        struct Scan
+        {
+            /** Positions at which extractPacket got called, only at the
+             * start of the segment
+             */
+            std::vector<size_t> positions;
+            std::vector<Packet> packets;
+            /** Position at which the scan left its segment */
+            size_t exit;
+            /** True if the scan reached an incomplete packet at the end of
+             * the data
+             */
+            bool finished;
+        };
+
+        Driver const& m_driver;
+        size_t m_thread_count;
+
+        /** Scans from \c start until the position gets past \c end, or until
+         * it reaches a position \c join went through. The positions below
+         * \c record_until are recorded in \c result. Returns the position
+         * where it stopped
+         */
+        size_t scan(Input const& input, size_t start, size_t end,
+                Scan& result, size_t record_until, Scan const* join = 0) const;
+        void scanSegment(Input const* input, size_t start, size_t end, Scan* result) const;
+
+        /** True if the scan went through \c position, either within its
+         * recorded positions or at the start of one of its packets
+         */
+        static bool isJoinPoint(Scan const& scan, size_t position);
+        static std::vector<struct iovec> toBuffers(uint8_t const* data, size_t size);
+    };
+}
+
+#endif
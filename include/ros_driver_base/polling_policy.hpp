@@ -0,0 +1,41 @@
+#ifndef ROS_DRIVER_BASE_POLLING_POLICY_HPP
+#define ROS_DRIVER_BASE_POLLING_POLICY_HPP
+
+#include <ros/time.h>
+
+namespace ros_driver_base {
+    /** Busy-polling settings for Driver::readPacket
+     *
+     * When enabled, readPacket keeps calling the non-blocking read for up to
+     * the spin budget before falling back to a blocking wait, trading CPU
+     * time for wakeup latency. It is meant for drivers that run on dedicated
+     * cores.
+     *
+     * @see Driver::setPollingPolicy
+     */
+    struct PollingPolicy
+    {
+        /** Maximum time spent busy-polling before blocking. Zero disables
+         * polling (the default)
+         */
+        ros::Duration max_spin;
+        /** Lower bound of the spin budget when it is adapted */
+        ros::Duration min_spin;
+        /** If true, the spin budget is adapted to the time the driver
+         * usually has to wait for data: twice the usual wait, kept between
+         * min_spin and max_spin. If data usually takes longer than max_spin
+         * to arrive, the budget is reduced to min_spin as spinning would
+         * only burn CPU. The waits
+         * keep being timed then, so that the budget grows back when data
+         * arrives sooner again.
+         */
+        bool adaptive;
+        /** Number of pause instructions between two reads */
+        unsigned int pause_count;
+
+        PollingPolicy()
+            : adaptive(true), pause_count(16) {}
+    };
+}
+
+#endif
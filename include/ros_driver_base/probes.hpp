@@ -0,0 +1,69 @@
+#ifndef ROS_DRIVER_BASE_PROBES_HPP
+#define ROS_DRIVER_BASE_PROBES_HPP
+
+/** Static tracepoints (USDT) on the I/O paths of the library
+ *
+ * When the library is built with <sys/sdt.h> available (systemtap-sdt-dev
+ * on Debian/Ubuntu), the following probes of the ros_driver_base provider
+ * are compiled in:
+ *
+ * <ul>
+ * <li>read(fd, requested, result): after each read on the driver's stream.
+ *     The result is the count of bytes read
+ * <li>extract(buffer_size, result): after each call to extractPacket
+ * <li>packet(fd, size): when readPacket or tryReadPacket returns a packet
+ * <li>write(fd, requested, result): after each write on the driver's stream
+ * <li>timeout(fd, type): when readPacket, writePacket or writePackets throw
+ *     TimeoutError. type is the TimeoutError::TIMEOUT_TYPE
+ * <li>wait_start(fd, event, timeout_ns) and wait_done(fd, event, result):
+ *     around the select() of FDStream::waitRead (event 0) and
+ *     FDStream::waitWrite (event 1). The result is the one of select()
+ * </ul>
+ *
+ * Each probe has a semaphore, which the tracer sets while the probe is in
+ * use. The probe's arguments are only computed then, so that a disabled
+ * probe costs a load and a not-taken branch. For instance:
+ *
+ * <code>
+ * bpftrace -p PID -e 'usdt:/path/to/libros_driver_base.so:ros_driver_base:packet { @size = hist(arg1); }'
+ * perf probe -x /path/to/libros_driver_base.so sdt_ros_driver_base:timeout
+ * </code>
+ *
+ * Without <sys/sdt.h>, the probes compile to nothing.
+ */
+
+#ifdef ROS_DRIVER_BASE_HAVE_SDT
+
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+#define ROS_DRIVER_BASE_PROBE_SEMAPHORE(name) ros_driver_base_##name##_semaphore
+#define ROS_DRIVER_BASE_PROBE_ENABLED(name) \
+    __builtin_expect(ROS_DRIVER_BASE_PROBE_SEMAPHORE(name) != 0, 0)
+
+extern "C"
+{
+    extern unsigned short ROS_DRIVER_BASE_PROBE_SEMAPHORE(read);
+    extern unsigned short ROS_DRIVER_BASE_PROBE_SEMAPHORE(extract);
+    extern unsigned short ROS_DRIVER_BASE_PROBE_SEMAPHORE(packet);
+    extern unsigned short ROS_DRIVER_BASE_PROBE_SEMAPHORE(write);
+    extern unsigned short ROS_DRIVER_BASE_PROBE_SEMAPHORE(timeout);
+    extern unsigned short ROS_DRIVER_BASE_PROBE_SEMAPHORE(wait_start);
+    extern unsigned short ROS_DRIVER_BASE_PROBE_SEMAPHORE(wait_done);
+}
+
+#define ROS_DRIVER_BASE_PROBE2(name, arg1, arg2) \
+    do { if (ROS_DRIVER_BASE_PROBE_ENABLED(name)) \
+        DTRACE_PROBE2(ros_driver_base, name, arg1, arg2); } while (0)
+#define ROS_DRIVER_BASE_PROBE3(name, arg1, arg2, arg3) \
+    do { if (ROS_DRIVER_BASE_PROBE_ENABLED(name)) \
+        DTRACE_PROBE3(ros_driver_base, name, arg1, arg2, arg3); } while (0)
+
+#else
+
+#define ROS_DRIVER_BASE_PROBE2(name, arg1, arg2) do {} while (0)
+#define ROS_DRIVER_BASE_PROBE3(name, arg1, arg2, arg3) do {} while (0)
+
+#endif
+
+#endif
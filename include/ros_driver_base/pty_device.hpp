@@ -0,0 +1,117 @@
+#ifndef ROS_DRIVER_BASE_PTY_DEVICE_HPP
+#define ROS_DRIVER_BASE_PTY_DEVICE_HPP
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+namespace ros_driver_base
+{
+    /** Emulation of a serial device on a pseudo-terminal
+     *
+     * It creates a pseudo-terminal pair and plays the device on the master
+     * side, while drivers open the slave side as they would open a serial
+     * port, through the kernel's tty layer:
+     *
+     * <code>
+     * PtyDevice device;
+     * device.setStreaming(pattern, 11520);
+     * device.addReply(version_request, version_reply);
+     * device.start();
+     * driver.openURI(device.getURI(115200));
+     * </code>
+     *
+     * The device can stream a pattern continuously at a given byte rate, and
+     * answer scripted requests. The baud rate given to the driver does not
+     * influence the emulated link, as pseudo-terminals ignore it.
+     *
+     * The ros_driver_pty_device tool runs a PtyDevice from the command line.
+     */
+    class PtyDevice
+    {
+    public:
+        /** Creates the pseudo-terminal pair
+         *
+         * @throws UnixError if it cannot be created
+         */
+        PtyDevice();
+        ~PtyDevice();
+
+        /** Path of the slave side, e.g. /dev/pts/3 */
+        std::string getSlavePath() const;
+
+        /** A serial:// URI to open the slave side with Driver::openURI */
+        std::string getURI(int baud_rate = 115200) const;
+
+        /** Makes the device send \c pattern repeatedly
+         *
+         * @arg byte_rate the rate in bytes per second. Zero disables the
+         *   streaming
+         * @arg chunk_size how many bytes are written at once. Zero writes
+         *   the pattern at once
+         */
+        void setStreaming(std::vector<uint8_t> const& pattern, double byte_rate,
+                size_t chunk_size = 0);
+
+        /** Makes the device send \c reply each time it receives \c request */
+        void addReply(std::vector<uint8_t> const& request, std::vector<uint8_t> const& reply);
+
+        /** Starts the device's thread */
+        void start();
+
+        /** Stops the device's thread */
+        void stop();
+
+        /** Bytes written on the pseudo-terminal */
+        uint64_t getSentBytes() const;
+        /** Bytes that could not be written because the driver did not read
+         * fast enough
+         */
+        uint64_t getDroppedBytes() const;
+        /** Bytes received from the driver */
+        uint64_t getReceivedBytes() const;
+        /** Count of requests answered */
+        uint64_t getReplyCount() const;
+
+    private:
+        struct Reply
+        {
+            std::vector<uint8_t> request;
+            std::vector<uint8_t> reply;
+        };
+
+        int m_master;
+        /** The device keeps the slave side open, so that it remains usable
+         * when no driver has it open
+         */
+        int m_slave;
+        std::string m_slave_path;
+
+        boost::mutex m_mutex;
+        std::vector<uint8_t> m_pattern;
+        double m_byte_rate;
+        size_t m_chunk_size;
+        size_t m_pattern_offset;
+        std::vector<Reply> m_replies;
+        /** Received bytes not matched by a request yet */
+        std::vector<uint8_t> m_received;
+
+        boost::atomic<bool> m_stop;
+        boost::thread m_thread;
+        boost::atomic<uint64_t> m_sent_bytes;
+        boost::atomic<uint64_t> m_dropped_bytes;
+        boost::atomic<uint64_t> m_received_bytes;
+        boost::atomic<uint64_t> m_reply_count;
+
+        void run();
+        void send(uint8_t const* data, size_t size);
+        /** Sends the next streaming chunk and returns its size */
+        size_t sendChunk();
+        void processReceived();
+    };
+}
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef ROS_DRIVER_BASE_REPLAY_STREAM_HPP
+#define ROS_DRIVER_BASE_REPLAY_STREAM_HPP
+
+#include <ros_driver_base/io_stream.hpp>
+#include <string>
+#include <vector>
+#include <sys/uio.h>
+
+namespace ros_driver_base
+{
+    /** IOStream that plays back the data recorded by a CaptureListener
+     *
+     * The pcapng file is memory-mapped and indexed when the stream is
+     * created. The data read from the device on the selected stream is then
+     * returned by read() with its original chunking, each chunk becoming
+     * available at its original time relative to the first one, scaled by
+     * the speed factor. A speed of zero replays as fast as possible. Written
+     * data is discarded. Captures that were not closed, e.g. because the
+     * recording process crashed, are replayed up to their last block.
+     *
+     * It is usually opened with Driver::openURI:
+     *
+     * <code>
+     * driver.openURI("replay:///var/log/robot/bus.0.pcapng?speed=2&stream=1");
+     * </code>
+     */
+    class ReplayStream : public IOStream
+    {
+    public:
+        /**
+         * @arg path the pcapng file
+         * @arg speed the replay speed relative to the original timing, or
+         *   zero to replay as fast as possible
+         * @arg stream the index of the recorded stream (pcapng interface)
+         *   to replay
+         * @throws UnixError if the file cannot be mapped, and
+         *   std::runtime_error if it is not a valid pcapng file
+         */
+        ReplayStream(std::string const& path, double speed = 1, unsigned int stream = 0);
+        ~ReplayStream();
+
+        virtual void waitRead(ros::Duration const& timeout);
+        virtual void waitWrite(ros::Duration const& timeout);
+        virtual size_t read(uint8_t* buffer, size_t buffer_size);
+        virtual size_t write(uint8_t const* buffer, size_t buffer_size);
+        /** Skips the chunks that are already available */
+        virtual void clear();
+
+        /** Number of chunks in the replayed stream */
+        size_t getChunkCount() const;
+
+        /** Index of the next chunk to be read */
+        size_t getPosition() const;
+
+        /** True once all chunks have been read */
+        bool isFinished() const;
+
+        /** Capture time of the first chunk */
+        ros::Time getStartTime() const;
+
+        /** Capture time of the last chunk */
+        ros::Time getEndTime() const;
+
+        /** Restarts the replay at the first chunk captured at or after the
+         * given time. The timing restarts from there as well
+         */
+        void seek(ros::Time const& time);
+
+        /** Restarts the replay at the given chunk */
+        void seekToChunk(size_t index);
+
+        /** Returns all the replayed data at once, as a copy */
+        std::vector<uint8_t> getData() const;
+
+        /** Returns the replayed chunks, in order, as pointers in the mapped
+         * file, e.g. for offline processing with ParallelExtractor. They
+         * remain valid as long as the stream exists
+         */
+        std::vector<struct iovec> getBuffers() const;
+
+    private:
+        struct Chunk
+        {
+            /** Capture time in nanoseconds */
+            int64_t time;
+            size_t offset;
+            size_t size;
+
+            bool operator <(Chunk const& other) const { return time < other.time; }
+        };
+
+        int m_fd;
+        uint8_t const* m_map;
+        size_t m_map_size;
+        double m_speed;
+
+        std::vector<Chunk> m_chunks;
+        size_t m_position;
+        /** Bytes of the current chunk already read */
+        size_t m_chunk_offset;
+
+        /** Whether m_base_time is set. It is set on the first access after
+         * construction or a seek
+         */
+        bool m_started;
+        /** Time on the Deadline clock at which the chunk at m_base_chunk is
+         * available
+         */
+        int64_t m_base_time;
+        size_t m_base_chunk;
+
+        void index(unsigned int stream);
+        /** Time on the Deadline clock at which the current chunk is
+         * available
+         */
+        int64_t getAvailabilityTime();
+    };
+}
+
+#endif
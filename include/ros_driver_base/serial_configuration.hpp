@@ -0,0 +1,35 @@
+#ifndef ROS_DRIVER_BASE_SERIAL_CONFIGURATION_HPP
+#define ROS_DRIVER_BASE_SERIAL_CONFIGURATION_HPP
+
+namespace ros_driver_base {
+    /** Latency-related settings applied by Driver::openSerialIO
+     *
+     * They can be given in a serial:// URI as query options, e.g.
+     * serial:///dev/ttyUSB0:2000000?low_latency=1&latency_timer=1
+     */
+    struct SerialConfiguration
+    {
+        /** Sets the ASYNC_LOW_LATENCY flag on the tty (Linux only), which
+         * makes the kernel push received bytes to user space right away
+         * instead of batching them
+         */
+        bool low_latency;
+        /** termios VMIN value (minimum byte count for a read). Only relevant
+         * if the file descriptor is put back in blocking mode
+         */
+        int vmin;
+        /** termios VTIME value (inter-byte timeout in tenths of seconds).
+         * Only relevant if the file descriptor is put back in blocking mode
+         */
+        int vtime;
+        /** Latency timer of USB-serial adapters (e.g. FTDI) in milliseconds,
+         * set through sysfs. -1 leaves the adapter's value untouched.
+         */
+        int latency_timer;
+
+        SerialConfiguration()
+            : low_latency(true), vmin(0), vtime(0), latency_timer(-1) {}
+    };
+}
+
+#endif
@@ -0,0 +1,213 @@
+#ifndef ROS_DRIVER_BASE_STATS_REGISTRY_HPP
+#define ROS_DRIVER_BASE_STATS_REGISTRY_HPP
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <ros/time.h>
+#include <ros_driver_base/status.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+namespace ros_driver_base
+{
+    class Driver;
+
+    /** Binary layout of the shared-memory statistics page of StatsRegistry
+     *
+     * The page is a Header followed by Header::slot_count slots. All fields
+     * are in the host's byte order. New fields are only ever appended to the
+     * structures, and readers use Header::header_size and Header::slot_size
+     * to find the slots, so that older readers can read newer pages. The
+     * version is bumped on incompatible changes.
+     */
+    namespace stats_page
+    {
+        static const char MAGIC[8] = { 'R', 'D', 'B', 'S', 'T', 'A', 'T', 'S' };
+        static const uint32_t VERSION = 1;
+        static const size_t LABEL_SIZE = 56;
+
+        struct Header
+        {
+            char magic[8];
+            uint32_t version;
+            uint32_t header_size;
+            uint32_t slot_size;
+            uint32_t slot_count;
+            /** PID of the process that owns the page */
+            int32_t pid;
+            uint32_t reserved;
+            /** Period at which the slots get updated, in nanoseconds */
+            int64_t update_period;
+        };
+
+        /** Summary of a Histogram */
+        struct HistogramSummary
+        {
+            uint64_t count;
+            uint64_t min;
+            uint64_t max;
+            uint64_t mean;
+            uint64_t p50;
+            uint64_t p90;
+            uint64_t p99;
+            uint64_t p999;
+        };
+
+        enum SlotState
+        {
+            SLOT_FREE = 0,
+            SLOT_USED = 1
+        };
+
+        /** The statistics of one driver. The fields are the ones of Status
+         *
+         * The slot is a seqlock: its sequence number is odd while the slot
+         * gets updated. Readers copy the slot and retry until they got the
+         * same even sequence number before and after the copy.
+         */
+        struct Slot
+        {
+            uint32_t sequence;
+            /** One of SlotState */
+            uint32_t state;
+            /** Zero-terminated driver name given to StatsRegistry::add */
+            char label[LABEL_SIZE];
+            /** Time of the last update of the slot on CLOCK_MONOTONIC, in
+             * nanoseconds. Use it to compute rates
+             */
+            int64_t update_time;
+            /** Time of the driver's last I/O, in nanoseconds since the epoch */
+            int64_t stamp;
+            uint64_t tx;
+            uint64_t good_rx;
+            uint64_t bad_rx;
+            uint64_t queued_bytes;
+            uint64_t read_calls;
+            uint64_t empty_reads;
+            uint64_t write_calls;
+            uint64_t partial_writes;
+            uint64_t wait_calls;
+            uint64_t spurious_wakeups;
+            uint64_t extract_calls;
+            uint64_t reserved[3];
+            HistogramSummary packet_assembly_time;
+            HistogramSummary read_wait_time;
+            HistogramSummary write_time;
+            HistogramSummary packet_size;
+        };
+    }
+
+    /** Publishes the statistics of a set of drivers in a named POSIX
+     * shared-memory segment, for external monitoring tools such as
+     * ros_driver_stats
+     *
+     * A background thread copies the drivers' statistics to the page
+     * periodically with Driver::getStatus(Status&), which does not slow down
+     * the drivers. Drivers must be removed from the registry before they
+     * are destroyed.
+     *
+     * <code>
+     * StatsRegistry registry("my_robot");
+     * registry.add(imu, "imu");
+     * registry.add(motors, "motors");
+     * registry.start();
+     * </code>
+     *
+     * and then, from a shell, <tt>ros_driver_stats my_robot</tt>
+     */
+    class StatsRegistry
+    {
+    public:
+        /**
+         * @arg name the name of the shared-memory segment, as given to
+         *   shm_open. A leading slash is added if needed
+         * @arg slot_count the maximum number of registered drivers
+         * @arg period the period of the updates of the page
+         * @throws UnixError if the segment cannot be created, in particular
+         *   if it already exists. A statistics page whose process does not
+         *   exist anymore is replaced
+         */
+        StatsRegistry(std::string const& name, size_t slot_count = 64,
+                ros::Duration const& period = ros::Duration(0.1));
+
+        /** Stops the updates and unlinks the shared-memory segment */
+        ~StatsRegistry();
+
+        /** Adds a driver to the page
+         *
+         * @arg label the name under which the driver is shown. It is
+         *   truncated to stats_page::LABEL_SIZE - 1 characters
+         * @throws std::length_error if all slots are used
+         */
+        void add(Driver const& driver, std::string const& label);
+
+        /** Removes a driver from the page */
+        void remove(Driver const& driver);
+
+        /** Starts the thread that updates the page periodically */
+        void start();
+
+        /** Stops the update thread */
+        void stop();
+
+        /** Updates the page once. It is called periodically between start()
+         * and stop()
+         */
+        void update();
+
+        std::string getName() const;
+
+    private:
+        std::string m_name;
+        ros::Duration m_period;
+        uint8_t* m_page;
+        size_t m_page_size;
+        size_t m_slot_count;
+
+        /** The registered drivers, indexed by slot */
+        std::vector<Driver const*> m_drivers;
+        /** Statistics buffer, reused on each update */
+        Status m_status;
+
+        boost::mutex m_mutex;
+        boost::condition_variable m_stop_cond;
+        bool m_stop;
+        boost::thread m_thread;
+
+        stats_page::Slot& getSlot(size_t index);
+        void writeSlot(size_t index, Status const& status);
+        void run();
+    };
+
+    /** Read-only access to a statistics page published by StatsRegistry,
+     * possibly from another process
+     */
+    class StatsPageReader
+    {
+    public:
+        /**
+         * @throws UnixError if the segment cannot be opened and
+         *   std::runtime_error if it is not a compatible statistics page
+         */
+        explicit StatsPageReader(std::string const& name);
+        ~StatsPageReader();
+
+        stats_page::Header const& getHeader() const;
+
+        /** Copies a slot consistently and returns true if it is in use
+         *
+         * @throws std::runtime_error if the slot stays in the middle of an
+         *   update, which happens if the owner process died during one
+         */
+        bool read(size_t index, stats_page::Slot& slot) const;
+
+    private:
+        uint8_t const* m_page;
+        size_t m_page_size;
+        stats_page::Header m_header;
+    };
+}
+
+#endif
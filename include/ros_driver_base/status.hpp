@@ -1,7 +1,9 @@
 #ifndef ROS_DRIVER_BASE_STATUS_HPP
 #define ROS_DRIVER_BASE_STATUS_HPP
 
+#include <stdint.h>
 #include <ros/time.h>
+#include <ros_driver_base/histogram.hpp>
 
 namespace ros_driver_base {
     /** This structure holds IO statistics */
@@ -9,13 +11,47 @@ namespace ros_driver_base {
     {
         ros::Time stamp;
 
-	unsigned int tx; //! count of bytes received
-	unsigned int good_rx; //! count of bytes received and accepted
-	unsigned int bad_rx; //! count of bytes received and rejected
+	uint64_t tx; //! count of bytes written
+	uint64_t good_rx; //! count of bytes received and accepted
+	uint64_t bad_rx; //! count of bytes received and rejected
         unsigned int queued_bytes; //! count of bytes currently queued in the driver's internal buffer
 
+        /** Calls to the stream's read method. For file descriptors, it is
+         * the count of read() or recvfrom() system calls
+         */
+        uint64_t read_calls;
+        /** Read calls that returned no data, e.g. on EAGAIN */
+        uint64_t empty_reads;
+        /** Calls to the stream's write and writev methods */
+        uint64_t write_calls;
+        /** Write calls that did not write everything they were given */
+        uint64_t partial_writes;
+        /** Calls to the stream's waitRead and waitWrite methods, i.e.
+         * select() for file descriptors
+         */
+        uint64_t wait_calls;
+        /** Waits that returned without a timeout but after which the stream
+         * could not be read or written
+         */
+        uint64_t spurious_wakeups;
+        /** Calls to the driver's extractPacket */
+        uint64_t extract_calls;
+
+        /** Time between the reception of a packet's first byte and its
+         * extraction, in nanoseconds
+         */
+        Histogram packet_assembly_time;
+        /** Time spent in successful readPacket calls, in nanoseconds */
+        Histogram read_wait_time;
+        /** Time spent in successful writePacket calls, in nanoseconds */
+        Histogram write_time;
+        /** Size of the extracted packets, in bytes */
+        Histogram packet_size;
+
 	Status()
-	    : tx(0), good_rx(0), bad_rx(0), queued_bytes(0) {}
+	    : tx(0), good_rx(0), bad_rx(0), queued_bytes(0)
+            , read_calls(0), empty_reads(0), write_calls(0), partial_writes(0)
+            , wait_calls(0), spurious_wakeups(0), extract_calls(0) {}
     };
 }
 
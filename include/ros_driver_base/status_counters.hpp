@@ -0,0 +1,127 @@
+#ifndef ROS_DRIVER_BASE_STATUS_COUNTERS_HPP
+#define ROS_DRIVER_BASE_STATUS_COUNTERS_HPP
+
+#include <ros_driver_base/status.hpp>
+#include <boost/atomic.hpp>
+
+namespace ros_driver_base
+{
+    /** Storage for the statistics of a Driver, from which a consistent
+     * Status can be read by any thread while the driver updates it
+     *
+     * The statistics are split between the reading and the writing side of
+     * the driver. Each side must be updated by a single thread at a time,
+     * which is the case for the driver's reading and writing methods. Each
+     * side is a seqlock: an update makes its sequence number odd during the
+     * update and even again afterwards, and readers retry their copy until
+     * they got the same even sequence number before and after it. Updates
+     * are relaxed atomic stores and never wait for the readers.
+     *
+     * The two sides are aligned on cache lines, so that a thread reading
+     * and another writing through the same driver do not share them.
+     */
+    class StatusCounters
+    {
+    public:
+        /** The statistics of one side, and its sequence number */
+        struct Side
+        {
+            boost::atomic<uint32_t> sequence;
+            /** Nesting level of the Update scopes, only accessed by the
+             * updating thread
+             */
+            int depth;
+            /** Time of the last update in nanoseconds, for Status::stamp */
+            boost::atomic<int64_t> stamp;
+            boost::atomic<uint64_t> wait_calls;
+            boost::atomic<uint64_t> spurious_wakeups;
+
+            Side();
+        };
+
+        struct ReadSide : Side
+        {
+            boost::atomic<uint64_t> good_rx;
+            boost::atomic<uint64_t> bad_rx;
+            boost::atomic<uint64_t> queued_bytes;
+            boost::atomic<uint64_t> read_calls;
+            boost::atomic<uint64_t> empty_reads;
+            boost::atomic<uint64_t> extract_calls;
+            Histogram packet_assembly_time;
+            Histogram read_wait_time;
+            Histogram packet_size;
+
+            ReadSide();
+        } __attribute__((aligned(64)));
+
+        struct WriteSide : Side
+        {
+            boost::atomic<uint64_t> tx;
+            boost::atomic<uint64_t> write_calls;
+            boost::atomic<uint64_t> partial_writes;
+            Histogram write_time;
+
+            WriteSide();
+        } __attribute__((aligned(64)));
+
+        /** Scope of an update of a side. Scopes can be nested */
+        class Update
+        {
+            Side& m_side;
+        public:
+            explicit Update(Side& side)
+                : m_side(side)
+            {
+                if (m_side.depth++ == 0)
+                {
+                    m_side.sequence.store(m_side.sequence.load(boost::memory_order_relaxed) + 1,
+                            boost::memory_order_relaxed);
+                    boost::atomic_thread_fence(boost::memory_order_release);
+                }
+            }
+            ~Update()
+            {
+                if (--m_side.depth == 0)
+                {
+                    m_side.sequence.store(m_side.sequence.load(boost::memory_order_relaxed) + 1,
+                            boost::memory_order_release);
+                }
+            }
+        };
+
+        /** Adds to a counter. Only the side's updating thread may call it */
+        static void add(boost::atomic<uint64_t>& counter, uint64_t value = 1)
+        {
+            counter.store(counter.load(boost::memory_order_relaxed) + value,
+                    boost::memory_order_relaxed);
+        }
+
+        /** Sets a side's stamp to the current time */
+        static void stamp(Side& side);
+
+        ReadSide read;
+        WriteSide write;
+
+        /** Copies the statistics in \c status
+         *
+         * It retries until it gets a consistent copy of each side, without
+         * slowing down the updating threads, and does not allocate memory.
+         */
+        void load(Status& status) const;
+
+        /** Resets all statistics to zero. Unlike the other methods, it must
+         * not be called while the driver is reading or writing
+         */
+        void reset();
+
+    private:
+        /** Waits for the side's sequence number to be even and returns it */
+        static uint32_t beginLoad(Side const& side);
+        /** True if the side did not change since beginLoad returned
+         * \c sequence
+         */
+        static bool endLoad(Side const& side, uint32_t sequence);
+    };
+}
+
+#endif
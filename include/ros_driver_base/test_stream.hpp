@@ -2,8 +2,14 @@
 #define ROS_DRIVER_BASE_HPP
 
 #include <ros_driver_base/io_stream.hpp>
+#include <ros_driver_base/link_model.hpp>
+#include <ros_driver_base/virtual_clock.hpp>
 #include <vector>
 #include <list>
+#include <deque>
+#include <map>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/shared_ptr.hpp>
 #include <ros/time.h>
 
 namespace ros_driver_base
@@ -11,28 +17,234 @@ namespace ros_driver_base
     /** A IOStream meant to be used to test ros_driver_base functionality
      * from outside
      *
-     * It maintains two vectors, one the "to device" buffer and one the "from
+     * It maintains two buffers, one the "to device" buffer and one the "from
      * buffer" device. All communications are synchronous, that is waitRead will
      * throw right away if no data is available.
      * waitWrite never fails.
+     *
+     * The data pushed to the driver is queued as-is, and consumed in constant
+     * time, so that large captures can be replayed through it.
+     *
+     * In mock mode, the data written by the driver is matched byte by byte
+     * against the expectations, which are sent their reply as soon as they
+     * are complete. Expectations set with EXPECT_REPLY are matched in order.
+     * Consecutive expectations set with EXPECT_UNORDERED_REPLY form a set
+     * whose elements can be matched in any order, and which must be
+     * exhausted before the next expectations. Within a set, the
+     * expectations are indexed by their unmasked leading bytes in a prefix
+     * tree, and the first complete match wins. A mask can be given to match only some bits of the
+     * received bytes, a zero mask byte being a wildcard.
+     *
+     * By default, pushed data is available to the driver right away. With
+     * setLinkModel, it is instead released at the link's rate and after its
+     * latency, on a VirtualClock that waitRead advances: waitRead returns
+     * when the next byte arrives, or throws after advancing the clock by the
+     * whole timeout. Install this clock with ScopedClock, or use
+     * Fixture::useVirtualClock, to run the driver's timeouts on it as well.
      */
 
     class TestStream : public IOStream
     {
-        std::vector<uint8_t> to_driver;
+    public:
+        /** How read() splits the data pushed to the driver
+         *
+         * @see setFragmentation
+         */
+        enum Fragmentation
+        {
+            /** Each read returns as much data as the driver asks for */
+            NO_FRAGMENTATION,
+            /** Each read returns at most a fixed number of bytes */
+            FIXED_FRAGMENTS,
+            /** Each read returns at most a random number of bytes */
+            RANDOM_FRAGMENTS
+        };
+
+    private:
+        /** A chunk of data pushed to the driver */
+        struct Chunk
+        {
+            std::vector<uint8_t> data;
+            /** Arrival time of the first byte on the virtual clock */
+            int64_t first_byte_time;
+            /** Time between the arrivals of two bytes */
+            int64_t byte_time;
+
+            /** Count of bytes arrived at \c time */
+            size_t getArrivedSize(int64_t time) const;
+        };
+
+        /** The data pushed to the driver, as a queue of chunks. The front
+         * chunk has been read up to to_driver_offset
+         */
+        std::deque<Chunk> to_driver;
+        size_t to_driver_offset;
+        size_t to_driver_size;
         std::vector<uint8_t> from_driver;
-        std::list<std::vector<uint8_t> > expectations;
-        std::list<std::vector<uint8_t> > replies;
         bool mock_mode;
 
+        struct Expectation
+        {
+            std::vector<uint8_t> bytes;
+            /** The bits of the received bytes that are compared with
+             * \c bytes. Empty to compare all of them
+             */
+            std::vector<uint8_t> mask;
+            std::vector<uint8_t> reply;
+            /** Order in which the expectation was set */
+            uint64_t index;
+
+            bool matches(size_t position, uint8_t byte) const;
+        };
+        typedef std::list<Expectation> ExpectationList;
+
+        /** Node of the prefix tree in which the expectations of a set are
+         * indexed. Each expectation is stored in the node of its longest
+         * unmasked prefix, so that expectations sharing a header are only
+         * compared byte by byte once their paths split
+         */
+        struct ExpectationNode
+        {
+            ExpectationNode* parent;
+            uint8_t byte;
+            std::map< uint8_t, boost::shared_ptr<ExpectationNode> > children;
+            ExpectationList expectations;
+
+            ExpectationNode() : parent(0), byte(0) {}
+        };
+
+        /** Expectations that can be matched in any order. Ordered
+         * expectations are sets of one
+         */
+        struct ExpectationSet
+        {
+            bool ordered;
+            size_t size;
+            ExpectationNode root;
+        };
+        typedef std::pair<ExpectationNode*, ExpectationList::iterator> Candidate;
+
+        std::deque<ExpectationSet> expectations;
+        /** The node of expectations.front() whose path is the bytes received
+         * since the last match, i.e. from_driver, or NULL if there is none.
+         * All expectations below it match the received bytes
+         */
+        ExpectationNode* expectation_node;
+        /** The expectations stored above expectation_node that match the
+         * received bytes, and whose remaining bytes are compared one by one
+         */
+        std::vector<Candidate> candidates;
+        uint64_t expectation_count;
+
+        Fragmentation fragmentation;
+        size_t max_fragment_size;
+        boost::random::mt19937 fragment_generator;
+
+        VirtualClock clock;
+        bool link_enabled;
+        LinkModel link;
+        boost::random::mt19937 link_generator;
+        /** Time at which the last byte queued for the driver arrives */
+        int64_t rx_end;
+        /** Time at which the last byte written by the driver reaches the
+         * device
+         */
+        int64_t tx_end;
+
+        size_t getNextFragmentSize();
+        int64_t getByteTime() const;
+        /** Queues \c data for the driver, applying the link model. The
+         * contents of \c data are swapped into the queue
+         */
+        void queueData(std::vector<uint8_t>& data, int64_t send_time);
+        void addExpectation(std::vector<uint8_t> const& expectation,
+                std::vector<uint8_t> const& mask,
+                std::vector<uint8_t> const& reply, bool ordered);
+        void matchByte(uint8_t byte);
+        void reportMismatch(size_t position);
+        static void collectExpectations(ExpectationNode const& node,
+                std::vector<Expectation const*>& result);
+        static bool isSetBefore(Expectation const* a, Expectation const* b);
+
     public:
-        TestStream(): mock_mode(false)
+        TestStream()
+            : to_driver_offset(0)
+            , to_driver_size(0)
+            , mock_mode(false)
+            , expectation_node(0)
+            , expectation_count(0)
+            , fragmentation(NO_FRAGMENTATION)
+            , max_fragment_size(0)
+            , link_enabled(false)
+            , rx_end(0)
+            , tx_end(0)
         {}
 
         /** Push data to the driver "as-if" it was coming from the device
          */
         void pushDataToDriver(std::vector<uint8_t> const& data);
 
+        /** Push data to the driver "as-if" it was coming from the device
+         */
+        void pushDataToDriver(uint8_t const* data, size_t size);
+
+        /** Push data to the driver "as-if" it was coming from the device,
+         * without copying it
+         *
+         * The stream takes ownership of the contents of \c data, which is
+         * left empty
+         */
+        void swapDataToDriver(std::vector<uint8_t>& data);
+
+#if __cplusplus >= 201103L
+        /** Push data to the driver "as-if" it was coming from the device,
+         * without copying it
+         */
+        void pushDataToDriver(std::vector<uint8_t>&& data)
+        {
+            swapDataToDriver(data);
+        }
+#endif
+
+        /** Count of bytes pushed to the driver and not read yet, including
+         * the ones that did not arrive yet on a simulated link
+         */
+        size_t getPendingDataSize() const;
+
+        /** Count of bytes that the driver can read right away */
+        size_t getAvailableDataSize() const;
+
+        /** Simulates a link between the device and the driver
+         *
+         * It applies to the data pushed after the call
+         */
+        void setLinkModel(LinkModel const& model);
+
+        /** Goes back to instant transfers. Data still in transit becomes
+         * available immediately
+         */
+        void disableLinkModel();
+
+        /** The clock on which the link is simulated
+         *
+         * Waits that time out advance it by their timeout, with or without
+         * a link model
+         */
+        VirtualClock& getClock();
+
+        /** Controls how the pushed data gets split between the reads of the
+         * driver, regardless of how it was pushed
+         *
+         * Use it to check that the driver reassembles packets received in
+         * pieces. With RANDOM_FRAGMENTS, the fragment sizes are drawn
+         * uniformly between 1 and \c max_size from a generator initialized
+         * with \c seed, so that failures can be reproduced.
+         *
+         * @arg max_size the maximum number of bytes returned by a read. It
+         *   must be strictly positive unless mode is NO_FRAGMENTATION
+         */
+        void setFragmentation(Fragmentation mode, size_t max_size = 1, uint32_t seed = 0);
+
         /** Read data that the driver sent to the device
          *
          * This contains only data sent since the last call to
@@ -47,6 +259,29 @@ namespace ros_driver_base
          * @param reply reply message to be received by the driver
          */
         void EXPECT_REPLY(std::vector<uint8_t> const& expectation, std::vector<uint8_t> const& reply);
+
+        /** Set an expectation whose bytes are compared only on the bits
+         * set in \c mask, which must have the same size
+         */
+        void EXPECT_REPLY(std::vector<uint8_t> const& expectation,
+                std::vector<uint8_t> const& mask,
+                std::vector<uint8_t> const& reply);
+
+        /** Add an expectation to a set of expectations that can be matched
+         * in any order
+         *
+         * The expectation is added to the last set if it was set with
+         * EXPECT_UNORDERED_REPLY, and starts a new set otherwise
+         */
+        void EXPECT_UNORDERED_REPLY(std::vector<uint8_t> const& expectation, std::vector<uint8_t> const& reply);
+
+        /** Add an expectation to a set of expectations that can be matched
+         * in any order, comparing only the bits set in \c mask
+         */
+        void EXPECT_UNORDERED_REPLY(std::vector<uint8_t> const& expectation,
+                std::vector<uint8_t> const& mask,
+                std::vector<uint8_t> const& reply);
+
         void waitRead(ros::Duration const& timeout);
         void waitWrite(ros::Duration const& timeout);
         size_t read(uint8_t* buffer, size_t buffer_size);
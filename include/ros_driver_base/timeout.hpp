@@ -1,16 +1,57 @@
 #ifndef ROS_DRIVER_BASE_TIMEOUT_HPP
 #define ROS_DRIVER_BASE_TIMEOUT_HPP
 
-#include <sys/time.h>
+#include <stdint.h>
+#include <ros/time.h>
 
 namespace ros_driver_base {
 
+/** A point in time on the monotonic clock, used to track timeouts with
+ * nanosecond resolution
+ *
+ * Unlike the wall clock, the monotonic clock is not affected by changes of
+ * the system time (e.g. NTP steps)
+ */
+class Deadline {
+private:
+    int64_t deadline;
+
+public:
+    /** Returns the current time of the monotonic clock in nanoseconds, or
+     * the time of the Clock installed with Clock::setCurrent
+     */
+    static int64_t now();
+
+    /**
+     * Creates a deadline that expires \c timeout from now
+     */
+    explicit Deadline(ros::Duration const& timeout);
+
+    /**
+     * Checks if the deadline is already passed.
+     * This uses a syscall, so use sparingly and cache results
+     */
+    bool elapsed() const;
+
+    /**
+     * Calculates the time left until the deadline, which is zero if it is
+     * already passed.
+     * This uses a syscall, so use sparingly and cache results
+     */
+    ros::Duration timeLeft() const;
+
+    /** The deadline on the monotonic clock, in nanoseconds */
+    int64_t toNSec() const;
+};
+
 /** A timeout tracking class
+ *
+ * New code should use Deadline, which has a nanosecond resolution
  */
 class Timeout {
 private:
     unsigned int timeout;
-    timeval start_time;
+    int64_t start_time;
 
 public:
     /**
@@ -58,4 +99,3 @@ public:
 }
 
 #endif
-
@@ -0,0 +1,43 @@
+#ifndef ROS_DRIVER_BASE_VIRTUAL_CLOCK_HPP
+#define ROS_DRIVER_BASE_VIRTUAL_CLOCK_HPP
+
+#include <stdint.h>
+#include <ros/time.h>
+#include <boost/atomic.hpp>
+#include <ros_driver_base/clock.hpp>
+
+namespace ros_driver_base {
+    /** A clock whose time only changes when it is advanced explicitly
+     *
+     * It lets TestStream simulate the timing of a link deterministically,
+     * independently of how long the test actually takes. Install it with
+     * ScopedClock to run the library's timeouts on it as well. Its wall
+     * time is its time since the epoch.
+     */
+    class VirtualClock : public Clock
+    {
+        boost::atomic<int64_t> m_time;
+
+    public:
+        /** Creates a clock starting at \c time, in nanoseconds */
+        explicit VirtualClock(int64_t time = 0);
+
+        /** The current time in nanoseconds */
+        int64_t now() const;
+
+        ros::Time getWallTime() const;
+
+        /** Advances the clock to \c time, without blocking */
+        void sleepUntil(int64_t time);
+
+        /** Moves the clock forward by \c duration */
+        void advance(ros::Duration const& duration);
+
+        /** Moves the clock forward to \c time. Does nothing if \c time is
+         * in the past, as the clock never goes backwards
+         */
+        void advanceTo(int64_t time);
+    };
+}
+
+#endif
@@ -0,0 +1,316 @@
+#include <ros_driver_base/async_listener.hpp>
+#include <ros_driver_base/timeout.hpp>
+
+#include <cstring>
+#include <stdexcept>
+#include <boost/bind.hpp>
+#include <boost/thread/locks.hpp>
+
+using namespace std;
+using namespace ros_driver_base;
+
+/** Maximum number of chunks dispatched in a single batch */
+static const size_t MAX_BATCH_SIZE = 64;
+
+AsyncListener::AsyncListener(size_t capacity, size_t chunk_size)
+    : m_capacity(capacity)
+    , m_chunk_size(chunk_size)
+    , m_running(false)
+{
+    if (capacity == 0 || capacity >= 65535)
+        throw std::invalid_argument("AsyncListener: capacity must be between 1 and 65534");
+    if (chunk_size == 0)
+        throw std::invalid_argument("AsyncListener: chunk size cannot be zero");
+}
+
+AsyncListener::~AsyncListener()
+{
+    stop();
+}
+
+void AsyncListener::addListener(IOListener* listener, int directions)
+{
+    boost::shared_ptr<Channel> channel(
+            new Channel(listener, directions, m_capacity, m_chunk_size));
+
+    boost::lock_guard<boost::mutex> lock(m_channels_mutex);
+    if (m_running)
+        channel->start();
+    m_channels.push_back(channel);
+}
+
+void AsyncListener::removeListener(IOListener* listener)
+{
+    boost::shared_ptr<Channel> channel;
+    {
+        boost::lock_guard<boost::mutex> lock(m_channels_mutex);
+        for (Channels::iterator it = m_channels.begin(); it != m_channels.end(); ++it)
+        {
+            if ((*it)->listener == listener)
+            {
+                channel = *it;
+                m_channels.erase(it);
+                break;
+            }
+        }
+    }
+
+    // The producers cannot reach the channel anymore, dispatch what is left
+    // without holding them
+    if (channel)
+        channel->stop();
+}
+
+void AsyncListener::start()
+{
+    boost::lock_guard<boost::mutex> lock(m_channels_mutex);
+    if (m_running)
+        return;
+
+    for (Channels::iterator it = m_channels.begin(); it != m_channels.end(); ++it)
+        (*it)->start();
+    m_running = true;
+}
+
+void AsyncListener::stop()
+{
+    Channels channels;
+    {
+        boost::lock_guard<boost::mutex> lock(m_channels_mutex);
+        m_running = false;
+        channels = m_channels;
+    }
+
+    for (Channels::iterator it = channels.begin(); it != channels.end(); ++it)
+        (*it)->stop();
+}
+
+bool AsyncListener::isRunning() const
+{
+    boost::lock_guard<boost::mutex> lock(m_channels_mutex);
+    return m_running;
+}
+
+bool AsyncListener::flush(ros::Duration const& timeout)
+{
+    Deadline deadline(timeout);
+    while (getStatistics().queued_chunks)
+    {
+        if (deadline.elapsed())
+            return false;
+        boost::this_thread::sleep(boost::posix_time::microseconds(100));
+    }
+    return true;
+}
+
+void AsyncListener::writeData(boost::uint8_t const* data, size_t size)
+{
+    push(WRITE, data, size);
+}
+
+void AsyncListener::readData(boost::uint8_t const* data, size_t size)
+{
+    push(READ, data, size);
+}
+
+void AsyncListener::push(Direction direction, boost::uint8_t const* data, size_t size)
+{
+    boost::lock_guard<boost::mutex> lock(m_channels_mutex);
+    for (Channels::iterator it = m_channels.begin(); it != m_channels.end(); ++it)
+    {
+        if ((*it)->directions & direction)
+            (*it)->push(direction, data, size);
+    }
+}
+
+boost::shared_ptr<AsyncListener::Channel> AsyncListener::findChannel(IOListener* listener) const
+{
+    for (Channels::const_iterator it = m_channels.begin(); it != m_channels.end(); ++it)
+    {
+        if ((*it)->listener == listener)
+            return *it;
+    }
+    throw std::invalid_argument("AsyncListener: listener is not registered");
+}
+
+AsyncListener::Statistics AsyncListener::getStatistics() const
+{
+    Statistics stats;
+    stats.queued_chunks = 0;
+    stats.dispatched_chunks = 0;
+    stats.batches = 0;
+    stats.dropped_chunks = 0;
+    stats.dropped_bytes = 0;
+
+    boost::lock_guard<boost::mutex> lock(m_channels_mutex);
+    for (Channels::const_iterator it = m_channels.begin(); it != m_channels.end(); ++it)
+        (*it)->addStatistics(stats);
+    return stats;
+}
+
+AsyncListener::ListenerStatistics AsyncListener::getListenerStatistics(IOListener* listener) const
+{
+    boost::lock_guard<boost::mutex> lock(m_channels_mutex);
+    return findChannel(listener)->getListenerStatistics();
+}
+
+AsyncListener::Channel::Channel(IOListener* listener, int directions,
+        size_t capacity, size_t chunk_size)
+    : listener(listener)
+    , directions(directions)
+    , m_chunk_size(chunk_size)
+    , m_slots(capacity)
+    , m_data(capacity * chunk_size)
+    // the lock-free queues need one node more than the elements they hold
+    , m_free(capacity + 1)
+    , m_queue(capacity + 1)
+    , m_queued(0)
+    , m_dispatched(0)
+    , m_batches(0)
+    , m_received_bytes(0)
+    , m_dropped_chunks(0)
+    , m_dropped_bytes(0)
+    , m_quit(false)
+    , m_sleeping(false)
+{
+    for (uint32_t i = 0; i < capacity; ++i)
+        m_free.push(i);
+}
+
+AsyncListener::Channel::~Channel()
+{
+    stop();
+}
+
+void AsyncListener::Channel::start()
+{
+    if (m_thread.joinable())
+        return;
+
+    m_quit.store(false);
+    m_thread = boost::thread(boost::bind(&Channel::run, this));
+}
+
+void AsyncListener::Channel::stop()
+{
+    {
+        boost::lock_guard<boost::mutex> lock(m_wakeup_mutex);
+        m_quit.store(true);
+        m_wakeup.notify_one();
+    }
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+void AsyncListener::Channel::push(Direction direction, boost::uint8_t const* data, size_t size)
+{
+    bool pushed = false;
+    while (size > 0)
+    {
+        uint32_t index;
+        if (!m_free.pop(index))
+        {
+            m_dropped_chunks.fetch_add((size + m_chunk_size - 1) / m_chunk_size, boost::memory_order_relaxed);
+            m_dropped_bytes.fetch_add(size, boost::memory_order_relaxed);
+            break;
+        }
+
+        size_t chunk = std::min(size, m_chunk_size);
+        Slot& slot = m_slots[index];
+        memcpy(&m_data[index * m_chunk_size], data, chunk);
+        slot.direction = direction;
+        slot.size = chunk;
+        m_queued.fetch_add(1, boost::memory_order_relaxed);
+        m_queue.push(index);
+        pushed = true;
+
+        data += chunk;
+        size -= chunk;
+    }
+
+    if (pushed && m_sleeping.load())
+    {
+        boost::lock_guard<boost::mutex> lock(m_wakeup_mutex);
+        m_wakeup.notify_one();
+    }
+}
+
+void AsyncListener::Channel::run()
+{
+    vector<uint32_t> batch;
+    batch.reserve(MAX_BATCH_SIZE);
+    vector<uint8_t> merged;
+    merged.reserve(MAX_BATCH_SIZE * m_chunk_size);
+
+    while (true)
+    {
+        batch.clear();
+        uint32_t index;
+        while (batch.size() < MAX_BATCH_SIZE && m_queue.pop(index))
+            batch.push_back(index);
+
+        if (!batch.empty())
+        {
+            dispatch(batch, merged);
+            continue;
+        }
+
+        boost::unique_lock<boost::mutex> lock(m_wakeup_mutex);
+        if (m_quit.load())
+            return;
+        // Producers only notify when this flag is set. Check the queue once
+        // more after setting it, as data might have been queued in between
+        m_sleeping.store(true);
+        if (m_queue.empty())
+            m_wakeup.timed_wait(lock, boost::posix_time::milliseconds(100));
+        m_sleeping.store(false);
+    }
+}
+
+void AsyncListener::Channel::dispatch(vector<uint32_t> const& batch, vector<uint8_t>& merged)
+{
+    size_t start = 0;
+    while (start < batch.size())
+    {
+        // Merge the consecutive chunks of the same direction
+        Direction direction = m_slots[batch[start]].direction;
+        merged.clear();
+        size_t end = start;
+        for (; end < batch.size() && m_slots[batch[end]].direction == direction; ++end)
+        {
+            uint8_t const* data = &m_data[batch[end] * m_chunk_size];
+            merged.insert(merged.end(), data, data + m_slots[batch[end]].size);
+        }
+
+        if (direction == READ)
+            listener->readData(&merged[0], merged.size());
+        else
+            listener->writeData(&merged[0], merged.size());
+        m_received_bytes.fetch_add(merged.size(), boost::memory_order_relaxed);
+        start = end;
+    }
+
+    for (size_t i = 0; i < batch.size(); ++i)
+        m_free.push(batch[i]);
+    m_dispatched.fetch_add(batch.size(), boost::memory_order_relaxed);
+    m_batches.fetch_add(1, boost::memory_order_relaxed);
+    m_queued.fetch_sub(batch.size(), boost::memory_order_relaxed);
+}
+
+void AsyncListener::Channel::addStatistics(Statistics& stats) const
+{
+    stats.queued_chunks += m_queued.load(boost::memory_order_relaxed);
+    stats.dispatched_chunks += m_dispatched.load(boost::memory_order_relaxed);
+    stats.batches += m_batches.load(boost::memory_order_relaxed);
+    stats.dropped_chunks += m_dropped_chunks.load(boost::memory_order_relaxed);
+    stats.dropped_bytes += m_dropped_bytes.load(boost::memory_order_relaxed);
+}
+
+AsyncListener::ListenerStatistics AsyncListener::Channel::getListenerStatistics() const
+{
+    ListenerStatistics stats;
+    stats.queued_chunks = m_queued.load(boost::memory_order_relaxed);
+    stats.received_bytes = m_received_bytes.load(boost::memory_order_relaxed);
+    stats.dropped_bytes = m_dropped_bytes.load(boost::memory_order_relaxed);
+    return stats;
+}
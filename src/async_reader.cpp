@@ -0,0 +1,200 @@
+#include <ros_driver_base/async_reader.hpp>
+#include <ros_driver_base/exceptions.hpp>
+#include <ros_driver_base/clock.hpp>
+
+#include <cstring>
+#include <stdexcept>
+#include <boost/lexical_cast.hpp>
+#include <boost/bind.hpp>
+
+using namespace std;
+using namespace ros_driver_base;
+
+AsyncReader::AsyncReader(Driver& driver, size_t capacity, OverflowPolicy policy)
+    : m_driver(driver)
+    , m_capacity(capacity)
+    , m_policy(policy)
+    , m_poll_period(0.1)
+    , m_slots(capacity)
+    , m_data(capacity * driver.MAX_PACKET_SIZE)
+    , m_head(0)
+    , m_tail(0)
+    , m_dropped(0)
+    , m_received(0)
+    , m_quit(false)
+    , m_failed(false)
+{
+    if (capacity == 0)
+        throw std::invalid_argument("AsyncReader: capacity cannot be zero");
+}
+
+AsyncReader::~AsyncReader()
+{
+    stop();
+}
+
+void AsyncReader::start()
+{
+    if (isRunning())
+        return;
+
+    // The previous thread failed or was asked to quit, but may still be
+    // running. It must be done before its handle can be replaced
+    if (m_thread.joinable())
+        m_thread.join();
+
+    m_quit.store(false);
+    m_failed.store(false);
+    m_thread = boost::thread(boost::bind(&AsyncReader::run, this));
+}
+
+void AsyncReader::stop()
+{
+    m_quit.store(true);
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+bool AsyncReader::isRunning() const
+{
+    return m_thread.joinable() && !m_quit.load() && !m_failed.load();
+}
+
+void AsyncReader::setPollPeriod(ros::Duration const& period)
+{
+    m_poll_period = period;
+}
+
+void AsyncReader::run()
+{
+    int const max_packet_size = m_driver.MAX_PACKET_SIZE;
+    vector<uint8_t> overflow_buffer(max_packet_size);
+
+    while (!m_quit.load(boost::memory_order_relaxed))
+    {
+        uint64_t head = m_head.load(boost::memory_order_relaxed);
+        uint64_t tail = m_tail.load(boost::memory_order_acquire);
+        // The consumer only ever frees slots, so if there is room now there
+        // will still be room once the packet is read. Read straight into the
+        // slot in that case.
+        bool full = (head - tail >= m_capacity);
+        uint8_t* target = full ? &overflow_buffer[0]
+            : &m_data[(head % m_capacity) * max_packet_size];
+
+        int size;
+        try
+        {
+            size = m_driver.readPacket(target, max_packet_size, m_poll_period);
+        }
+        catch(TimeoutError const&)
+        {
+            continue;
+        }
+        catch(std::exception const& e)
+        {
+            m_error = e.what();
+            m_failed.store(true, boost::memory_order_release);
+            return;
+        }
+
+        ros::Time stamp = Clock::wallTime();
+        if (full)
+            push(target, size, stamp);
+        else
+        {
+            Slot& slot = m_slots[head % m_capacity];
+            slot.size = size;
+            slot.stamp = stamp;
+            m_head.store(head + 1, boost::memory_order_release);
+            m_received.fetch_add(1, boost::memory_order_relaxed);
+        }
+    }
+}
+
+void AsyncReader::push(uint8_t const* packet, int size, ros::Time const& stamp)
+{
+    uint64_t head = m_head.load(boost::memory_order_relaxed);
+    uint64_t tail = m_tail.load(boost::memory_order_acquire);
+    if (head - tail >= m_capacity)
+    {
+        if (m_policy == DROP_NEWEST)
+        {
+            m_dropped.fetch_add(1, boost::memory_order_relaxed);
+            return;
+        }
+
+        // Drop the oldest packet. If the exchange fails, the consumer
+        // just read it and there is room anyways
+        if (m_tail.compare_exchange_strong(tail, tail + 1, boost::memory_order_acq_rel))
+            m_dropped.fetch_add(1, boost::memory_order_relaxed);
+    }
+
+    Slot& slot = m_slots[head % m_capacity];
+    memcpy(&m_data[(head % m_capacity) * m_driver.MAX_PACKET_SIZE], packet, size);
+    slot.size = size;
+    slot.stamp = stamp;
+    m_head.store(head + 1, boost::memory_order_release);
+    m_received.fetch_add(1, boost::memory_order_relaxed);
+}
+
+int AsyncReader::readPacket(uint8_t* buffer, int buffer_size, ros::Time* stamp)
+{
+    int const max_packet_size = m_driver.MAX_PACKET_SIZE;
+    if (buffer_size < max_packet_size)
+        throw length_error("AsyncReader::readPacket(): provided buffer too small (got "
+                + boost::lexical_cast<string>(buffer_size) + ", expected at least "
+                + boost::lexical_cast<string>(max_packet_size) + ")");
+
+    while (true)
+    {
+        uint64_t tail = m_tail.load(boost::memory_order_acquire);
+        uint64_t head = m_head.load(boost::memory_order_acquire);
+        if (tail == head)
+        {
+            if (!m_failed.load(boost::memory_order_acquire))
+                return 0;
+            // Make sure we did not miss a packet pushed right before the
+            // reader failed
+            if (m_head.load(boost::memory_order_acquire) != tail)
+                continue;
+            throw std::runtime_error("AsyncReader: reader thread stopped: " + m_error);
+        }
+
+        Slot const& slot = m_slots[tail % m_capacity];
+        int size = std::min(slot.size, max_packet_size);
+        ros::Time packet_stamp = slot.stamp;
+        memcpy(buffer, &m_data[(tail % m_capacity) * max_packet_size], size);
+
+        if (m_policy == DROP_NEWEST)
+        {
+            m_tail.store(tail + 1, boost::memory_order_release);
+        }
+        else if (!m_tail.compare_exchange_strong(tail, tail + 1, boost::memory_order_acq_rel))
+        {
+            // The reader dropped this packet while we were copying it, the
+            // copy may be corrupted
+            continue;
+        }
+
+        if (stamp)
+            *stamp = packet_stamp;
+        return size;
+    }
+}
+
+size_t AsyncReader::getQueueSize() const
+{
+    uint64_t tail = m_tail.load(boost::memory_order_acquire);
+    uint64_t head = m_head.load(boost::memory_order_acquire);
+    return head - tail;
+}
+
+uint64_t AsyncReader::getDroppedPackets() const
+{
+    return m_dropped.load(boost::memory_order_relaxed);
+}
+
+uint64_t AsyncReader::getReceivedPackets() const
+{
+    return m_received.load(boost::memory_order_relaxed);
+}
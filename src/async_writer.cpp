@@ -0,0 +1,232 @@
+#include <ros_driver_base/async_writer.hpp>
+#include <ros_driver_base/timeout.hpp>
+#include <ros_driver_base/exceptions.hpp>
+
+#include <cstring>
+#include <stdexcept>
+#include <sys/uio.h>
+#include <boost/lexical_cast.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread/locks.hpp>
+
+using namespace std;
+using namespace ros_driver_base;
+
+/** Maximum number of packets sent in a single batch */
+static const size_t MAX_BATCH_SIZE = 64;
+
+AsyncWriter::AsyncWriter(Driver& driver, size_t capacity, size_t max_packet_size)
+    : m_driver(driver)
+    , m_capacity(capacity)
+    , m_max_packet_size(max_packet_size ? max_packet_size : driver.MAX_PACKET_SIZE)
+    , m_write_timeout(1.0)
+    , m_slots(capacity)
+    , m_data(capacity * m_max_packet_size)
+    // the lock-free queues need one node more than the elements they hold
+    , m_free(capacity + 1)
+    , m_urgent(capacity + 1)
+    , m_normal(capacity + 1)
+    , m_queued(0)
+    , m_written(0)
+    , m_write_calls(0)
+    , m_dropped(0)
+    , m_failed_packets(0)
+    , m_mean_latency(0)
+    , m_max_latency(0)
+    , m_quit(false)
+    , m_failed(false)
+    , m_sleeping(false)
+{
+    if (capacity == 0 || capacity >= 65535)
+        throw std::invalid_argument("AsyncWriter: capacity must be between 1 and 65534");
+
+    for (uint32_t i = 0; i < capacity; ++i)
+        m_free.push(i);
+}
+
+AsyncWriter::~AsyncWriter()
+{
+    stop();
+}
+
+void AsyncWriter::start()
+{
+    if (isRunning())
+        return;
+
+    // The previous thread failed or was asked to quit, but may still be
+    // running. It must be done before its handle can be replaced
+    if (m_thread.joinable())
+        m_thread.join();
+
+    // The packets that were queued before the failure was noticed are
+    // dropped, as is the batch that failed
+    if (m_failed.load())
+        releaseQueuedPackets();
+
+    m_quit.store(false);
+    m_failed.store(false);
+    m_thread = boost::thread(boost::bind(&AsyncWriter::run, this));
+}
+
+void AsyncWriter::releaseQueuedPackets()
+{
+    size_t count = 0;
+    uint32_t index;
+    while (m_urgent.pop(index) || m_normal.pop(index))
+    {
+        m_free.push(index);
+        ++count;
+    }
+    m_failed_packets.fetch_add(count, boost::memory_order_relaxed);
+    m_queued.fetch_sub(count, boost::memory_order_relaxed);
+}
+
+void AsyncWriter::stop()
+{
+    {
+        boost::lock_guard<boost::mutex> lock(m_wakeup_mutex);
+        m_quit.store(true);
+        m_wakeup.notify_one();
+    }
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+bool AsyncWriter::isRunning() const
+{
+    return m_thread.joinable() && !m_quit.load() && !m_failed.load();
+}
+
+void AsyncWriter::setWriteTimeout(ros::Duration const& timeout)
+{
+    m_write_timeout = timeout;
+}
+
+bool AsyncWriter::writePacket(uint8_t const* buffer, size_t size, Priority priority)
+{
+    if (size > m_max_packet_size)
+        throw length_error("AsyncWriter::writePacket(): packet too large (got "
+                + boost::lexical_cast<string>(size) + ", the maximum is "
+                + boost::lexical_cast<string>(m_max_packet_size) + ")");
+    if (m_failed.load(boost::memory_order_acquire))
+        throw std::runtime_error("AsyncWriter: writer thread stopped: " + m_error);
+
+    uint32_t index;
+    if (!m_free.pop(index))
+    {
+        m_dropped.fetch_add(1, boost::memory_order_relaxed);
+        return false;
+    }
+
+    Slot& slot = m_slots[index];
+    memcpy(&m_data[index * m_max_packet_size], buffer, size);
+    slot.size = size;
+    slot.queued_time = Deadline::now();
+    m_queued.fetch_add(1, boost::memory_order_relaxed);
+    if (priority == URGENT)
+        m_urgent.push(index);
+    else
+        m_normal.push(index);
+
+    if (m_sleeping.load())
+    {
+        boost::lock_guard<boost::mutex> lock(m_wakeup_mutex);
+        m_wakeup.notify_one();
+    }
+    return true;
+}
+
+void AsyncWriter::run()
+{
+    vector<uint32_t> batch;
+    batch.reserve(MAX_BATCH_SIZE);
+    vector<struct iovec> iov;
+    iov.reserve(MAX_BATCH_SIZE);
+
+    while (true)
+    {
+        batch.clear();
+        uint32_t index;
+        while (batch.size() < MAX_BATCH_SIZE && m_urgent.pop(index))
+            batch.push_back(index);
+        while (batch.size() < MAX_BATCH_SIZE && m_normal.pop(index))
+            batch.push_back(index);
+
+        if (!batch.empty())
+        {
+            writeBatch(batch, iov);
+            if (m_failed.load())
+                return;
+            continue;
+        }
+
+        boost::unique_lock<boost::mutex> lock(m_wakeup_mutex);
+        if (m_quit.load())
+            return;
+        // Producers only notify when this flag is set. Check the queues once
+        // more after setting it, as a packet might have been queued in
+        // between
+        m_sleeping.store(true);
+        if (m_urgent.empty() && m_normal.empty())
+            m_wakeup.timed_wait(lock, boost::posix_time::milliseconds(100));
+        m_sleeping.store(false);
+    }
+}
+
+void AsyncWriter::writeBatch(vector<uint32_t>& batch, vector<struct iovec>& iov)
+{
+    iov.resize(batch.size());
+    for (size_t i = 0; i < batch.size(); ++i)
+    {
+        iov[i].iov_base = &m_data[batch[i] * m_max_packet_size];
+        iov[i].iov_len = m_slots[batch[i]].size;
+    }
+
+    try
+    {
+        m_driver.writePackets(&iov[0], iov.size(), m_write_timeout);
+        m_written.fetch_add(batch.size(), boost::memory_order_relaxed);
+
+        // This is the only thread that updates the latencies
+        int64_t now = Deadline::now();
+        int64_t mean = m_mean_latency.load(boost::memory_order_relaxed);
+        int64_t max = m_max_latency.load(boost::memory_order_relaxed);
+        for (size_t i = 0; i < batch.size(); ++i)
+        {
+            int64_t latency = now - m_slots[batch[i]].queued_time;
+            mean = (mean == 0) ? latency : mean + (latency - mean) / 16;
+            max = std::max(max, latency);
+        }
+        m_mean_latency.store(mean, boost::memory_order_relaxed);
+        m_max_latency.store(max, boost::memory_order_relaxed);
+    }
+    catch(TimeoutError const&)
+    {
+        m_failed_packets.fetch_add(batch.size(), boost::memory_order_relaxed);
+    }
+    catch(std::exception const& e)
+    {
+        m_failed_packets.fetch_add(batch.size(), boost::memory_order_relaxed);
+        m_error = e.what();
+        m_failed.store(true, boost::memory_order_release);
+    }
+    m_write_calls.fetch_add(1, boost::memory_order_relaxed);
+
+    for (size_t i = 0; i < batch.size(); ++i)
+        m_free.push(batch[i]);
+    m_queued.fetch_sub(batch.size(), boost::memory_order_relaxed);
+}
+
+AsyncWriter::Statistics AsyncWriter::getStatistics() const
+{
+    Statistics stats;
+    stats.queued_packets = m_queued.load(boost::memory_order_relaxed);
+    stats.written_packets = m_written.load(boost::memory_order_relaxed);
+    stats.write_calls = m_write_calls.load(boost::memory_order_relaxed);
+    stats.dropped_packets = m_dropped.load(boost::memory_order_relaxed);
+    stats.failed_packets = m_failed_packets.load(boost::memory_order_relaxed);
+    stats.mean_latency.fromNSec(m_mean_latency.load(boost::memory_order_relaxed));
+    stats.max_latency.fromNSec(m_max_latency.load(boost::memory_order_relaxed));
+    return stats;
+}
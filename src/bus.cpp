@@ -1,10 +1,24 @@
 #include <ros_driver_base/bus.hpp>
 #include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <stdexcept>
+#include <sys/ioctl.h>
 
 #include <boost/thread/locks.hpp>
+#include <boost/lexical_cast.hpp>
+#include <ros_driver_base/timeout.hpp>
+#include <ros_driver_base/clock.hpp>
+
+#ifdef __gnu_linux__
+#include <linux/serial.h>
+#endif
 
 using namespace ros_driver_base;
 
+/** Default number of unread packets kept per parser in pipelined mode */
+static const size_t DEFAULT_MAILBOX_SIZE = 16;
+
 Parser::Parser(Bus *bus):
 	bus(bus)
 {
@@ -36,7 +50,12 @@ int BusHandler::readPacket(uint8_t* buffer, int buffer_size, int packet_timeout,
 
 
 Bus::Bus(int max_packet_size, bool extract_last):
-	Driver(max_packet_size,extract_last)
+	Driver(max_packet_size,extract_last),
+	rs485_baudrate(0),
+	pipelined(false),
+	route_reading(false),
+	mailbox_size(DEFAULT_MAILBOX_SIZE),
+	dropped_routed_packets(0)
 {
 	caller =0;
 
@@ -52,14 +71,104 @@ void Bus::addParser(Parser *parser){
 void Bus::removeParser(Parser *parser){
         LockGuard guard(mutex);
 	this->parser.remove(parser);
+	boost::lock_guard<boost::mutex> route_guard(route_mutex);
+	mailboxes.erase(parser);
 }
 
 bool Bus::writePacket(uint8_t const* buffer, int buffer_size, int timeout){
+	return writePacket(buffer, buffer_size, ros::Duration(timeout / 1000.0));
+}
+
+bool Bus::writePacket(uint8_t const* buffer, int buffer_size, ros::Duration const& timeout){
+	// In pipelined mode, the reading thread holds the main mutex
+	boost::lock_guard<boost::mutex> write_guard(write_mutex);
+	boost::unique_lock<boost::recursive_mutex> guard(mutex, boost::defer_lock);
+	if(!pipelined)
+		guard.lock();
+
+	if(rs485.direction_control != RS485Configuration::DIRECTION_RTS)
+		return Driver::writePacket(buffer, buffer_size, timeout);
+
+	setRTS(rs485.rts_on_send);
+	int64_t start = Deadline::now() + rs485.delay_before_send.toNSec();
+	Clock::waitUntil(start);
+
+	try{
+		Driver::writePacket(buffer, buffer_size, timeout);
+	} catch(...) {
+		setRTS(!rs485.rts_on_send);
+		throw;
+	}
+
+	// The UART starts shifting bytes out as soon as the write begins, so the
+	// last stop bit leaves the line transmit-duration after the start of the
+	// write
+	Clock::waitUntil(start + (getTransmitDuration(buffer_size) + rs485.delay_after_send).toNSec());
+	setRTS(!rs485.rts_on_send);
+	return true;
+}
+
+void Bus::setRTS(bool level){
+	int flag = TIOCM_RTS;
+	if(ioctl(getFileDescriptor(), level ? TIOCMBIS : TIOCMBIC, &flag))
+		throw UnixError("Bus: cannot change the RTS line");
+}
+
+void Bus::setRS485(RS485Configuration const& config){
         LockGuard guard(mutex);
-        return Driver::writePacket(buffer, buffer_size, timeout);
+	int fd = getFileDescriptor();
+	if(fd == INVALID_FD)
+		throw std::runtime_error("Bus::setRS485: the bus is not open");
+
+	rs485_baudrate = getSerialBaudrate(fd);
+	if(config.direction_control == RS485Configuration::DIRECTION_KERNEL
+		|| rs485.direction_control == RS485Configuration::DIRECTION_KERNEL){
+#ifdef __gnu_linux__
+		struct serial_rs485 kernel_config;
+		memset(&kernel_config, 0, sizeof(kernel_config));
+		if(config.direction_control == RS485Configuration::DIRECTION_KERNEL){
+			kernel_config.flags = SER_RS485_ENABLED;
+			kernel_config.flags |= config.rts_on_send ? SER_RS485_RTS_ON_SEND : SER_RS485_RTS_AFTER_SEND;
+			// The kernel has millisecond resolution for these, round up
+			kernel_config.delay_rts_before_send = (config.delay_before_send.toNSec() + 999999) / 1000000;
+			kernel_config.delay_rts_after_send = (config.delay_after_send.toNSec() + 999999) / 1000000;
+		}
+		if(ioctl(fd, TIOCSRS485, &kernel_config))
+			throw UnixError("Bus::setRS485: cannot configure the kernel RS-485 mode");
+#else
+		throw UnixError("Bus::setRS485: kernel RS-485 mode is only supported on Linux", ENOTSUP);
+#endif
+	}
+
+	rs485 = config;
+	if(rs485.direction_control == RS485Configuration::DIRECTION_RTS)
+		setRTS(!rs485.rts_on_send);
+}
+
+RS485Configuration Bus::getRS485() const{
+	return rs485;
+}
+
+ros::Duration Bus::getTransmitDuration(size_t byte_count) const{
+	if(rs485_baudrate <= 0)
+		return ros::Duration();
+	ros::Duration duration;
+	duration.fromNSec(static_cast<int64_t>(byte_count) * rs485.bits_per_byte * 1000000000LL / rs485_baudrate);
+	return duration;
 }
 
 int Bus::readPacket(uint8_t* buffer, int buffer_size, int packet_timeout, int first_byte_timeout, Parser *parser){
+	ros::Duration packet(packet_timeout / 1000.0);
+	ros::Duration first_byte = packet + ros::Duration(1.0);
+	if(first_byte_timeout >= 0)
+		first_byte = ros::Duration(first_byte_timeout / 1000.0);
+	return readPacket(buffer, buffer_size, packet, first_byte, parser);
+}
+
+int Bus::readPacket(uint8_t* buffer, int buffer_size, ros::Duration const& packet_timeout, ros::Duration const& first_byte_timeout, Parser *parser){
+	if(pipelined)
+		return readRoutedPacket(buffer, buffer_size, packet_timeout, parser);
+
         LockGuard guard(mutex);
 
 	caller = parser;
@@ -72,11 +181,130 @@ int Bus::readPacket(uint8_t* buffer, int buffer_size, int packet_timeout, int fi
 }
 
 
+void Bus::setPipelined(bool enable){
+        LockGuard guard(mutex);
+	pipelined = enable;
+	// The parser of the last non-pipelined read must not take over the
+	// routing
+	caller = 0;
+}
+
+bool Bus::isPipelined() const{
+	return pipelined;
+}
+
+void Bus::setMailboxSize(size_t size){
+	if(size == 0)
+		throw std::invalid_argument("Bus::setMailboxSize: the size must be at least 1");
+	boost::lock_guard<boost::mutex> route_guard(route_mutex);
+	mailbox_size = size;
+}
+
+size_t Bus::getMailboxSize() const{
+	boost::lock_guard<boost::mutex> route_guard(route_mutex);
+	return mailbox_size;
+}
+
+uint64_t Bus::getDroppedRoutedPacketCount() const{
+	boost::lock_guard<boost::mutex> route_guard(route_mutex);
+	return dropped_routed_packets;
+}
+
+Parser* Bus::findPacketOwner(uint8_t const* packet, int size) const{
+	for(std::list<Parser*>::const_iterator it = parser.begin();it != parser.end();it++){
+		if((*it)->extractPacket(packet, size) == size)
+			return *it;
+	}
+	return 0;
+}
+
+int Bus::readRoutedPacket(uint8_t* buffer, int buffer_size, ros::Duration const& timeout, Parser *parser){
+	if(buffer_size < MAX_PACKET_SIZE)
+		throw std::length_error("readPacket(): provided buffer too small (got "
+			+ boost::lexical_cast<std::string>(buffer_size) + ", expected at least "
+			+ boost::lexical_cast<std::string>(MAX_PACKET_SIZE) + ")");
+
+	Deadline deadline(timeout);
+	std::vector<uint8_t> packet;
+	boost::unique_lock<boost::mutex> route_lock(route_mutex);
+	while(true){
+		std::deque<std::vector<uint8_t> >& mailbox = mailboxes[parser];
+		if(!mailbox.empty()){
+			std::vector<uint8_t> const& front = mailbox.front();
+			std::copy(front.begin(), front.end(), buffer);
+			int size = front.size();
+			mailbox.pop_front();
+			return size;
+		}
+
+		ros::Duration remaining = deadline.timeLeft();
+		if(remaining.isZero())
+			throw TimeoutError(TimeoutError::PACKET, "Bus::readPacket(): no packet routed to this parser before the timeout");
+
+		if(route_reading){
+			// Another thread reads on the device, wait for it to route
+			// something to us or to give up the reading role
+			route_cond.timed_wait(route_lock, boost::posix_time::microseconds(remaining.toNSec() / 1000 + 1));
+			continue;
+		}
+
+		route_reading = true;
+		route_lock.unlock();
+
+		int size = 0;
+		Parser* owner = 0;
+		packet.resize(MAX_PACKET_SIZE);
+		try{
+			LockGuard guard(mutex);
+			size = Driver::readPacket(&packet[0], MAX_PACKET_SIZE, remaining);
+			owner = findPacketOwner(&packet[0], size);
+			BusHandler* handler = dynamic_cast<BusHandler*>(owner);
+			if(handler){
+				handler->packedReady(&packet[0], size);
+				owner = 0;
+			}
+		} catch(TimeoutError const&) {
+		} catch(...) {
+			route_lock.lock();
+			route_reading = false;
+			route_cond.notify_all();
+			throw;
+		}
+
+		route_lock.lock();
+		route_reading = false;
+		if(size){
+			std::deque<std::vector<uint8_t> >& owner_mailbox = mailboxes[owner];
+			owner_mailbox.push_back(std::vector<uint8_t>(packet.begin(), packet.begin() + size));
+			if(owner_mailbox.size() > mailbox_size){
+				owner_mailbox.pop_front();
+				++dropped_routed_packets;
+			}
+		}
+		route_cond.notify_all();
+	}
+}
+
 int Bus::extractPacket(uint8_t const* buffer, size_t buffer_size) const{
-	if(caller){
+	if(caller && !pipelined){
 		return caller->extractPacket(buffer,buffer_size);
 	}
 
+	if(pipelined){
+		// Accept the first full packet any parser recognizes. Otherwise,
+		// wait if one of them sees the start of a packet, and skip as little
+		// as possible if none does
+		int result = -buffer_size;
+		for(std::list<Parser*>::const_iterator it = parser.begin();it != parser.end();it++){
+			int tmp = (*it)->extractPacket(buffer,buffer_size);
+			if(tmp > 0)
+				return tmp;
+			else if(tmp > result)
+				result = tmp;
+		}
+		return result;
+	}
+
 	int minSkip=buffer_size;
 
 	for(std::list<Parser*>::const_iterator it = parser.begin();it != parser.end();it++){
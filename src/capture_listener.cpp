@@ -0,0 +1,445 @@
+#include <ros_driver_base/capture_listener.hpp>
+#include <ros_driver_base/exceptions.hpp>
+#include <ros_driver_base/driver.hpp>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <stdexcept>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/bind.hpp>
+
+using namespace std;
+using namespace ros_driver_base;
+
+// pcapng block types and options, see
+// https://www.ietf.org/archive/id/draft-ietf-opsawg-pcapng-01.html
+static const uint32_t SECTION_HEADER_BLOCK = 0x0A0D0D0A;
+static const uint32_t INTERFACE_DESCRIPTION_BLOCK = 1;
+static const uint32_t ENHANCED_PACKET_BLOCK = 6;
+static const uint32_t BYTE_ORDER_MAGIC = 0x1A2B3C4D;
+static const uint16_t OPT_ENDOFOPT = 0;
+static const uint16_t OPT_IF_TSRESOL = 9;
+static const uint16_t OPT_EPB_FLAGS = 2;
+static const uint32_t EPB_FLAG_INBOUND = 1;
+static const uint32_t EPB_FLAG_OUTBOUND = 2;
+
+static const size_t SECTION_HEADER_SIZE = 28;
+static const size_t INTERFACE_DESCRIPTION_SIZE = 32;
+/** Size of an enhanced packet block, excluding the (padded) data */
+static const size_t ENHANCED_PACKET_OVERHEAD = 44;
+
+static size_t pad4(size_t size)
+{
+    return (size + 3) & ~size_t(3);
+}
+
+template<typename T>
+static uint8_t* put(uint8_t* out, T value)
+{
+    memcpy(out, &value, sizeof(T));
+    return out + sizeof(T);
+}
+
+/** The state shared by a CaptureListener and its streams */
+class CaptureListener::Recorder
+{
+public:
+    Recorder(std::string const& path_prefix, size_t file_size,
+            size_t stream_count, uint16_t link_type, uint32_t snaplen);
+    ~Recorder();
+
+    void setMaxFiles(size_t count);
+    size_t getStreamCount() const { return m_stream_count; }
+    void close();
+    std::string getCurrentPath() const;
+    size_t getFileCount() const;
+    uint64_t getRecordedChunks() const;
+    void record(size_t stream, bool outbound, boost::uint8_t const* data, size_t size);
+
+private:
+    std::string const m_path_prefix;
+    size_t const m_file_size;
+    size_t const m_stream_count;
+    uint16_t const m_link_type;
+    uint32_t const m_snaplen;
+    size_t m_max_files;
+
+    /** A mapped capture file */
+    struct File
+    {
+        int fd;
+        uint8_t* map;
+        /** Size of the data written so far */
+        size_t size;
+        File() : fd(-1), map(0), size(0) {}
+    };
+
+    mutable boost::mutex m_mutex;
+    File m_file;
+    size_t m_file_index;
+    uint64_t m_recorded;
+
+    /** The file prepared by the helper thread for the rollover */
+    File m_next;
+    /** Why the helper thread could not prepare the next file */
+    std::string m_next_error;
+    /** Full files the helper thread has to truncate and close */
+    std::vector<File> m_finished;
+    /** Files the helper thread has to delete */
+    std::vector<std::string> m_obsolete;
+    bool m_quit;
+    /** Wakes up the helper thread, and the recording waiting for it */
+    boost::condition_variable m_helper_signal;
+    boost::thread m_helper;
+
+    std::string getPath(size_t index) const;
+    File openFile(size_t index) const;
+    void closeFile(File& file) const;
+    size_t writeHeaders(uint8_t* map) const;
+    void runHelper();
+};
+
+/** Records one of the streams. It keeps the recorder alive */
+class CaptureListener::Stream : public IOListener
+{
+    boost::shared_ptr<Recorder> m_recorder;
+    size_t m_index;
+public:
+    Stream(boost::shared_ptr<Recorder> const& recorder, size_t index)
+        : m_recorder(recorder), m_index(index) {}
+    virtual void writeData(boost::uint8_t const* data, size_t size);
+    virtual void readData(boost::uint8_t const* data, size_t size);
+};
+
+CaptureListener::CaptureListener(std::string const& path_prefix,
+        size_t file_size, size_t stream_count,
+        uint16_t link_type, uint32_t snaplen)
+    : m_recorder(new Recorder(path_prefix, file_size, stream_count, link_type, snaplen))
+{
+}
+
+CaptureListener::~CaptureListener()
+{
+}
+
+void CaptureListener::setMaxFiles(size_t count)
+{
+    m_recorder->setMaxFiles(count);
+}
+
+IOListener* CaptureListener::getStream(size_t index)
+{
+    if (index >= m_recorder->getStreamCount())
+        throw std::out_of_range("CaptureListener: invalid stream index");
+    return new Stream(m_recorder, index);
+}
+
+void CaptureListener::close()
+{
+    m_recorder->close();
+}
+
+std::string CaptureListener::getCurrentPath() const
+{
+    return m_recorder->getCurrentPath();
+}
+
+size_t CaptureListener::getFileCount() const
+{
+    return m_recorder->getFileCount();
+}
+
+uint64_t CaptureListener::getRecordedChunks() const
+{
+    return m_recorder->getRecordedChunks();
+}
+
+void CaptureListener::record(size_t stream, bool outbound, boost::uint8_t const* data, size_t size)
+{
+    m_recorder->record(stream, outbound, data, size);
+}
+
+void CaptureListener::writeData(boost::uint8_t const* data, size_t size)
+{
+    m_recorder->record(0, true, data, size);
+}
+
+void CaptureListener::readData(boost::uint8_t const* data, size_t size)
+{
+    m_recorder->record(0, false, data, size);
+}
+
+void CaptureListener::Stream::writeData(boost::uint8_t const* data, size_t size)
+{
+    m_recorder->record(m_index, true, data, size);
+}
+
+void CaptureListener::Stream::readData(boost::uint8_t const* data, size_t size)
+{
+    m_recorder->record(m_index, false, data, size);
+}
+
+CaptureListener::Recorder::Recorder(std::string const& path_prefix,
+        size_t file_size, size_t stream_count,
+        uint16_t link_type, uint32_t snaplen)
+    : m_path_prefix(path_prefix)
+    , m_file_size(file_size)
+    , m_stream_count(stream_count)
+    , m_link_type(link_type)
+    , m_snaplen(snaplen)
+    , m_max_files(0)
+    , m_file_index(0)
+    , m_recorded(0)
+    , m_quit(false)
+{
+    if (stream_count == 0)
+        throw std::invalid_argument("CaptureListener: stream count cannot be zero");
+
+    size_t headers_size = SECTION_HEADER_SIZE + stream_count * INTERFACE_DESCRIPTION_SIZE;
+    if (file_size < headers_size + ENHANCED_PACKET_OVERHEAD + pad4(snaplen))
+        throw std::invalid_argument("CaptureListener: file size too small for the headers and a full chunk");
+
+    m_file = openFile(0);
+    m_helper = boost::thread(boost::bind(&CaptureListener::Recorder::runHelper, this));
+}
+
+CaptureListener::Recorder::~Recorder()
+{
+    close();
+}
+
+void CaptureListener::Recorder::setMaxFiles(size_t count)
+{
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    m_max_files = count;
+}
+
+void CaptureListener::Recorder::close()
+{
+    {
+        boost::lock_guard<boost::mutex> lock(m_mutex);
+        m_quit = true;
+        m_helper_signal.notify_all();
+    }
+    if (m_helper.joinable())
+        m_helper.join();
+
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    for (size_t i = 0; i < m_finished.size(); ++i)
+        closeFile(m_finished[i]);
+    m_finished.clear();
+    for (size_t i = 0; i < m_obsolete.size(); ++i)
+        unlink(m_obsolete[i].c_str());
+    m_obsolete.clear();
+    if (m_next.map)
+    {
+        closeFile(m_next);
+        unlink(getPath(m_file_index + 1).c_str());
+    }
+    closeFile(m_file);
+}
+
+std::string CaptureListener::Recorder::getPath(size_t index) const
+{
+    return m_path_prefix + "." + boost::lexical_cast<string>(index) + ".pcapng";
+}
+
+std::string CaptureListener::Recorder::getCurrentPath() const
+{
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    return getPath(m_file_index);
+}
+
+size_t CaptureListener::Recorder::getFileCount() const
+{
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    return m_file_index + 1;
+}
+
+uint64_t CaptureListener::Recorder::getRecordedChunks() const
+{
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    return m_recorded;
+}
+
+CaptureListener::Recorder::File CaptureListener::Recorder::openFile(size_t index) const
+{
+    string path = getPath(index);
+    FileGuard guard(::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644));
+    if (guard.get() == -1)
+        throw UnixError("CaptureListener: cannot create " + path);
+
+    // Allocate the blocks now, so that writing in the mapping never fails
+    // with SIGBUS because the disk is full
+    int error = posix_fallocate(guard.get(), 0, m_file_size);
+    if (error)
+        throw UnixError("CaptureListener: cannot allocate " + path, error);
+
+    void* map = mmap(0, m_file_size, PROT_READ | PROT_WRITE, MAP_SHARED, guard.get(), 0);
+    if (map == MAP_FAILED)
+        throw UnixError("CaptureListener: cannot map " + path);
+
+    File file;
+    file.map = static_cast<uint8_t*>(map);
+    file.size = writeHeaders(file.map);
+    file.fd = guard.release();
+    return file;
+}
+
+void CaptureListener::Recorder::closeFile(File& file) const
+{
+    if (!file.map)
+        return;
+
+    munmap(file.map, m_file_size);
+    if (ftruncate(file.fd, file.size) == -1)
+    {
+        // nothing to do about it, the file is still readable up to the
+        // end of the last block. The rest is zeroes
+    }
+    ::close(file.fd);
+    file = File();
+}
+
+void CaptureListener::Recorder::runHelper()
+{
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    while (!m_quit)
+    {
+        if (!m_finished.empty() || !m_obsolete.empty())
+        {
+            vector<File> finished;
+            finished.swap(m_finished);
+            vector<string> obsolete;
+            obsolete.swap(m_obsolete);
+
+            lock.unlock();
+            for (size_t i = 0; i < finished.size(); ++i)
+                closeFile(finished[i]);
+            for (size_t i = 0; i < obsolete.size(); ++i)
+                unlink(obsolete[i].c_str());
+            lock.lock();
+        }
+        else if (m_file.map && !m_next.map && m_next_error.empty())
+        {
+            // m_file_index only changes once m_next is used
+            size_t index = m_file_index + 1;
+            lock.unlock();
+            File next;
+            string error;
+            try { next = openFile(index); }
+            catch(UnixError const& e) { error = e.what(); }
+            lock.lock();
+
+            m_next = next;
+            m_next_error = error;
+            m_helper_signal.notify_all();
+        }
+        else
+            m_helper_signal.wait(lock);
+    }
+}
+
+size_t CaptureListener::Recorder::writeHeaders(uint8_t* map) const
+{
+    uint8_t* out = map;
+    out = put<uint32_t>(out, SECTION_HEADER_BLOCK);
+    out = put<uint32_t>(out, SECTION_HEADER_SIZE);
+    out = put<uint32_t>(out, BYTE_ORDER_MAGIC);
+    out = put<uint16_t>(out, 1);
+    out = put<uint16_t>(out, 0);
+    // section length unknown
+    out = put<int64_t>(out, -1);
+    out = put<uint32_t>(out, SECTION_HEADER_SIZE);
+
+    for (size_t i = 0; i < m_stream_count; ++i)
+    {
+        out = put<uint32_t>(out, INTERFACE_DESCRIPTION_BLOCK);
+        out = put<uint32_t>(out, INTERFACE_DESCRIPTION_SIZE);
+        out = put<uint16_t>(out, m_link_type);
+        out = put<uint16_t>(out, 0);
+        out = put<uint32_t>(out, m_snaplen);
+        // timestamps are in nanoseconds
+        out = put<uint16_t>(out, OPT_IF_TSRESOL);
+        out = put<uint16_t>(out, 1);
+        out = put<uint32_t>(out, 9);
+        out = put<uint16_t>(out, OPT_ENDOFOPT);
+        out = put<uint16_t>(out, 0);
+        out = put<uint32_t>(out, INTERFACE_DESCRIPTION_SIZE);
+    }
+    return out - map;
+}
+
+void CaptureListener::Recorder::record(size_t stream, bool outbound, boost::uint8_t const* data, size_t size)
+{
+    if (stream >= m_stream_count)
+        throw std::out_of_range("CaptureListener: invalid stream index");
+
+    timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    uint64_t timestamp = static_cast<uint64_t>(now.tv_sec) * 1000000000ULL + now.tv_nsec;
+
+    uint32_t captured = std::min<size_t>(size, m_snaplen);
+    uint32_t block_size = ENHANCED_PACKET_OVERHEAD + pad4(captured);
+
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    if (!m_file.map)
+        return;
+    if (m_file.size + block_size > m_file_size)
+    {
+        // The helper thread usually prepared the next file long ago
+        while (m_file.map && !m_next.map && m_next_error.empty() && !m_quit)
+            m_helper_signal.wait(lock);
+        if (!m_file.map)
+            return;
+        else if (!m_next.map)
+        {
+            if (m_next_error.empty())
+                return; // being closed
+
+            // Do not disturb the driver, which calls us. Just stop recording
+            std::cerr << m_next_error << ", stopping the capture" << std::endl;
+            m_finished.push_back(m_file);
+            m_file = File();
+            m_helper_signal.notify_all();
+            return;
+        }
+
+        m_finished.push_back(m_file);
+        m_file = m_next;
+        m_next = File();
+        ++m_file_index;
+        if (m_max_files && m_file_index >= m_max_files)
+            m_obsolete.push_back(getPath(m_file_index - m_max_files));
+        m_helper_signal.notify_all();
+    }
+
+    uint8_t* out = m_file.map + m_file.size;
+    out = put<uint32_t>(out, ENHANCED_PACKET_BLOCK);
+    out = put<uint32_t>(out, block_size);
+    out = put<uint32_t>(out, stream);
+    out = put<uint32_t>(out, timestamp >> 32);
+    out = put<uint32_t>(out, timestamp & 0xFFFFFFFF);
+    out = put<uint32_t>(out, captured);
+    out = put<uint32_t>(out, size);
+    memcpy(out, data, captured);
+    // the padding bytes are already zero, the file is freshly allocated
+    out += pad4(captured);
+    out = put<uint16_t>(out, OPT_EPB_FLAGS);
+    out = put<uint16_t>(out, 4);
+    out = put<uint32_t>(out, outbound ? EPB_FLAG_OUTBOUND : EPB_FLAG_INBOUND);
+    out = put<uint16_t>(out, OPT_ENDOFOPT);
+    out = put<uint16_t>(out, 0);
+    out = put<uint32_t>(out, block_size);
+    m_file.size += block_size;
+    ++m_recorded;
+}
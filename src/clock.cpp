@@ -0,0 +1,62 @@
+#include <ros_driver_base/clock.hpp>
+#include <ros_driver_base/timeout.hpp>
+#include <errno.h>
+#include <time.h>
+#include <boost/atomic.hpp>
+
+using namespace ros_driver_base;
+
+static boost::atomic<Clock*> current_clock(static_cast<Clock*>(0));
+
+Clock::~Clock()
+{
+}
+
+Clock* Clock::getCurrent()
+{
+    return current_clock.load(boost::memory_order_acquire);
+}
+
+void Clock::setCurrent(Clock* clock)
+{
+    current_clock.store(clock, boost::memory_order_release);
+}
+
+ros::Time Clock::wallTime()
+{
+    Clock* clock = getCurrent();
+    if (clock)
+        return clock->getWallTime();
+    return ros::Time::now();
+}
+
+void Clock::waitUntil(int64_t time)
+{
+    Clock* clock = getCurrent();
+    if (clock)
+    {
+        clock->sleepUntil(time);
+        return;
+    }
+
+    timespec spec = { static_cast<time_t>(time / 1000000000), static_cast<long>(time % 1000000000) };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &spec, NULL) == EINTR);
+}
+
+void Clock::waitTimedOut(ros::Duration const& duration)
+{
+    Clock* clock = getCurrent();
+    if (clock)
+        clock->sleepUntil(clock->now() + duration.toNSec());
+}
+
+ScopedClock::ScopedClock(Clock& clock)
+    : m_previous(Clock::getCurrent())
+{
+    Clock::setCurrent(&clock);
+}
+
+ScopedClock::~ScopedClock()
+{
+    Clock::setCurrent(m_previous);
+}
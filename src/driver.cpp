@@ -1,5 +1,6 @@
 #include <ros_driver_base/driver.hpp>
 #include <ros_driver_base/timeout.hpp>
+#include <ros_driver_base/clock.hpp>
 
 #include <errno.h>
 #include <sys/types.h>
@@ -13,35 +14,33 @@
 #include <time.h>
 
 #include <cstring>
+#include <limits>
 #include <sstream>
 #include <iostream>
 
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <netinet/udp.h>
 #include <netdb.h>
 
 #include <boost/lexical_cast.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/locks.hpp>
 #include <ros_driver_base/io_stream.hpp>
 #include <ros_driver_base/io_listener.hpp>
 #include <ros_driver_base/test_stream.hpp>
+#include <ros_driver_base/replay_stream.hpp>
+#include <ros_driver_base/probes.hpp>
+#include <ros/console.h>
 
 #ifdef __gnu_linux__
-#include <linux/serial.h>
 #include <termio.h>
 #include <fcntl.h>
 #include <err.h>
 #endif
 
-#ifdef __APPLE__
-#ifndef B460800
-#define B460800 460800
-#define B576000 576000
-#define B921600 921600
-#endif
-#endif
-
 using namespace std;
 using namespace ros_driver_base;
 
@@ -88,6 +87,9 @@ Driver::Driver(int max_packet_size, bool extract_last)
     : internal_buffer(new uint8_t[max_packet_size]), internal_buffer_size(0)
     , MAX_PACKET_SIZE(max_packet_size)
     , m_stream(0), m_auto_close(true), m_extract_last(extract_last)
+    , m_first_byte_time(0)
+    , m_spin_budget(0), m_wait_estimate(0)
+    , m_transaction_count(0), m_next_transaction_id(0)
 {
     if(MAX_PACKET_SIZE <= 0)
         std::runtime_error("Driver: max_packet_size cannot be smaller or equal to 0!");
@@ -122,20 +124,87 @@ void Driver::removeListener(IOListener* listener)
     m_listeners.erase(listener);
 }
 
+void Driver::setPollingPolicy(PollingPolicy const& policy)
+{
+    m_polling = policy;
+    m_spin_budget = policy.max_spin.toNSec();
+    m_wait_estimate = 0;
+}
+
+PollingPolicy Driver::getPollingPolicy() const
+{
+    return m_polling;
+}
+
+ros::Duration Driver::getSpinBudget() const
+{
+    ros::Duration budget;
+    budget.fromNSec(m_spin_budget);
+    return budget;
+}
+
+void Driver::updateSpinBudget(int64_t wait_ns)
+{
+    if (!m_polling.adaptive)
+        return;
+
+    // A wait longer than max_spin only tells that spinning would not have
+    // helped. Counting it in full would keep the budget at min_spin for a
+    // long time after the device was idle. Samples are capped above
+    // max_spin so that the estimate can still reach it
+    int64_t max_spin = m_polling.max_spin.toNSec();
+    wait_ns = std::min(wait_ns, 2 * max_spin);
+
+    if (m_wait_estimate == 0)
+        m_wait_estimate = wait_ns;
+    else
+        m_wait_estimate = (7 * m_wait_estimate + wait_ns) / 8;
+
+    // Spin for about twice the usual wait, within [min_spin, max_spin],
+    // unless data usually comes later than we are allowed to spin anyways
+    int64_t min_spin = m_polling.min_spin.toNSec();
+    int64_t budget;
+    if (m_wait_estimate >= max_spin)
+        budget = min_spin;
+    else
+        budget = std::max(min_spin, std::min(2 * m_wait_estimate, max_spin));
+    m_spin_budget = budget;
+}
+
+static inline void cpuRelax(unsigned int count)
+{
+    for (unsigned int i = 0; i < count; ++i)
+    {
+#if defined(__i386__) || defined(__x86_64__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+        asm volatile("yield" ::: "memory");
+#else
+        asm volatile("" ::: "memory");
+#endif
+    }
+}
+
 void Driver::clear()
 {
     if (m_stream)
         m_stream->clear();
     internal_buffer_size = 0;
+    m_first_byte_time = 0;
+    StatusCounters::Update update(m_stats.read);
+    m_stats.read.queued_bytes.store(0, boost::memory_order_relaxed);
 }
 
 Status Driver::getStatus() const
 {
-    m_stats.queued_bytes = internal_buffer_size;
-    return m_stats;
+    Status status;
+    m_stats.load(status);
+    return status;
 }
+void Driver::getStatus(Status& status) const
+{ m_stats.load(status); }
 void Driver::resetStatus()
-{ m_stats = Status(); }
+{ m_stats.reset(); }
 
 void Driver::setExtractLastPacket(bool flag) { m_extract_last = flag; }
 bool Driver::getExtractLastPacket() const { return m_extract_last; }
@@ -161,9 +230,11 @@ void Driver::openURI(std::string const& uri)
     //   2 for UDP
     //   3 for UDP server
     //   4 for file (either Unix sockets or named FIFOs)
+    //   5 for test
+    //   6 for replay of a capture file
     int mode_idx = -1;
-    char const* modes[6] = { "serial://", "tcp://", "udp://", "udpserver://", "file://", "test://" };
-    for (int i = 0; i < 6; ++i)
+    char const* modes[7] = { "serial://", "tcp://", "udp://", "udpserver://", "file://", "test://", "replay://" };
+    for (int i = 0; i < 7; ++i)
     {
         if (uri.compare(0, strlen(modes[i]), modes[i]) == 0)
         {
@@ -177,6 +248,31 @@ void Driver::openURI(std::string const& uri)
 
     string device = uri.substr(strlen(modes[mode_idx]));
 
+    // Find a ?option=value&... marker
+    std::map<string, string> options;
+    string::size_type options_marker = device.find_first_of("?");
+    if (options_marker != string::npos)
+    {
+        options = parseURIOptions(device.substr(options_marker + 1));
+        device = device.substr(0, options_marker);
+    }
+
+    if (mode_idx == 6)
+    { // replay://path[?speed=factor&stream=index]
+        double speed = 1;
+        unsigned int stream = 0;
+        for (std::map<string, string>::const_iterator it = options.begin(); it != options.end(); ++it)
+        {
+            if (it->first == "speed")
+                speed = boost::lexical_cast<double>(it->second);
+            else if (it->first == "stream")
+                stream = boost::lexical_cast<unsigned int>(it->second);
+            else
+                throw std::runtime_error("unknown option '" + it->first + "' in replay:// URI");
+        }
+        return openReplay(device, speed, stream);
+    }
+
     // Find a :[additional_info] marker
     string::size_type marker = device.find_last_of(":");
     int additional_info = 0;
@@ -186,11 +282,29 @@ void Driver::openURI(std::string const& uri)
         device = device.substr(0, marker);
     }
 
+    if (!options.empty() && mode_idx != 0)
+        throw std::runtime_error("options are not supported in URI " + uri);
+
     if (mode_idx == 0)
-    { // serial://DEVICE:baudrate
+    { // serial://DEVICE:baudrate[?options]
         if (marker == string::npos)
             throw std::runtime_error("missing baudrate specification in serial:// URI");
-        openSerial(device, additional_info);
+
+        SerialConfiguration config;
+        for (std::map<string, string>::const_iterator it = options.begin(); it != options.end(); ++it)
+        {
+            if (it->first == "low_latency")
+                config.low_latency = boost::lexical_cast<int>(it->second);
+            else if (it->first == "vmin")
+                config.vmin = boost::lexical_cast<int>(it->second);
+            else if (it->first == "vtime")
+                config.vtime = boost::lexical_cast<int>(it->second);
+            else if (it->first == "latency_timer")
+                config.latency_timer = boost::lexical_cast<int>(it->second);
+            else
+                throw std::runtime_error("unknown option '" + it->first + "' in serial:// URI");
+        }
+        openSerial(device, additional_info, config);
         return;
     }
     else if (mode_idx == 1)
@@ -230,14 +344,38 @@ void Driver::openURI(std::string const& uri)
     }
 }
 
+std::map<string, string> Driver::parseURIOptions(std::string const& options)
+{
+    std::map<string, string> result;
+    string::size_type start = 0;
+    while (start < options.size())
+    {
+        string::size_type end = options.find_first_of("&", start);
+        if (end == string::npos)
+            end = options.size();
+
+        string option = options.substr(start, end - start);
+        if (!option.empty())
+        {
+            string::size_type equal = option.find_first_of("=");
+            if (equal == string::npos)
+                result[option] = "";
+            else
+                result[option.substr(0, equal)] = option.substr(equal + 1);
+        }
+        start = end + 1;
+    }
+    return result;
+}
+
 void Driver::openTestMode()
 {
     setMainStream(new TestStream);
 }
 
-bool Driver::openSerial(std::string const& port, int baud_rate)
+bool Driver::openSerial(std::string const& port, int baud_rate, SerialConfiguration const& config)
 {
-    setFileDescriptor(Driver::openSerialIO(port, baud_rate));
+    setFileDescriptor(Driver::openSerialIO(port, baud_rate, config));
     return true;
 }
 
@@ -381,7 +519,7 @@ void Driver::openUDPBidirectional(std::string const& hostname, int out_port, int
     setMainStream(new UDPServerStream(sfd, true, &peer, &peer_len));
 }
 
-int Driver::openSerialIO(std::string const& port, int baud_rate)
+int Driver::openSerialIO(std::string const& port, int baud_rate, SerialConfiguration const& config)
 {
     int fd = ::open(port.c_str(), O_RDWR | O_NOCTTY | O_SYNC | O_NONBLOCK );
     if (fd == FDStream::INVALID_FD)
@@ -393,6 +531,8 @@ int Driver::openSerialIO(std::string const& port, int baud_rate)
     memset(&tio, 0, sizeof(termios));
     tio.c_cflag = CS8 | CREAD;    // data bits = 8bit and enable receiver
     tio.c_iflag = IGNBRK; // don't use breaks by default
+    tio.c_cc[VMIN] = config.vmin;
+    tio.c_cc[VTIME] = config.vtime;
 
     // Commit
     if (tcsetattr(fd, TCSANOW, &tio)!=0)
@@ -401,6 +541,13 @@ int Driver::openSerialIO(std::string const& port, int baud_rate)
     if (!setSerialBaudrate(fd, baud_rate))
         throw UnixError("Driver::openSerial cannot set baudrate");
 
+    // Not all devices support it (e.g. PTYs), so this is best-effort
+    if (!setSerialLowLatency(fd, config.low_latency))
+        ROS_DEBUG("Driver::openSerial cannot change the low latency flag of %s", port.c_str());
+
+    if (config.latency_timer >= 0)
+        setSerialLatencyTimer(port, config.latency_timer);
+
     guard.release();
     return fd;
 }
@@ -413,107 +560,13 @@ void Driver::openFile(std::string const& path)
     setFileDescriptor(fd);
 }
 
-bool Driver::setSerialBaudrate(int brate) {
-    return setSerialBaudrate(getFileDescriptor(), brate);
+void Driver::openReplay(std::string const& path, double speed, unsigned int stream)
+{
+    setMainStream(new ReplayStream(path, speed, stream));
 }
 
-bool Driver::setSerialBaudrate(int fd, int brate) {
-    int tc_rate = 0;
-#ifdef __gnu_linux__
-    bool custom_rate = false;
-#endif
-    switch(brate) {
-	case(SERIAL_1200):
-	    tc_rate = B1200;
-	    break;
-	case(SERIAL_2400):
-	    tc_rate = B2400;
-	    break;
-	case(SERIAL_4800):
-	    tc_rate = B4800;
-	    break;
-        case(SERIAL_9600):
-            tc_rate = B9600;
-            break;
-        case(SERIAL_19200):
-            tc_rate = B19200;
-            break;
-        case(SERIAL_38400):
-            tc_rate = B38400;
-            break;
-        case(SERIAL_57600):
-            tc_rate = B57600;
-            break;
-        case(SERIAL_115200):
-            tc_rate = B115200;
-            break;
-        case(SERIAL_230400):
-            tc_rate = B230400;
-            break;
-        case(SERIAL_460800):
-            tc_rate = B460800;
-            break;
-        case(SERIAL_576000):
-            tc_rate = B576000;
-            break;
-        case(SERIAL_921600):
-            tc_rate = B921600;
-            break;
-        default:
-#ifdef __gnu_linux__
-	    tc_rate = B38400;
-	    custom_rate = true;
-            std::cerr << "Using custom baud rate " << brate << std::endl;
-#else
-            std::cerr << "Non-standard baud rate selected. This is only supported on linux." << std::endl;
-            return false;
-#endif
-    }
-
-#ifdef __gnu_linux__
-    struct serial_struct ss;
-    ioctl(fd, TIOCGSERIAL, &ss);
-    if( custom_rate )
-    {
-	ss.flags = (ss.flags & ~ASYNC_SPD_MASK) | ASYNC_SPD_CUST;
-	ss.custom_divisor = (ss.baud_base + (brate / 2)) / brate;
-	int closestSpeed = ss.baud_base / ss.custom_divisor;
-
-	if (closestSpeed < brate * 98 / 100 || closestSpeed > brate * 102 / 100)
-	{
-	    std::cerr << "Cannot set custom serial rate to " << brate
-		<< ". The closest possible value is " << closestSpeed << "."
-		<< std::endl;
-	}
-    }
-    else
-    {
-	ss.flags &= ~ASYNC_SPD_MASK;
-    }
-    ioctl(fd, TIOCSSERIAL, &ss);
-#endif
-
-    struct termios termios_p;
-    if(tcgetattr(fd, &termios_p)){
-        perror("Failed to get terminal info \n");
-        return false;
-    }
-
-    if(cfsetispeed(&termios_p, tc_rate)){
-        perror("Failed to set terminal input speed \n");
-        return false;
-    }
-
-    if(cfsetospeed(&termios_p, tc_rate)){
-        perror("Failed to set terminal output speed \n");
-        return false;
-    }
-
-    if(tcsetattr(fd, TCSANOW, &termios_p)) {
-        perror("Failed to set speed \n");
-        return false;
-    }
-    return true;
+bool Driver::setSerialBaudrate(int brate) {
+    return setSerialBaudrate(getFileDescriptor(), brate);
 }
 
 void Driver::close()
@@ -526,6 +579,11 @@ std::pair<uint8_t const*, int> Driver::findPacket(uint8_t const* buffer, int buf
 {
     int packet_start = 0, packet_size = 0;
     int extract_result = extractPacket(buffer, buffer_size);
+    ROS_DRIVER_BASE_PROBE2(extract, buffer_size, extract_result);
+    {
+        StatusCounters::Update update(m_stats.read);
+        StatusCounters::add(m_stats.read.extract_calls);
+    }
 
     // make sure the returned packet size is not longer than
     // the buffer
@@ -545,9 +603,10 @@ std::pair<uint8_t const*, int> Driver::findPacket(uint8_t const* buffer, int buf
 
     if (m_extract_last)
     {
-        m_stats.stamp = ros::Time::now();
-        m_stats.bad_rx  += packet_start;
-        m_stats.good_rx += packet_size;
+        StatusCounters::Update update(m_stats.read);
+        StatusCounters::stamp(m_stats.read);
+        StatusCounters::add(m_stats.read.bad_rx, packet_start);
+        StatusCounters::add(m_stats.read.good_rx, packet_size);
     }
 
     int remaining = buffer_size - (packet_start + packet_size);
@@ -583,12 +642,6 @@ std::pair<uint8_t const*, int> Driver::findPacket(uint8_t const* buffer, int buf
 int Driver::doPacketExtraction(uint8_t* buffer)
 {
     pair<uint8_t const*, int> packet = findPacket(internal_buffer, internal_buffer_size);
-    if (!m_extract_last)
-    {
-        m_stats.stamp = ros::Time::now();
-        m_stats.bad_rx  += packet.first - internal_buffer;
-        m_stats.good_rx += packet.second;
-    }
     // cerr << "found packet " << printable_com(packet.first, packet.second) << " in internal buffer" << endl;
 
     int buffer_rem = internal_buffer_size - (packet.first + packet.second - internal_buffer);
@@ -596,6 +649,29 @@ int Driver::doPacketExtraction(uint8_t* buffer)
     memmove(internal_buffer, packet.first + packet.second, buffer_rem);
     internal_buffer_size = buffer_rem;
 
+    StatusCounters::Update update(m_stats.read);
+    if (!m_extract_last)
+    {
+        StatusCounters::stamp(m_stats.read);
+        StatusCounters::add(m_stats.read.bad_rx, packet.first - internal_buffer);
+        StatusCounters::add(m_stats.read.good_rx, packet.second);
+    }
+    m_stats.read.queued_bytes.store(buffer_rem, boost::memory_order_relaxed);
+
+    if (packet.second)
+    {
+        m_stats.read.packet_size.record(packet.second);
+        if (m_first_byte_time)
+        {
+            // The remaining bytes have been received by now at the latest
+            int64_t now = Deadline::now();
+            m_stats.read.packet_assembly_time.record(now - m_first_byte_time);
+            m_first_byte_time = buffer_rem ? now : 0;
+        }
+    }
+    else if (!buffer_rem)
+        m_first_byte_time = 0;
+
     return packet.second;
 }
 
@@ -639,6 +715,13 @@ pair<int, bool> Driver::readPacketInternal(uint8_t* buffer, int out_buffer_size)
     while (true) {
         // cerr << "reading with " << printable_com(buffer, buffer_size) << " as buffer" << endl;
         int c = m_stream->read(internal_buffer + internal_buffer_size, MAX_PACKET_SIZE - internal_buffer_size);
+        ROS_DRIVER_BASE_PROBE3(read, getFileDescriptor(), MAX_PACKET_SIZE - internal_buffer_size, c);
+        {
+            StatusCounters::Update update(m_stats.read);
+            StatusCounters::add(m_stats.read.read_calls);
+            if (c <= 0)
+                StatusCounters::add(m_stats.read.empty_reads);
+        }
         if (c > 0) {
             for (set<IOListener*>::iterator it = m_listeners.begin(); it != m_listeners.end(); ++it)
                 (*it)->readData(internal_buffer + internal_buffer_size, c);
@@ -646,6 +729,8 @@ pair<int, bool> Driver::readPacketInternal(uint8_t* buffer, int out_buffer_size)
             received_something = true;
 
             // cerr << "received: " << printable_com(buffer + buffer_size, c) << endl;
+            if (!internal_buffer_size)
+                m_first_byte_time = Deadline::now();
             internal_buffer_size += c;
 
             int new_packet = doPacketExtraction(buffer);
@@ -672,10 +757,22 @@ bool Driver::hasPacket() const
     if (internal_buffer_size == 0)
         return false;
 
+    // findPacket updates the statistics in several steps, publish them at once
+    StatusCounters::Update update(m_stats.read);
     pair<uint8_t const*, int> packet = findPacket(internal_buffer, internal_buffer_size);
     return (packet.second > 0);
 }
 
+static ros::Duration durationFromMilliseconds(int ms)
+{
+    return ros::Duration(ms / 1000, (ms % 1000) * 1000000);
+}
+
+static string formatDuration(ros::Duration const& duration)
+{
+    return boost::lexical_cast<string>(duration.toNSec() / 1000) + "us";
+}
+
 void Driver::setReadTimeout(ros::Duration const& timeout)
 { m_read_timeout = timeout; }
 ros::Duration Driver::getReadTimeout() const
@@ -690,16 +787,17 @@ int Driver::readPacket(uint8_t* buffer, int buffer_size,
     return readPacket(buffer, buffer_size, packet_timeout,
             packet_timeout + ros::Duration(1.0));
 }
-int Driver::readPacket(uint8_t* buffer, int buffer_size,
-        ros::Duration const& packet_timeout, ros::Duration const& first_byte_timeout)
+int Driver::readPacket(uint8_t* buffer, int buffer_size, int packet_timeout, int first_byte_timeout)
 {
-    return readPacket(buffer, buffer_size, packet_timeout.toSec() * 1000L,
-            first_byte_timeout.toSec() * 1000L);
+    if (first_byte_timeout < 0)
+        return readPacket(buffer, buffer_size, durationFromMilliseconds(packet_timeout));
+    return readPacket(buffer, buffer_size, durationFromMilliseconds(packet_timeout),
+            durationFromMilliseconds(first_byte_timeout));
 }
-int Driver::readPacket(uint8_t* buffer, int buffer_size, int packet_timeout, int first_byte_timeout)
+int Driver::readPacket(uint8_t* buffer, int buffer_size,
+        ros::Duration const& packet_timeout, ros::Duration const& first_byte_timeout)
 {
-    if (first_byte_timeout > packet_timeout)
-        first_byte_timeout = -1;
+    bool use_first_byte_timeout = (first_byte_timeout <= packet_timeout);
 
     if (buffer_size < MAX_PACKET_SIZE)
         throw length_error("readPacket(): provided buffer too small (got "
@@ -710,68 +808,153 @@ int Driver::readPacket(uint8_t* buffer, int buffer_size, int packet_timeout, int
     {
         // No valid file descriptor. Assume that the user is using the raw data
         // interface (i.e. that the data is already in the internal read buffer)
-        pair<int, bool> result = extractPacketFromInternalBuffer(buffer, buffer_size);
-        if (result.first)
-            return result.first;
-        else
-            throw TimeoutError(TimeoutError::PACKET,
-                    "readPacket(): no packet in the internal buffer and no FD to read from");
+        while (true)
+        {
+            pair<int, bool> result = extractPacketFromInternalBuffer(buffer, buffer_size);
+            if (!result.first)
+            {
+                processTransactionTimeouts();
+                ROS_DRIVER_BASE_PROBE2(timeout, FDStream::INVALID_FD, TimeoutError::PACKET);
+                throw TimeoutError(TimeoutError::PACKET,
+                        "readPacket(): no packet in the internal buffer and no FD to read from");
+            }
+            else if (!matchTransaction(buffer, result.first))
+            {
+                ROS_DRIVER_BASE_PROBE2(packet, FDStream::INVALID_FD, result.first);
+                return result.first;
+            }
+        }
     }
 
     if(!m_stream)
         throw std::runtime_error("Driver::writePacket : invalid stream, did you forget to call open ?");
 
-    Timeout time_out;
+    Deadline packet_deadline(packet_timeout);
+    Deadline first_byte_deadline(first_byte_timeout);
+    int64_t start_time = packet_deadline.toNSec() - packet_timeout.toNSec();
     bool read_something = false;
+    // Start of the current wait for data, when busy-polling is enabled
+    int64_t wait_start = 0;
+    // Whether the last waitRead returned because data was available
+    bool woken = false;
     while(true) {
 
         pair<int, bool> read_state = readPacketInternal(buffer, buffer_size);
 
         int packet_size = read_state.first;
+        if (woken && !read_state.second)
+        {
+            StatusCounters::Update update(m_stats.read);
+            StatusCounters::add(m_stats.read.spurious_wakeups);
+        }
+        woken = false;
 
         read_something = read_something || read_state.second;
 
-        if (packet_size > 0)
+        if (read_state.second && wait_start)
+        {
+            updateSpinBudget(Deadline::now() - wait_start);
+            wait_start = 0;
+        }
+
+        if (packet_size > 0 && !matchTransaction(buffer, packet_size))
+        {
+            ROS_DRIVER_BASE_PROBE2(packet, getFileDescriptor(), packet_size);
+            StatusCounters::Update update(m_stats.read);
+            m_stats.read.read_wait_time.record(Deadline::now() - start_time);
             return packet_size;
+        }
+        else if (packet_size > 0)
+            continue;
 
         // if there was no data to read _and_ packet_timeout is zero, we'll throw
-        if (packet_timeout == 0)
+        if (packet_timeout.isZero())
+        {
+            processTransactionTimeouts();
+            ROS_DRIVER_BASE_PROBE2(timeout, getFileDescriptor(), TimeoutError::FIRST_BYTE);
             throw TimeoutError(TimeoutError::FIRST_BYTE,
                     "readPacket(): no data to read while a packet_timeout of 0 was given");
+        }
 
-        int timeout;
+        Deadline const* deadline;
+        ros::Duration const* timeout;
         TimeoutError::TIMEOUT_TYPE timeout_type;
-        if (first_byte_timeout != -1 && !read_something)
+        if (use_first_byte_timeout && !read_something)
         {
-            timeout = first_byte_timeout;
+            deadline = &first_byte_deadline;
+            timeout = &first_byte_timeout;
             timeout_type = TimeoutError::FIRST_BYTE;
         }
         else
         {
-            timeout = packet_timeout;
+            deadline = &packet_deadline;
+            timeout = &packet_timeout;
             timeout_type = TimeoutError::PACKET;
         }
 
-        if (time_out.elapsed(timeout))
+        // we still have time left to wait for arriving data. see how much
+        ros::Duration remaining_timeout = deadline->timeLeft();
+        if (remaining_timeout.isZero())
         {
+            ROS_DRIVER_BASE_PROBE2(timeout, getFileDescriptor(), timeout_type);
             throw TimeoutError(timeout_type,
                 "readPacket(): no data after waiting "
-                + boost::lexical_cast<string>(timeout) + "ms");
+                + formatDuration(*timeout));
+        }
+
+        // Wake up in time for the transaction timeouts
+        bool capped_by_transaction = false;
+        if (m_transaction_count.load())
+        {
+            processTransactionTimeouts();
+            if (m_transaction_count.load())
+            {
+                int64_t transaction_timeout = getNextTransactionDeadline() - Deadline::now();
+                if (transaction_timeout < remaining_timeout.toNSec())
+                {
+                    remaining_timeout.fromNSec(std::max<int64_t>(transaction_timeout, 0));
+                    capped_by_transaction = true;
+                }
+            }
+        }
+
+        // Busy-polling is measured in real time, and would never end on a
+        // clock that only moves when waiting. The waits are timed even when
+        // an adaptive budget dropped to zero, so that it can grow back
+        bool timed_wait = m_spin_budget > 0 ||
+            (m_polling.adaptive && m_polling.max_spin.toNSec() > 0);
+        if (timed_wait && !Clock::getCurrent())
+        {
+            // busy-poll the non-blocking read before blocking in waitRead
+            int64_t now = Deadline::now();
+            if (!wait_start)
+                wait_start = now;
+            if (now - wait_start < m_spin_budget)
+            {
+                cpuRelax(m_polling.pause_count);
+                continue;
+            }
         }
 
-        // we still have time left to wait for arriving data. see how much
-        int remaining_timeout = time_out.timeLeft(timeout);
         try {
             // calls select and waits until a new read can be actually performed (in the next
             // while-iteration)
-            m_stream->waitRead(ros::Duration(remaining_timeout / (double)1000.0));
+            {
+                StatusCounters::Update update(m_stats.read);
+                StatusCounters::add(m_stats.read.wait_calls);
+            }
+            m_stream->waitRead(remaining_timeout);
+            woken = true;
         }
         catch(TimeoutError& e)
         {
+            if (capped_by_transaction)
+                continue;
+            ROS_DRIVER_BASE_PROBE2(timeout, getFileDescriptor(), timeout_type);
             throw TimeoutError(timeout_type,
                 "readPacket(): no data after retrying with remaining time "
-                + boost::lexical_cast<string>(remaining_timeout) + "ms of "
-                + boost::lexical_cast<string>(timeout) +"ms timeout");
+                + formatDuration(remaining_timeout) + " of "
+                + formatDuration(*timeout) + " timeout");
         }
     }
 }
@@ -785,32 +968,324 @@ bool Driver::writePacket(uint8_t const* buffer, int buffer_size)
 {
   return writePacket(buffer, buffer_size, getWriteTimeout());
 }
-bool Driver::writePacket(uint8_t const* buffer, int buffer_size, ros::Duration const& timeout)
-{ return writePacket(buffer, buffer_size, timeout.toSec() * 1000L); }
 bool Driver::writePacket(uint8_t const* buffer, int buffer_size, int timeout)
+{ return writePacket(buffer, buffer_size, durationFromMilliseconds(timeout)); }
+bool Driver::writePacket(uint8_t const* buffer, int buffer_size, ros::Duration const& timeout)
 {
     if(!m_stream)
         throw std::runtime_error("Driver::writePacket : invalid stream, did you forget to call open ?");
 
-    Timeout time_out(timeout);
+    Deadline deadline(timeout);
     int written = 0;
+    bool woken = false;
     while(true) {
         int c = m_stream->write(buffer + written, buffer_size - written);
+        ROS_DRIVER_BASE_PROBE3(write, getFileDescriptor(), buffer_size - written, c);
+        countWriteCall(buffer_size - written, c, woken);
         for (set<IOListener*>::iterator it = m_listeners.begin(); it != m_listeners.end(); ++it)
             (*it)->writeData(buffer + written, c);
         written += c;
 
         if (written == buffer_size) {
-            m_stats.stamp = ros::Time::now();
-	          m_stats.tx += buffer_size;
+            StatusCounters::Update update(m_stats.write);
+            StatusCounters::stamp(m_stats.write);
+            StatusCounters::add(m_stats.write.tx, buffer_size);
+            m_stats.write.write_time.record(Deadline::now() - (deadline.toNSec() - timeout.toNSec()));
             return true;
         }
 
-        if (time_out.elapsed())
+        ros::Duration remaining_timeout = deadline.timeLeft();
+        if (remaining_timeout.isZero())
+        {
+            ROS_DRIVER_BASE_PROBE2(timeout, getFileDescriptor(), TimeoutError::PACKET);
             throw TimeoutError(TimeoutError::PACKET, "writePacket(): timeout");
+        }
+
+        countWriteWait();
+        m_stream->waitWrite(remaining_timeout);
+        woken = true;
+    }
+}
+
+void Driver::countWriteCall(size_t requested, size_t written, bool after_wait)
+{
+    StatusCounters::Update update(m_stats.write);
+    StatusCounters::add(m_stats.write.write_calls);
+    if (written < requested)
+        StatusCounters::add(m_stats.write.partial_writes);
+    if (after_wait && !written)
+        StatusCounters::add(m_stats.write.spurious_wakeups);
+}
+
+void Driver::countWriteWait()
+{
+    StatusCounters::Update update(m_stats.write);
+    StatusCounters::add(m_stats.write.wait_calls);
+}
+
+void Driver::writePackets(struct iovec const* packets, int count, ros::Duration const& timeout)
+{
+    if(!m_stream)
+        throw std::runtime_error("Driver::writePackets : invalid stream, did you forget to call open ?");
+
+    Deadline deadline(timeout);
+    size_t total = 0;
+    int index = 0;
+    size_t offset = 0;
+    bool woken = false;
+    bool vectored = m_stream->hasVectoredWrite();
+    while (true)
+    {
+        // skip empty packets
+        while (index < count && offset == 0 && packets[index].iov_len == 0)
+            ++index;
+        if (index == count)
+            break;
+
+        uint8_t const* base = static_cast<uint8_t const*>(packets[index].iov_base);
+        size_t c;
+        size_t requested = packets[index].iov_len - offset;
+        if (offset == 0 && vectored)
+        {
+            for (int i = index + 1; i < count; ++i)
+                requested += packets[i].iov_len;
+            c = m_stream->writev(packets + index, count - index);
+        }
+        else
+        {
+            // Finish the packet that got partially written, or write the
+            // packets one by one if the stream would do it anyways, so that
+            // each call is counted
+            c = m_stream->write(base + offset, requested);
+        }
+        ROS_DRIVER_BASE_PROBE3(write, getFileDescriptor(), requested, c);
+        countWriteCall(requested, c, woken);
+        total += c;
+        bool complete = (c == requested);
+
+        while (c > 0)
+        {
+            base = static_cast<uint8_t const*>(packets[index].iov_base);
+            size_t chunk = std::min(c, packets[index].iov_len - offset);
+            for (set<IOListener*>::iterator it = m_listeners.begin(); it != m_listeners.end(); ++it)
+                (*it)->writeData(base + offset, chunk);
+            c -= chunk;
+            offset += chunk;
+            if (offset == packets[index].iov_len)
+            {
+                ++index;
+                offset = 0;
+            }
+        }
+        // the stream took everything, go on with the next packet if any
+        if (complete)
+        {
+            woken = false;
+            continue;
+        }
+
+        ros::Duration remaining_timeout = deadline.timeLeft();
+        if (remaining_timeout.isZero())
+        {
+            ROS_DRIVER_BASE_PROBE2(timeout, getFileDescriptor(), TimeoutError::PACKET);
+            throw TimeoutError(TimeoutError::PACKET, "writePackets(): timeout");
+        }
+
+        countWriteWait();
+        m_stream->waitWrite(remaining_timeout);
+        woken = true;
+    }
+
+    StatusCounters::Update update(m_stats.write);
+    StatusCounters::stamp(m_stats.write);
+    StatusCounters::add(m_stats.write.tx, total);
+    m_stats.write.write_time.record(Deadline::now() - (deadline.toNSec() - timeout.toNSec()));
+}
+
+int Driver::tryReadPacket(uint8_t* buffer, int buffer_size)
+{
+    if (buffer_size < MAX_PACKET_SIZE)
+        throw length_error("tryReadPacket(): provided buffer too small (got "
+                + boost::lexical_cast<string>(buffer_size) + ", expected at least "
+                + boost::lexical_cast<string>(MAX_PACKET_SIZE) + ")");
+
+    if(!m_stream)
+        throw std::runtime_error("Driver::tryReadPacket : invalid stream, did you forget to call open ?");
+
+    while (true)
+    {
+        int packet_size = readPacketInternal(buffer, buffer_size).first;
+        if (!packet_size)
+        {
+            processTransactionTimeouts();
+            return 0;
+        }
+        else if (!matchTransaction(buffer, packet_size))
+        {
+            ROS_DRIVER_BASE_PROBE2(packet, getFileDescriptor(), packet_size);
+            return packet_size;
+        }
+    }
+}
+
+int Driver::tryWrite(uint8_t const* buffer, int buffer_size)
+{
+    if(!m_stream)
+        throw std::runtime_error("Driver::tryWrite : invalid stream, did you forget to call open ?");
+
+    int c = m_stream->write(buffer, buffer_size);
+    ROS_DRIVER_BASE_PROBE3(write, getFileDescriptor(), buffer_size, c);
+    countWriteCall(buffer_size, c, false);
+    for (set<IOListener*>::iterator it = m_listeners.begin(); it != m_listeners.end(); ++it)
+        (*it)->writeData(buffer, c);
+    if (c > 0)
+    {
+        StatusCounters::Update update(m_stats.write);
+        StatusCounters::stamp(m_stats.write);
+        StatusCounters::add(m_stats.write.tx, c);
+    }
+    return c;
+}
+
+namespace
+{
+    /** Completes a promise from a transaction's reply */
+    struct PromiseReplyCallback
+    {
+        typedef boost::promise< std::vector<uint8_t> > Promise;
+        boost::shared_ptr<Promise> promise;
+
+        void operator()(uint8_t const* packet, size_t size)
+        {
+            if (packet)
+                promise->set_value(std::vector<uint8_t>(packet, packet + size));
+            else
+                promise->set_exception(boost::copy_exception(
+                    TimeoutError(TimeoutError::PACKET, "transaction timed out")));
+        }
+    };
+}
+
+uint64_t Driver::startTransaction(uint8_t const* request, int request_size,
+        ReplyMatcher const& matcher, ReplyCallback const& callback,
+        ros::Duration const& timeout)
+{
+    // Register the transaction before writing, so that a fast reply cannot
+    // be missed
+    PendingTransaction transaction;
+    transaction.matcher = matcher;
+    transaction.callback = callback;
+    transaction.deadline = Deadline(timeout).toNSec();
+
+    boost::lock_guard<boost::mutex> write_lock(m_transaction_write_mutex);
+    {
+        boost::lock_guard<boost::mutex> lock(m_transaction_mutex);
+        transaction.id = m_next_transaction_id++;
+        m_transactions.push_back(transaction);
+        m_transaction_count.store(m_transactions.size());
+    }
+
+    try {
+        writePacket(request, request_size);
+    }
+    catch(...) {
+        cancelTransaction(transaction.id);
+        throw;
+    }
+    return transaction.id;
+}
+
+boost::unique_future< std::vector<uint8_t> > Driver::startTransaction(
+        uint8_t const* request, int request_size,
+        ReplyMatcher const& matcher, ros::Duration const& timeout)
+{
+    PromiseReplyCallback callback;
+    callback.promise.reset(new PromiseReplyCallback::Promise);
+    startTransaction(request, request_size, matcher, callback, timeout);
+    // Returning the temporary directly is what allows the future to be
+    // moved out with the C++03 move emulation. A reply or timeout that
+    // came in the meantime is kept by the promise
+    return callback.promise->get_future();
+}
+
+bool Driver::cancelTransaction(uint64_t id)
+{
+    boost::lock_guard<boost::mutex> lock(m_transaction_mutex);
+    for (list<PendingTransaction>::iterator it = m_transactions.begin(); it != m_transactions.end(); ++it)
+    {
+        if (it->id == id)
+        {
+            m_transactions.erase(it);
+            m_transaction_count.store(m_transactions.size());
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t Driver::getPendingTransactionCount() const
+{
+    return m_transaction_count.load();
+}
+
+bool Driver::matchTransaction(uint8_t const* packet, int size)
+{
+    if (!m_transaction_count.load())
+        return false;
+
+    ReplyCallback callback;
+    {
+        boost::lock_guard<boost::mutex> lock(m_transaction_mutex);
+        for (list<PendingTransaction>::iterator it = m_transactions.begin(); it != m_transactions.end(); ++it)
+        {
+            if (it->matcher(packet, size))
+            {
+                callback = it->callback;
+                m_transactions.erase(it);
+                m_transaction_count.store(m_transactions.size());
+                break;
+            }
+        }
+    }
+
+    if (!callback)
+        return false;
+    callback(packet, size);
+    return true;
+}
 
-        int remaining_timeout = time_out.timeLeft();
-        m_stream->waitWrite(ros::Duration(remaining_timeout / (double)1000.0));
+void Driver::processTransactionTimeouts()
+{
+    if (!m_transaction_count.load())
+        return;
+
+    int64_t now = Deadline::now();
+    vector<ReplyCallback> expired;
+    {
+        boost::lock_guard<boost::mutex> lock(m_transaction_mutex);
+        list<PendingTransaction>::iterator it = m_transactions.begin();
+        while (it != m_transactions.end())
+        {
+            if (it->deadline <= now)
+            {
+                expired.push_back(it->callback);
+                it = m_transactions.erase(it);
+            }
+            else
+                ++it;
+        }
+        m_transaction_count.store(m_transactions.size());
     }
+
+    for (size_t i = 0; i < expired.size(); ++i)
+        expired[i](NULL, 0);
 }
 
+int64_t Driver::getNextTransactionDeadline()
+{
+    boost::lock_guard<boost::mutex> lock(m_transaction_mutex);
+    int64_t result = std::numeric_limits<int64_t>::max();
+    for (list<PendingTransaction>::iterator it = m_transactions.begin(); it != m_transactions.end(); ++it)
+        result = std::min(result, it->deadline);
+    return result;
+}
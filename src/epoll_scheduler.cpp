@@ -0,0 +1,164 @@
+#include <ros_driver_base/io_scheduler.hpp>
+#include <ros_driver_base/exceptions.hpp>
+#include <ros_driver_base/timeout.hpp>
+#include <ros_driver_base/clock.hpp>
+
+#include <sys/epoll.h>
+#include <errno.h>
+#include <stdexcept>
+
+using namespace std;
+using namespace ros_driver_base;
+
+EpollScheduler::EpollScheduler()
+    : m_epoll_fd(epoll_create1(EPOLL_CLOEXEC))
+    , m_quit(false)
+{
+    if (m_epoll_fd.get() == -1)
+        throw UnixError("EpollScheduler: cannot create the epoll instance");
+}
+
+void EpollScheduler::waitFD(int fd, Event event, int64_t deadline, Callback const& callback)
+{
+    Wait& wait = m_fds[fd].waits[event];
+    if (wait.active)
+        throw std::logic_error("EpollScheduler: there is already a wait on this file descriptor");
+
+    wait.active = true;
+    wait.callback = callback;
+    wait.timer = m_timers.insert(make_pair(deadline, make_pair(fd, event)));
+    updateInterest(fd);
+}
+
+bool EpollScheduler::cancel(int fd, Event event)
+{
+    map<int, Registration>::iterator it = m_fds.find(fd);
+    if (it == m_fds.end() || !it->second.waits[event].active)
+        return false;
+
+    Wait& wait = it->second.waits[event];
+    wait.active = false;
+    wait.callback.clear();
+    m_timers.erase(wait.timer);
+    updateInterest(fd);
+    return true;
+}
+
+void EpollScheduler::updateInterest(int fd)
+{
+    map<int, Registration>::iterator it = m_fds.find(fd);
+    if (it == m_fds.end())
+        return;
+
+    Registration& reg = it->second;
+    uint32_t events = 0;
+    if (reg.waits[READ].active)
+        events |= EPOLLIN;
+    if (reg.waits[WRITE].active)
+        events |= EPOLLOUT;
+    if (events == reg.events)
+        return;
+
+    int op;
+    if (!events)
+        op = EPOLL_CTL_DEL;
+    else if (!reg.events)
+        op = EPOLL_CTL_ADD;
+    else
+        op = EPOLL_CTL_MOD;
+
+    epoll_event ev = epoll_event();
+    ev.events = events;
+    ev.data.fd = fd;
+    if (epoll_ctl(m_epoll_fd.get(), op, fd, &ev) == -1 && op != EPOLL_CTL_DEL)
+        throw UnixError("EpollScheduler: cannot watch file descriptor");
+
+    if (events)
+        reg.events = events;
+    else
+        m_fds.erase(it);
+}
+
+bool EpollScheduler::dispatch(int fd, Event event, bool timed_out)
+{
+    map<int, Registration>::iterator it = m_fds.find(fd);
+    if (it == m_fds.end() || !it->second.waits[event].active)
+        return false;
+
+    // Deactivate the wait before calling back, as the callback usually
+    // registers the next one. The epoll set is updated only afterwards, so
+    // that such a re-arm costs no epoll_ctl call at all
+    Wait& wait = it->second.waits[event];
+    Callback callback;
+    callback.swap(wait.callback);
+    wait.active = false;
+    m_timers.erase(wait.timer);
+    try { callback(timed_out); }
+    catch(...)
+    {
+        updateInterest(fd);
+        throw;
+    }
+    updateInterest(fd);
+    return true;
+}
+
+size_t EpollScheduler::runOnce(ros::Duration const& timeout)
+{
+    int64_t timeout_ns = timeout.toNSec();
+    if (!m_timers.empty())
+        timeout_ns = std::min(timeout_ns, m_timers.begin()->first - Deadline::now());
+    // round up so that we do not wake up right before the deadline
+    int timeout_ms = std::max<int64_t>(0, (timeout_ns + 999999) / 1000000);
+
+    static const int MAX_EVENTS = 64;
+    epoll_event events[MAX_EVENTS];
+    int count = epoll_wait(m_epoll_fd.get(), events, MAX_EVENTS, timeout_ms);
+    if (count == -1)
+    {
+        if (errno == EINTR)
+            return 0;
+        throw UnixError("EpollScheduler: epoll_wait failed");
+    }
+    else if (count == 0)
+        Clock::waitTimedOut(ros::Duration().fromNSec(timeout_ms * 1000000LL));
+
+    size_t called = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        int fd = events[i].data.fd;
+        // Errors and hangups are reported to both directions, the callbacks
+        // get the actual error on the next read or write
+        uint32_t errors = EPOLLERR | EPOLLHUP;
+        if ((events[i].events & (EPOLLIN | errors)) && dispatch(fd, READ, false))
+            ++called;
+        if ((events[i].events & (EPOLLOUT | errors)) && dispatch(fd, WRITE, false))
+            ++called;
+    }
+
+    int64_t now = Deadline::now();
+    while (!m_timers.empty() && m_timers.begin()->first <= now)
+    {
+        std::pair<int, Event> wait = m_timers.begin()->second;
+        dispatch(wait.first, wait.second, true);
+        ++called;
+    }
+    return called;
+}
+
+void EpollScheduler::run()
+{
+    m_quit = false;
+    while (!m_quit && !m_timers.empty())
+        runOnce(ros::Duration(1));
+}
+
+void EpollScheduler::stop()
+{
+    m_quit = true;
+}
+
+size_t EpollScheduler::getWaitCount() const
+{
+    return m_timers.size();
+}
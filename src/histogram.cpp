@@ -0,0 +1,95 @@
+#include <ros_driver_base/histogram.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+using namespace ros_driver_base;
+
+Histogram::Histogram(unsigned int sub_bucket_bits, unsigned int max_value_bits)
+    : m_sub_bucket_bits(sub_bucket_bits)
+    , m_max_value((uint64_t(1) << max_value_bits) - 1)
+    , m_count(0)
+    , m_sum(0)
+    , m_min(std::numeric_limits<uint64_t>::max())
+    , m_max(0)
+{
+    if (sub_bucket_bits == 0 || max_value_bits <= sub_bucket_bits || max_value_bits > 63)
+        throw std::invalid_argument("Histogram: invalid resolution");
+
+    m_counts.resize((max_value_bits - sub_bucket_bits + 1) << sub_bucket_bits);
+}
+
+uint64_t Histogram::getBucketMaxValue(size_t index) const
+{
+    size_t sub_bucket_count = size_t(1) << m_sub_bucket_bits;
+    if (index < sub_bucket_count)
+        return index;
+
+    unsigned int shift = index / sub_bucket_count - 1;
+    uint64_t sub_bucket = index % sub_bucket_count + sub_bucket_count;
+    return ((sub_bucket + 1) << shift) - 1;
+}
+
+double Histogram::getMean() const
+{
+    if (!m_count)
+        return 0;
+    return static_cast<double>(m_sum) / m_count;
+}
+
+uint64_t Histogram::getPercentile(double percentile) const
+{
+    if (!m_count)
+        return 0;
+
+    uint64_t rank = static_cast<uint64_t>(std::ceil(percentile / 100 * m_count));
+    if (rank == 0)
+        return getMin();
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < m_counts.size(); ++i)
+    {
+        seen += m_counts[i];
+        if (seen >= rank)
+            return std::min(getBucketMaxValue(i), m_max);
+    }
+    return m_max;
+}
+
+void Histogram::merge(Histogram const& other)
+{
+    if (other.m_sub_bucket_bits != m_sub_bucket_bits || other.m_counts.size() != m_counts.size())
+        throw std::invalid_argument("Histogram: cannot merge histograms of different resolutions");
+
+    for (size_t i = 0; i < m_counts.size(); ++i)
+        m_counts[i] += other.m_counts[i];
+    m_count += other.m_count;
+    m_sum += other.m_sum;
+    m_min = std::min(m_min, other.m_min);
+    m_max = std::max(m_max, other.m_max);
+}
+
+void Histogram::reset()
+{
+    for (size_t i = 0; i < m_counts.size(); ++i)
+        set(m_counts[i], 0);
+    set(m_count, 0);
+    set(m_sum, 0);
+    set(m_min, std::numeric_limits<uint64_t>::max());
+    set(m_max, 0);
+}
+
+void Histogram::load(Histogram const& source)
+{
+    if (source.m_sub_bucket_bits != m_sub_bucket_bits || source.m_counts.size() != m_counts.size())
+        throw std::invalid_argument("Histogram: cannot load a histogram of a different resolution");
+
+    for (size_t i = 0; i < m_counts.size(); ++i)
+        m_counts[i] = get(source.m_counts[i]);
+    m_count = get(source.m_count);
+    m_sum = get(source.m_sum);
+    m_min = get(source.m_min);
+    m_max = get(source.m_max);
+}
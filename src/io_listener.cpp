@@ -1,4 +1,8 @@
 #include <ros_driver_base/io_listener.hpp>
+#include <ros_driver_base/timeout.hpp>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
 
 using namespace ros_driver_base;
 
@@ -32,4 +36,207 @@ void BufferListener::readData(boost::uint8_t const* data, size_t size)
     m_readBuffer.insert(m_readBuffer.end(), data, data + size);
 }
 
+RingBufferListener::Ring::Ring(size_t capacity)
+    : m_data(2 * capacity)
+    , m_capacity(capacity)
+    , m_start(0)
+    , m_size(0)
+    , m_dropped(0)
+    , m_position(0)
+    , m_stamp_start(0)
+    , m_stamp_count(0)
+{
+    if (capacity == 0)
+        throw std::invalid_argument("RingBufferListener: capacity cannot be zero");
+}
+
+void RingBufferListener::Ring::setStampCapacity(size_t capacity)
+{
+    m_stamps.resize(capacity);
+    m_stamp_start = 0;
+    m_stamp_count = 0;
+}
+
+/** Writes data at the given ring position, in both copies of the ring
+ */
+void RingBufferListener::Ring::copy(size_t position, boost::uint8_t const* data, size_t size)
+{
+    size_t first = std::min(size, m_capacity - position);
+    memcpy(&m_data[position], data, first);
+    memcpy(&m_data[position + m_capacity], data, first);
+    if (first < size)
+    {
+        memcpy(&m_data[0], data + first, size - first);
+        memcpy(&m_data[m_capacity], data + first, size - first);
+    }
+}
+
+void RingBufferListener::Ring::push(boost::uint8_t const* data, size_t size, OverflowPolicy policy, boost::int64_t now)
+{
+    if (policy == DROP_NEWEST)
+    {
+        size_t room = m_capacity - m_size;
+        if (size > room)
+        {
+            m_dropped += size - room;
+            size = room;
+        }
+    }
+    m_position += size;
+
+    if (size > m_capacity)
+    {
+        // only the end of the data can remain in the ring
+        m_dropped += m_size + size - m_capacity;
+        data += size - m_capacity;
+        size = m_capacity;
+        m_start = 0;
+        m_size = 0;
+    }
+
+    copy((m_start + m_size) % m_capacity, data, size);
+    m_size += size;
+    if (m_size > m_capacity)
+    {
+        size_t excess = m_size - m_capacity;
+        m_dropped += excess;
+        m_start = (m_start + excess) % m_capacity;
+        m_size = m_capacity;
+    }
+
+    if (size == 0 || m_stamps.empty())
+        return;
+    if (m_stamp_count == m_stamps.size())
+    {
+        // The data of the oldest stamp is now covered by the next one
+        m_stamp_start = (m_stamp_start + 1) % m_stamps.size();
+        --m_stamp_count;
+    }
+    Stamp& stamp = m_stamps[(m_stamp_start + m_stamp_count) % m_stamps.size()];
+    stamp.end = m_position;
+    stamp.time = now;
+    ++m_stamp_count;
+}
+
+size_t RingBufferListener::Ring::countOlderThan(boost::int64_t time) const
+{
+    boost::uint64_t start = m_position - m_size;
+    boost::uint64_t end = start;
+    for (size_t i = 0; i < m_stamp_count; ++i)
+    {
+        Stamp const& stamp = m_stamps[(m_stamp_start + i) % m_stamps.size()];
+        if (stamp.time >= time)
+            break;
+        end = stamp.end;
+    }
+    return end > start ? end - start : 0;
+}
+
+void RingBufferListener::Ring::evict(boost::int64_t time)
+{
+    size_t count = countOlderThan(time);
+    m_start = (m_start + count) % m_capacity;
+    m_size -= count;
+
+    // Also forget the stamps of the data that was overwritten
+    boost::uint64_t start = m_position - m_size;
+    while (m_stamp_count && (m_stamps[m_stamp_start].time < time ||
+                m_stamps[m_stamp_start].end <= start))
+    {
+        m_stamp_start = (m_stamp_start + 1) % m_stamps.size();
+        --m_stamp_count;
+    }
+}
+
+RingBufferListener::View RingBufferListener::Ring::view(boost::int64_t time) const
+{
+    size_t skip = countOlderThan(time);
+    View view;
+    view.data = m_data.empty() ? 0 : &m_data[(m_start + skip) % m_capacity];
+    view.size = m_size - skip;
+    return view;
+}
+
+void RingBufferListener::Ring::clear()
+{
+    m_start = 0;
+    m_size = 0;
+    m_stamp_start = 0;
+    m_stamp_count = 0;
+}
+
+RingBufferListener::RingBufferListener(size_t capacity, OverflowPolicy policy)
+    : m_policy(policy)
+    , m_max_age(0)
+    , m_read(capacity)
+    , m_write(capacity)
+{
+}
 
+void RingBufferListener::setMaxAge(ros::Duration const& max_age, size_t max_chunks)
+{
+    if (!max_age.isZero() && max_chunks == 0)
+        throw std::invalid_argument("RingBufferListener: max_chunks cannot be zero");
+
+    m_max_age = max_age.toNSec();
+    size_t stamp_capacity = m_max_age ? max_chunks : 0;
+    m_read.setStampCapacity(stamp_capacity);
+    m_write.setStampCapacity(stamp_capacity);
+}
+
+boost::int64_t RingBufferListener::getOldestTime() const
+{
+    if (!m_max_age)
+        return 0;
+    return Deadline::now() - m_max_age;
+}
+
+RingBufferListener::View RingBufferListener::readView() const
+{
+    return m_read.view(getOldestTime());
+}
+
+RingBufferListener::View RingBufferListener::writeView() const
+{
+    return m_write.view(getOldestTime());
+}
+
+boost::uint64_t RingBufferListener::getDroppedRead() const
+{
+    return m_read.dropped();
+}
+
+boost::uint64_t RingBufferListener::getDroppedWrite() const
+{
+    return m_write.dropped();
+}
+
+void RingBufferListener::clear()
+{
+    m_read.clear();
+    m_write.clear();
+}
+
+void RingBufferListener::writeData(boost::uint8_t const* data, size_t size)
+{
+    pushData(m_write, data, size);
+}
+
+void RingBufferListener::readData(boost::uint8_t const* data, size_t size)
+{
+    pushData(m_read, data, size);
+}
+
+void RingBufferListener::pushData(Ring& ring, boost::uint8_t const* data, size_t size)
+{
+    if (!m_max_age)
+    {
+        ring.push(data, size, m_policy, 0);
+        return;
+    }
+
+    // Evict first, so that the expired data makes room for the new one
+    boost::int64_t now = Deadline::now();
+    ring.evict(now - m_max_age);
+    ring.push(data, size, m_policy, now);
+}
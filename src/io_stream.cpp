@@ -1,5 +1,7 @@
 #include <ros_driver_base/io_stream.hpp>
 #include <ros_driver_base/exceptions.hpp>
+#include <ros_driver_base/clock.hpp>
+#include <ros_driver_base/probes.hpp>
 #include <ros/console.h>
 
 #include <sys/types.h>
@@ -8,15 +10,31 @@
 #include <fcntl.h>
 
 #include <errno.h>
+#include <limits.h>
+#include <algorithm>
 #include <iostream>
 
 using namespace ros_driver_base;
 
 IOStream::~IOStream() {}
 int IOStream::getFileDescriptor() const { return FDStream::INVALID_FD; }
+size_t IOStream::writev(struct iovec const* iov, int iovcnt)
+{
+    size_t total = 0;
+    for (int i = 0; i < iovcnt; ++i)
+    {
+        size_t c = write(static_cast<uint8_t const*>(iov[i].iov_base), iov[i].iov_len);
+        total += c;
+        if (c < iov[i].iov_len)
+            break;
+    }
+    return total;
+}
+bool IOStream::hasVectoredWrite() const { return false; }
 
 FDStream::FDStream(int fd, bool auto_close)
     : m_auto_close(auto_close)
+    , m_datagram(false)
     , m_fd(fd)
 
 {
@@ -24,6 +42,11 @@ FDStream::FDStream(int fd, bool auto_close)
     {
         ROS_DEBUG("FD given to Driver::setFileDescriptor is set as blocking, setting the NONBLOCK flag");
     }
+
+    int type;
+    socklen_t type_size = sizeof(type);
+    if (getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &type_size) == 0)
+        m_datagram = (type == SOCK_DGRAM);
 }
 FDStream::~FDStream()
 {
@@ -37,11 +60,16 @@ void FDStream::waitRead(ros::Duration const& timeout)
     FD_SET(m_fd, &set);
 
     timeval timeout_spec = { static_cast<time_t>(timeout.toSec()), suseconds_t(timeout.toNSec() / 1000 % 1000000)};
+    ROS_DRIVER_BASE_PROBE3(wait_start, m_fd, 0, timeout.toNSec());
     int ret = select(m_fd + 1, &set, NULL, NULL, &timeout_spec);
+    ROS_DRIVER_BASE_PROBE3(wait_done, m_fd, 0, ret);
     if (ret < 0 && errno != EINTR)
         throw UnixError("waitRead(): error in select()");
     else if (ret == 0)
+    {
+        Clock::waitTimedOut(timeout);
         throw TimeoutError(TimeoutError::NONE, "waitRead(): timeout");
+    }
 }
 void FDStream::waitWrite(ros::Duration const& timeout)
 {
@@ -50,11 +78,16 @@ void FDStream::waitWrite(ros::Duration const& timeout)
     FD_SET(m_fd, &set);
 
     timeval timeout_spec = { static_cast<time_t>(timeout.toSec()), suseconds_t(timeout.toNSec() / 1000 % 1000000) };
+    ROS_DRIVER_BASE_PROBE3(wait_start, m_fd, 1, timeout.toNSec());
     int ret = select(m_fd + 1, NULL, &set, NULL, &timeout_spec);
+    ROS_DRIVER_BASE_PROBE3(wait_done, m_fd, 1, ret);
     if (ret < 0 && errno != EINTR)
         throw UnixError("waitWrite(): error in select()");
     else if (ret == 0)
+    {
+        Clock::waitTimedOut(timeout);
         throw TimeoutError(TimeoutError::NONE, "waitWrite(): timeout");
+    }
 }
 size_t FDStream::read(uint8_t* buffer, size_t buffer_size)
 {
@@ -79,6 +112,19 @@ size_t FDStream::write(uint8_t const* buffer, size_t buffer_size)
         return 0;
     return c;
 }
+size_t FDStream::writev(struct iovec const* iov, int iovcnt)
+{
+    if (m_datagram)
+        return IOStream::writev(iov, iovcnt);
+
+    ssize_t c = ::writev(m_fd, iov, std::min(iovcnt, IOV_MAX));
+    if (c == -1 && errno != EAGAIN && errno != ENOBUFS)
+        throw UnixError("writePacket(): error during writev");
+    if (c == -1)
+        return 0;
+    return c;
+}
+bool FDStream::hasVectoredWrite() const { return !m_datagram; }
 void FDStream::clear()
 {
 }
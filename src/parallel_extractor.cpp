@@ -0,0 +1,241 @@
+#include <ros_driver_base/parallel_extractor.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/exception_ptr.hpp>
+
+using namespace std;
+using namespace ros_driver_base;
+
+/** Number of MAX_PACKET_SIZE windows at the start of a segment in which all
+ * the positions the scan goes through are recorded. The sequential scan
+ * usually joins a segment's scan within a few packets. If it does not
+ * within this span, it can still join it on one of its packets
+ */
+static const size_t RESYNC_WINDOWS = 16;
+
+namespace
+{
+    struct PacketOffsetLess
+    {
+        bool operator()(ParallelExtractor::Packet const& packet, size_t offset) const
+        { return packet.offset < offset; }
+    };
+}
+
+ParallelExtractor::Input::Input(vector<struct iovec> const& buffers)
+    : buffers(buffers)
+    , size(0)
+{
+    starts.reserve(buffers.size());
+    for (size_t i = 0; i < buffers.size(); ++i)
+    {
+        starts.push_back(size);
+        size += buffers[i].iov_len;
+    }
+}
+
+uint8_t const* ParallelExtractor::Input::window(size_t position, size_t length, Cursor& cursor) const
+{
+    // The scans move forward, but a new one may start anywhere
+    if (cursor.buffer >= buffers.size() || position < starts[cursor.buffer])
+        cursor.buffer = std::upper_bound(starts.begin(), starts.end(), position) - starts.begin() - 1;
+    while (position >= starts[cursor.buffer] + buffers[cursor.buffer].iov_len)
+        ++cursor.buffer;
+
+    size_t offset = position - starts[cursor.buffer];
+    uint8_t const* data = static_cast<uint8_t const*>(buffers[cursor.buffer].iov_base);
+    if (offset + length <= buffers[cursor.buffer].iov_len)
+        return data + offset;
+
+    // The window spans several buffers, copy it
+    cursor.scratch.resize(length);
+    size_t copied = 0;
+    for (size_t i = cursor.buffer; copied < length; ++i, offset = 0)
+    {
+        size_t chunk = std::min(length - copied, buffers[i].iov_len - offset);
+        memcpy(&cursor.scratch[copied], static_cast<uint8_t const*>(buffers[i].iov_base) + offset, chunk);
+        copied += chunk;
+    }
+    return &cursor.scratch[0];
+}
+
+ParallelExtractor::ParallelExtractor(Driver const& driver, size_t thread_count)
+    : m_driver(driver)
+    , m_thread_count(thread_count)
+{
+    if (!m_thread_count)
+        m_thread_count = std::max(1u, boost::thread::hardware_concurrency());
+}
+
+bool ParallelExtractor::isJoinPoint(Scan const& scan, size_t position)
+{
+    if (std::binary_search(scan.positions.begin(), scan.positions.end(), position))
+        return true;
+    vector<Packet>::const_iterator packet = std::lower_bound(
+            scan.packets.begin(), scan.packets.end(), position, PacketOffsetLess());
+    return packet != scan.packets.end() && packet->offset == position;
+}
+
+size_t ParallelExtractor::scan(Input const& input, size_t start, size_t end,
+        Scan& result, size_t record_until, Scan const* join) const
+{
+    size_t const max_packet_size = m_driver.MAX_PACKET_SIZE;
+    Cursor cursor;
+    cursor.buffer = 0;
+    size_t position = start;
+    while (position < end)
+    {
+        if (join && isJoinPoint(*join, position))
+            return position;
+        else if (position < record_until)
+            result.positions.push_back(position);
+
+        size_t window = std::min(input.size - position, max_packet_size);
+        int extract_result = m_driver.extractPacket(input.window(position, window, cursor), window);
+        if (extract_result > static_cast<int>(window))
+            throw length_error("extractPacket() returned result size "
+                    + boost::lexical_cast<string>(extract_result)
+                    + ", which is larger than the buffer size "
+                    + boost::lexical_cast<string>(window) + ".");
+
+        if (extract_result > 0)
+        {
+            Packet packet = { position, static_cast<size_t>(extract_result) };
+            result.packets.push_back(packet);
+            position += extract_result;
+        }
+        else if (extract_result < 0)
+            position += -extract_result;
+        else if (window < max_packet_size)
+        {
+            result.finished = true;
+            return position;
+        }
+        else // readPacket would throw here, resync on the next byte
+            position += 1;
+    }
+    return position;
+}
+
+void ParallelExtractor::scanSegment(Input const* input, size_t start, size_t end, Scan* result) const
+{
+    result->finished = false;
+    size_t record_until = start + RESYNC_WINDOWS * m_driver.MAX_PACKET_SIZE;
+    result->exit = scan(*input, start, end, *result, record_until);
+}
+
+vector<ParallelExtractor::Packet> ParallelExtractor::extractSequential(uint8_t const* data, size_t size) const
+{
+    return extractSequential(toBuffers(data, size));
+}
+
+vector<ParallelExtractor::Packet> ParallelExtractor::extractSequential(vector<struct iovec> const& buffers) const
+{
+    Input input(buffers);
+    Scan result;
+    result.finished = false;
+    scan(input, 0, input.size, result, 0);
+    return result.packets;
+}
+
+vector<struct iovec> ParallelExtractor::toBuffers(uint8_t const* data, size_t size)
+{
+    struct iovec buffer;
+    buffer.iov_base = const_cast<uint8_t*>(data);
+    buffer.iov_len = size;
+    return vector<struct iovec>(1, buffer);
+}
+
+namespace
+{
+    /** Runs a function and stores the exception it throws, if any */
+    struct CaptureException
+    {
+        boost::function<void()> function;
+        boost::exception_ptr* error;
+
+        void operator()()
+        {
+            try { function(); }
+            catch(...) { *error = boost::current_exception(); }
+        }
+    };
+}
+
+vector<ParallelExtractor::Packet> ParallelExtractor::extract(uint8_t const* data, size_t size) const
+{
+    return extract(toBuffers(data, size));
+}
+
+vector<ParallelExtractor::Packet> ParallelExtractor::extract(vector<struct iovec> const& buffers) const
+{
+    Input input(buffers);
+    size_t const size = input.size;
+
+    // There is no point in segments smaller than a packet
+    size_t segment_count = std::min(m_thread_count, size / m_driver.MAX_PACKET_SIZE + 1);
+    if (segment_count <= 1)
+        return extractSequential(buffers);
+
+    vector<size_t> bounds(segment_count + 1);
+    for (size_t i = 0; i <= segment_count; ++i)
+        bounds[i] = size * i / segment_count;
+
+    vector<Scan> scans(segment_count);
+    vector<boost::exception_ptr> errors(segment_count);
+    boost::thread_group threads;
+    for (size_t i = 0; i < segment_count; ++i)
+    {
+        CaptureException task;
+        task.function = boost::bind(&ParallelExtractor::scanSegment, this,
+                &input, bounds[i], bounds[i + 1], &scans[i]);
+        task.error = &errors[i];
+        threads.create_thread(task);
+    }
+    threads.join_all();
+    for (size_t i = 0; i < segment_count; ++i)
+    {
+        if (errors[i])
+            boost::rethrow_exception(errors[i]);
+    }
+
+    // Merge. 'entry' is the position at which the sequential scan enters
+    // the current segment
+    vector<Packet> result;
+    size_t entry = 0;
+    for (size_t i = 0; i < segment_count; ++i)
+    {
+        Scan const& segment = scans[i];
+        size_t end = bounds[i + 1];
+        if (entry >= end)
+            continue;
+
+        // Scan sequentially until we reach a position the segment's scan
+        // went through
+        Scan resync;
+        resync.finished = false;
+        size_t position = scan(input, entry, end, resync, 0, &segment);
+        result.insert(result.end(), resync.packets.begin(), resync.packets.end());
+        if (resync.finished)
+            return result;
+        else if (position >= end)
+        {
+            entry = position;
+            continue;
+        }
+
+        vector<Packet>::const_iterator first = std::lower_bound(
+                segment.packets.begin(), segment.packets.end(), position, PacketOffsetLess());
+        result.insert(result.end(), first, segment.packets.end());
+        if (segment.finished)
+            return result;
+        entry = segment.exit;
+    }
+    return result;
+}
@@ -0,0 +1,19 @@
+#include <ros_driver_base/probes.hpp>
+
+#ifdef ROS_DRIVER_BASE_HAVE_SDT
+// The semaphores of the probes, set by the tracers. They must be in the
+// .probes section for the tracers to find them
+#define ROS_DRIVER_BASE_DEFINE_SEMAPHORE(name) \
+    unsigned short ROS_DRIVER_BASE_PROBE_SEMAPHORE(name) __attribute__((section(".probes"))) = 0;
+
+extern "C"
+{
+    ROS_DRIVER_BASE_DEFINE_SEMAPHORE(read)
+    ROS_DRIVER_BASE_DEFINE_SEMAPHORE(extract)
+    ROS_DRIVER_BASE_DEFINE_SEMAPHORE(packet)
+    ROS_DRIVER_BASE_DEFINE_SEMAPHORE(write)
+    ROS_DRIVER_BASE_DEFINE_SEMAPHORE(timeout)
+    ROS_DRIVER_BASE_DEFINE_SEMAPHORE(wait_start)
+    ROS_DRIVER_BASE_DEFINE_SEMAPHORE(wait_done)
+}
+#endif
@@ -0,0 +1,234 @@
+#include <ros_driver_base/pty_device.hpp>
+#include <ros_driver_base/driver.hpp>
+#include <ros_driver_base/exceptions.hpp>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread/locks.hpp>
+
+using namespace std;
+using namespace ros_driver_base;
+
+/** Longest time the device thread waits before checking for stop() */
+static const int64_t MAX_WAIT = 10000000;
+/** After a pause longer than this, streaming restarts from the current time
+ * instead of catching up
+ */
+static const int64_t MAX_STREAMING_DELAY = 1000000000;
+
+/** The device paces real I/O, so it stays on the system's monotonic clock
+ * even when another Clock is installed
+ */
+static int64_t monotonicNow()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<int64_t>(now.tv_sec) * 1000000000LL + now.tv_nsec;
+}
+
+PtyDevice::PtyDevice()
+    : m_master(-1)
+    , m_slave(-1)
+    , m_byte_rate(0)
+    , m_chunk_size(0)
+    , m_pattern_offset(0)
+    , m_stop(false)
+    , m_sent_bytes(0)
+    , m_dropped_bytes(0)
+    , m_received_bytes(0)
+    , m_reply_count(0)
+{
+    FileGuard master(posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK));
+    if (master.get() == -1)
+        throw UnixError("PtyDevice: cannot create a pseudo-terminal");
+    if (grantpt(master.get()) == -1 || unlockpt(master.get()) == -1)
+        throw UnixError("PtyDevice: cannot unlock the pseudo-terminal");
+    char const* path = ptsname(master.get());
+    if (!path)
+        throw UnixError("PtyDevice: cannot get the pseudo-terminal's slave path");
+    m_slave_path = path;
+
+    FileGuard slave(::open(path, O_RDWR | O_NOCTTY));
+    if (slave.get() == -1)
+        throw UnixError("PtyDevice: cannot open " + m_slave_path);
+
+    // Until a driver configures the port, do not let the line discipline
+    // echo or translate what the device sends
+    struct termios tio;
+    if (tcgetattr(slave.get(), &tio) == -1)
+        throw UnixError("PtyDevice: cannot get the attributes of " + m_slave_path);
+    cfmakeraw(&tio);
+    if (tcsetattr(slave.get(), TCSANOW, &tio) == -1)
+        throw UnixError("PtyDevice: cannot set the attributes of " + m_slave_path);
+
+    m_master = master.release();
+    m_slave = slave.release();
+}
+
+PtyDevice::~PtyDevice()
+{
+    stop();
+    ::close(m_slave);
+    ::close(m_master);
+}
+
+string PtyDevice::getSlavePath() const
+{
+    return m_slave_path;
+}
+
+string PtyDevice::getURI(int baud_rate) const
+{
+    return "serial://" + m_slave_path + ":" + boost::lexical_cast<string>(baud_rate);
+}
+
+void PtyDevice::setStreaming(vector<uint8_t> const& pattern, double byte_rate, size_t chunk_size)
+{
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    m_pattern = pattern;
+    m_byte_rate = byte_rate;
+    m_chunk_size = chunk_size ? chunk_size : pattern.size();
+    m_pattern_offset = 0;
+}
+
+void PtyDevice::addReply(vector<uint8_t> const& request, vector<uint8_t> const& reply)
+{
+    if (request.empty())
+        throw std::invalid_argument("PtyDevice: empty request");
+
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    Reply entry = { request, reply };
+    m_replies.push_back(entry);
+}
+
+void PtyDevice::start()
+{
+    stop();
+    m_stop.store(false);
+    m_thread = boost::thread(&PtyDevice::run, this);
+}
+
+void PtyDevice::stop()
+{
+    m_stop.store(true);
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+uint64_t PtyDevice::getSentBytes() const { return m_sent_bytes.load(); }
+uint64_t PtyDevice::getDroppedBytes() const { return m_dropped_bytes.load(); }
+uint64_t PtyDevice::getReceivedBytes() const { return m_received_bytes.load(); }
+uint64_t PtyDevice::getReplyCount() const { return m_reply_count.load(); }
+
+void PtyDevice::send(uint8_t const* data, size_t size)
+{
+    ssize_t c = ::write(m_master, data, size);
+    if (c == -1 && errno != EAGAIN)
+        throw UnixError("PtyDevice: cannot write on the pseudo-terminal");
+    size_t written = std::max<ssize_t>(c, 0);
+    m_sent_bytes.fetch_add(written);
+    m_dropped_bytes.fetch_add(size - written);
+}
+
+size_t PtyDevice::sendChunk()
+{
+    vector<uint8_t> chunk(m_chunk_size);
+    for (size_t i = 0; i < m_chunk_size; ++i)
+    {
+        chunk[i] = m_pattern[m_pattern_offset];
+        m_pattern_offset = (m_pattern_offset + 1) % m_pattern.size();
+    }
+    send(&chunk[0], chunk.size());
+    return chunk.size();
+}
+
+void PtyDevice::processReceived()
+{
+    size_t max_request_size = 0;
+    while (true)
+    {
+        // Answer the request found first in the received data
+        vector<uint8_t>::iterator first_match = m_received.end();
+        Reply const* match = 0;
+        for (size_t i = 0; i < m_replies.size(); ++i)
+        {
+            Reply const& reply = m_replies[i];
+            max_request_size = std::max(max_request_size, reply.request.size());
+            vector<uint8_t>::iterator it = std::search(m_received.begin(), first_match,
+                    reply.request.begin(), reply.request.end());
+            if (it != first_match)
+            {
+                first_match = it;
+                match = &reply;
+            }
+        }
+        if (!match)
+            break;
+
+        m_received.erase(m_received.begin(), first_match + match->request.size());
+        if (!match->reply.empty())
+            send(&match->reply[0], match->reply.size());
+        m_reply_count.fetch_add(1);
+    }
+
+    // Only keep what could be the start of a request
+    if (m_received.size() >= max_request_size)
+        m_received.erase(m_received.begin(), m_received.end() - (max_request_size ? max_request_size - 1 : 0));
+}
+
+void PtyDevice::run()
+{
+    try
+    {
+        int64_t next_chunk = monotonicNow();
+        uint8_t buffer[4096];
+        while (!m_stop.load())
+        {
+            int64_t now = monotonicNow();
+            int64_t wait = MAX_WAIT;
+            {
+                boost::lock_guard<boost::mutex> lock(m_mutex);
+                if (m_byte_rate > 0 && !m_pattern.empty())
+                {
+                    if (now - next_chunk > MAX_STREAMING_DELAY)
+                        next_chunk = now;
+                    while (next_chunk <= now)
+                        next_chunk += sendChunk() * 1e9 / m_byte_rate;
+                    wait = std::min(wait, next_chunk - now);
+                }
+                else
+                    next_chunk = now;
+            }
+
+            pollfd fd = { m_master, POLLIN, 0 };
+            timespec timeout = { static_cast<time_t>(wait / 1000000000), static_cast<long>(wait % 1000000000) };
+            int ret = ppoll(&fd, 1, &timeout, NULL);
+            if (ret == -1 && errno != EINTR)
+                throw UnixError("PtyDevice: error while waiting on the pseudo-terminal");
+            else if (ret <= 0 || !(fd.revents & POLLIN))
+                continue;
+
+            ssize_t c = ::read(m_master, buffer, sizeof(buffer));
+            if (c <= 0)
+                continue;
+            m_received_bytes.fetch_add(c);
+
+            boost::lock_guard<boost::mutex> lock(m_mutex);
+            m_received.insert(m_received.end(), buffer, buffer + c);
+            processReceived();
+        }
+    }
+    catch(std::exception const& e)
+    {
+        std::cerr << e.what() << ", stopping the device" << std::endl;
+    }
+}
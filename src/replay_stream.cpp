@@ -0,0 +1,326 @@
+#include <ros_driver_base/replay_stream.hpp>
+#include <ros_driver_base/exceptions.hpp>
+#include <ros_driver_base/timeout.hpp>
+#include <ros_driver_base/clock.hpp>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+using namespace ros_driver_base;
+
+static const uint32_t SECTION_HEADER_BLOCK = 0x0A0D0D0A;
+static const uint32_t INTERFACE_DESCRIPTION_BLOCK = 1;
+static const uint32_t ENHANCED_PACKET_BLOCK = 6;
+static const uint32_t BYTE_ORDER_MAGIC = 0x1A2B3C4D;
+static const uint16_t OPT_ENDOFOPT = 0;
+static const uint16_t OPT_IF_TSRESOL = 9;
+static const uint16_t OPT_EPB_FLAGS = 2;
+static const uint32_t EPB_DIRECTION_MASK = 3;
+static const uint32_t EPB_FLAG_OUTBOUND = 2;
+
+template<typename T>
+static T get(uint8_t const* data)
+{
+    T value;
+    memcpy(&value, data, sizeof(T));
+    return value;
+}
+
+static size_t pad4(size_t size)
+{
+    return (size + 3) & ~size_t(3);
+}
+
+/** Returns the value of the given option in the [begin, end) option list,
+ * or NULL if it is not there
+ */
+static uint8_t const* findOption(uint8_t const* begin, uint8_t const* end, uint16_t code)
+{
+    while (begin + 4 <= end)
+    {
+        uint16_t option = get<uint16_t>(begin);
+        uint16_t length = get<uint16_t>(begin + 2);
+        if (option == OPT_ENDOFOPT)
+            return 0;
+        if (begin + 4 + length > end)
+            return 0;
+        if (option == code)
+            return begin + 4;
+        begin += 4 + pad4(length);
+    }
+    return 0;
+}
+
+/** Converts a timestamp to nanoseconds given a pcapng if_tsresol value */
+static int64_t toNanoseconds(uint64_t timestamp, uint8_t resolution)
+{
+    if (resolution & 0x80)
+    {
+        int shift = resolution & 0x7F;
+        uint64_t mask = (uint64_t(1) << shift) - 1;
+        return (timestamp >> shift) * 1000000000LL
+            + (((timestamp & mask) * 1000000000ULL) >> shift);
+    }
+
+    int64_t result = timestamp;
+    for (int i = resolution; i < 9; ++i)
+        result *= 10;
+    for (int i = 9; i < resolution; ++i)
+        result /= 10;
+    return result;
+}
+
+ReplayStream::ReplayStream(std::string const& path, double speed, unsigned int stream)
+    : m_fd(-1)
+    , m_map(0)
+    , m_map_size(0)
+    , m_speed(speed)
+    , m_position(0)
+    , m_chunk_offset(0)
+    , m_started(false)
+    , m_base_time(0)
+    , m_base_chunk(0)
+{
+    if (speed < 0)
+        throw std::invalid_argument("ReplayStream: the speed cannot be negative");
+
+    m_fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (m_fd == -1)
+        throw UnixError("ReplayStream: cannot open " + path);
+
+    struct stat info;
+    if (fstat(m_fd, &info) == -1)
+    {
+        ::close(m_fd);
+        throw UnixError("ReplayStream: cannot stat " + path);
+    }
+
+    m_map_size = info.st_size;
+    if (m_map_size)
+    {
+        void* map = mmap(0, m_map_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+        if (map == MAP_FAILED)
+        {
+            ::close(m_fd);
+            throw UnixError("ReplayStream: cannot map " + path);
+        }
+        m_map = static_cast<uint8_t const*>(map);
+    }
+
+    try { index(stream); }
+    catch(...)
+    {
+        if (m_map)
+            munmap(const_cast<uint8_t*>(m_map), m_map_size);
+        ::close(m_fd);
+        throw;
+    }
+}
+
+ReplayStream::~ReplayStream()
+{
+    if (m_map)
+        munmap(const_cast<uint8_t*>(m_map), m_map_size);
+    ::close(m_fd);
+}
+
+void ReplayStream::index(unsigned int stream)
+{
+    // if_tsresol of each interface of the current section
+    vector<uint8_t> resolutions;
+    int64_t last_time = 0;
+    size_t offset = 0;
+    while (offset + 12 <= m_map_size)
+    {
+        uint8_t const* block = m_map + offset;
+        uint32_t type = get<uint32_t>(block);
+        uint32_t length = get<uint32_t>(block + 4);
+        // A capture that was not closed properly still has its zeroed
+        // preallocation after the last block
+        if (type == 0 && length == 0)
+            break;
+        if (length < 12 || length % 4 || offset + length > m_map_size)
+            throw std::runtime_error("ReplayStream: invalid pcapng block");
+        uint8_t const* end = block + length - 4;
+
+        if (type == SECTION_HEADER_BLOCK)
+        {
+            if (get<uint32_t>(block + 8) != BYTE_ORDER_MAGIC)
+                throw std::runtime_error("ReplayStream: only pcapng files of the host's byte order are supported");
+            resolutions.clear();
+        }
+        else if (type == INTERFACE_DESCRIPTION_BLOCK && length >= 20)
+        {
+            uint8_t const* option = findOption(block + 16, end, OPT_IF_TSRESOL);
+            resolutions.push_back(option ? *option : 6);
+        }
+        else if (type == ENHANCED_PACKET_BLOCK && length >= 32)
+        {
+            uint32_t interface = get<uint32_t>(block + 8);
+            uint32_t captured = get<uint32_t>(block + 20);
+            if (28 + pad4(captured) + 4 > length)
+                throw std::runtime_error("ReplayStream: invalid pcapng packet block");
+
+            uint8_t const* flags = findOption(block + 28 + pad4(captured), end, OPT_EPB_FLAGS);
+            bool outbound = flags &&
+                ((get<uint32_t>(flags) & EPB_DIRECTION_MASK) == EPB_FLAG_OUTBOUND);
+            if (interface == stream && interface < resolutions.size() && !outbound && captured)
+            {
+                uint64_t timestamp = (uint64_t(get<uint32_t>(block + 12)) << 32) | get<uint32_t>(block + 16);
+                // keep the index sorted even if the wall clock stepped back
+                // during the capture
+                last_time = std::max(last_time, toNanoseconds(timestamp, resolutions[interface]));
+
+                Chunk chunk;
+                chunk.time = last_time;
+                chunk.offset = offset + 28;
+                chunk.size = captured;
+                m_chunks.push_back(chunk);
+            }
+        }
+        offset += length;
+    }
+}
+
+int64_t ReplayStream::getAvailabilityTime()
+{
+    if (!m_started)
+    {
+        m_started = true;
+        m_base_time = Deadline::now();
+        m_base_chunk = m_position;
+    }
+    if (m_speed == 0 || m_position == m_chunks.size())
+        return m_base_time;
+
+    int64_t offset = m_chunks[m_position].time - m_chunks[m_base_chunk].time;
+    return m_base_time + static_cast<int64_t>(offset / m_speed);
+}
+
+void ReplayStream::waitRead(ros::Duration const& timeout)
+{
+    if (!isFinished())
+    {
+        int64_t available = getAvailabilityTime();
+        if (available - Deadline::now() <= timeout.toNSec())
+        {
+            Clock::waitUntil(available);
+            return;
+        }
+    }
+
+    Clock::waitUntil(Deadline::now() + timeout.toNSec());
+    throw TimeoutError(TimeoutError::NONE, "waitRead(): timeout");
+}
+
+void ReplayStream::waitWrite(ros::Duration const&)
+{
+}
+
+size_t ReplayStream::read(uint8_t* buffer, size_t buffer_size)
+{
+    if (isFinished() || getAvailabilityTime() > Deadline::now())
+        return 0;
+
+    Chunk const& chunk = m_chunks[m_position];
+    size_t size = std::min(buffer_size, chunk.size - m_chunk_offset);
+    memcpy(buffer, m_map + chunk.offset + m_chunk_offset, size);
+    m_chunk_offset += size;
+    if (m_chunk_offset == chunk.size)
+    {
+        ++m_position;
+        m_chunk_offset = 0;
+    }
+    return size;
+}
+
+size_t ReplayStream::write(uint8_t const*, size_t buffer_size)
+{
+    return buffer_size;
+}
+
+void ReplayStream::clear()
+{
+    int64_t now = Deadline::now();
+    while (!isFinished() && getAvailabilityTime() <= now)
+    {
+        ++m_position;
+        m_chunk_offset = 0;
+    }
+}
+
+size_t ReplayStream::getChunkCount() const
+{
+    return m_chunks.size();
+}
+
+size_t ReplayStream::getPosition() const
+{
+    return m_position;
+}
+
+bool ReplayStream::isFinished() const
+{
+    return m_position == m_chunks.size();
+}
+
+ros::Time ReplayStream::getStartTime() const
+{
+    ros::Time time;
+    if (!m_chunks.empty())
+        time.fromNSec(m_chunks.front().time);
+    return time;
+}
+
+ros::Time ReplayStream::getEndTime() const
+{
+    ros::Time time;
+    if (!m_chunks.empty())
+        time.fromNSec(m_chunks.back().time);
+    return time;
+}
+
+void ReplayStream::seek(ros::Time const& time)
+{
+    Chunk key;
+    key.time = time.toNSec();
+    seekToChunk(std::lower_bound(m_chunks.begin(), m_chunks.end(), key) - m_chunks.begin());
+}
+
+void ReplayStream::seekToChunk(size_t index)
+{
+    if (index > m_chunks.size())
+        throw std::out_of_range("ReplayStream: chunk index out of range");
+    m_position = index;
+    m_chunk_offset = 0;
+    m_started = false;
+}
+
+std::vector<uint8_t> ReplayStream::getData() const
+{
+    size_t size = 0;
+    for (size_t i = 0; i < m_chunks.size(); ++i)
+        size += m_chunks[i].size;
+
+    std::vector<uint8_t> data;
+    data.reserve(size);
+    for (size_t i = 0; i < m_chunks.size(); ++i)
+        data.insert(data.end(), m_map + m_chunks[i].offset, m_map + m_chunks[i].offset + m_chunks[i].size);
+    return data;
+}
+
+std::vector<struct iovec> ReplayStream::getBuffers() const
+{
+    std::vector<struct iovec> buffers(m_chunks.size());
+    for (size_t i = 0; i < m_chunks.size(); ++i)
+    {
+        buffers[i].iov_base = const_cast<uint8_t*>(m_map + m_chunks[i].offset);
+        buffers[i].iov_len = m_chunks[i].size;
+    }
+    return buffers;
+}
@@ -0,0 +1,207 @@
+// Serial port specific parts of Driver
+//
+// On Linux, this uses the termios2 interface to set arbitrary baud rates.
+// <asm/termbits.h> conflicts with glibc's <termios.h>, which is why this code
+// lives in its own compilation unit.
+
+#include <ros_driver_base/driver.hpp>
+#include <ros_driver_base/exceptions.hpp>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <iostream>
+
+#ifdef __gnu_linux__
+#include <asm/termbits.h>
+#include <sys/ioctl.h>
+#include <linux/serial.h>
+#else
+#include <termios.h>
+#endif
+
+#ifdef __APPLE__
+#ifndef B460800
+#define B460800 460800
+#define B576000 576000
+#define B921600 921600
+#endif
+#endif
+
+using namespace std;
+using namespace ros_driver_base;
+
+#ifdef __gnu_linux__
+bool Driver::setSerialBaudrate(int fd, int brate) {
+    // BOTHER makes the kernel use c_ispeed/c_ospeed as-is, which works for
+    // both the standard and the non-standard rates. The kernel maps it back to
+    // the matching Bxxx constant when there is one.
+    struct termios2 tio;
+    if (ioctl(fd, TCGETS2, &tio)) {
+        perror("Failed to get terminal info \n");
+        return false;
+    }
+
+    tio.c_cflag &= ~CBAUD;
+    tio.c_cflag |= BOTHER;
+    tio.c_cflag &= ~(CBAUD << IBSHIFT);
+    tio.c_cflag |= BOTHER << IBSHIFT;
+    tio.c_ispeed = brate;
+    tio.c_ospeed = brate;
+    if (ioctl(fd, TCSETS2, &tio)) {
+        perror("Failed to set speed \n");
+        return false;
+    }
+
+    // Check what the hardware actually gave us
+    if (ioctl(fd, TCGETS2, &tio)) {
+        perror("Failed to get terminal info \n");
+        return false;
+    }
+    int actual = tio.c_ospeed;
+    if (actual < brate * 98 / 100 || actual > brate * 102 / 100)
+    {
+        std::cerr << "Cannot set serial rate to " << brate
+            << ". The closest possible value is " << actual << "."
+            << std::endl;
+    }
+    return true;
+}
+
+int Driver::getSerialBaudrate(int fd)
+{
+    struct termios2 tio;
+    if (ioctl(fd, TCGETS2, &tio))
+        throw UnixError("cannot get the baud rate of the serial port");
+    return tio.c_ospeed;
+}
+
+bool Driver::setSerialLowLatency(int fd, bool enable)
+{
+    struct serial_struct ss;
+    if (ioctl(fd, TIOCGSERIAL, &ss))
+        return false;
+
+    if (enable)
+        ss.flags |= ASYNC_LOW_LATENCY;
+    else
+        ss.flags &= ~ASYNC_LOW_LATENCY;
+    // A custom divisor left by a previous user would override the rate set
+    // with BOTHER on the drivers that still honor it
+    ss.flags &= ~ASYNC_SPD_MASK;
+    return ioctl(fd, TIOCSSERIAL, &ss) == 0;
+}
+
+void Driver::setSerialLatencyTimer(std::string const& port, int latency_ms)
+{
+    char resolved[PATH_MAX];
+    if (!realpath(port.c_str(), resolved))
+        throw UnixError("cannot resolve device path " + port);
+
+    string device(resolved);
+    string::size_type slash = device.find_last_of("/");
+    if (slash != string::npos)
+        device = device.substr(slash + 1);
+
+    string path = "/sys/bus/usb-serial/devices/" + device + "/latency_timer";
+    ofstream file(path.c_str());
+    if (!file)
+        throw UnixError("cannot open " + path + " to set the latency timer of " + port);
+    file << latency_ms << std::endl;
+    if (!file)
+        throw UnixError("cannot write the latency timer of " + port);
+}
+
+#else
+
+bool Driver::setSerialBaudrate(int fd, int brate) {
+    int tc_rate = 0;
+    switch(brate) {
+	case(SERIAL_1200):
+	    tc_rate = B1200;
+	    break;
+	case(SERIAL_2400):
+	    tc_rate = B2400;
+	    break;
+	case(SERIAL_4800):
+	    tc_rate = B4800;
+	    break;
+        case(SERIAL_9600):
+            tc_rate = B9600;
+            break;
+        case(SERIAL_19200):
+            tc_rate = B19200;
+            break;
+        case(SERIAL_38400):
+            tc_rate = B38400;
+            break;
+        case(SERIAL_57600):
+            tc_rate = B57600;
+            break;
+        case(SERIAL_115200):
+            tc_rate = B115200;
+            break;
+        case(SERIAL_230400):
+            tc_rate = B230400;
+            break;
+        case(SERIAL_460800):
+            tc_rate = B460800;
+            break;
+        case(SERIAL_576000):
+            tc_rate = B576000;
+            break;
+        case(SERIAL_921600):
+            tc_rate = B921600;
+            break;
+        default:
+            std::cerr << "Non-standard baud rate selected. This is only supported on linux." << std::endl;
+            return false;
+    }
+
+    struct termios termios_p;
+    if(tcgetattr(fd, &termios_p)){
+        perror("Failed to get terminal info \n");
+        return false;
+    }
+
+    if(cfsetispeed(&termios_p, tc_rate)){
+        perror("Failed to set terminal input speed \n");
+        return false;
+    }
+
+    if(cfsetospeed(&termios_p, tc_rate)){
+        perror("Failed to set terminal output speed \n");
+        return false;
+    }
+
+    if(tcsetattr(fd, TCSANOW, &termios_p)) {
+        perror("Failed to set speed \n");
+        return false;
+    }
+    return true;
+}
+
+int Driver::getSerialBaudrate(int fd)
+{
+    // On the non-Linux systems we support (OSX, BSDs), speed_t is the rate
+    struct termios termios_p;
+    if (tcgetattr(fd, &termios_p))
+        throw UnixError("cannot get the baud rate of the serial port");
+    return cfgetospeed(&termios_p);
+}
+
+bool Driver::setSerialLowLatency(int fd, bool enable)
+{
+    return false;
+}
+
+void Driver::setSerialLatencyTimer(std::string const& port, int latency_ms)
+{
+    throw UnixError("setting the latency timer is only supported on Linux", ENOTSUP);
+}
+
+#endif
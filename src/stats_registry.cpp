@@ -0,0 +1,302 @@
+#include <ros_driver_base/stats_registry.hpp>
+#include <ros_driver_base/driver.hpp>
+#include <ros_driver_base/exceptions.hpp>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <boost/thread/locks.hpp>
+
+using namespace std;
+using namespace ros_driver_base;
+using namespace ros_driver_base::stats_page;
+
+static const int MAX_READ_ATTEMPTS = 1000000;
+
+static string shmName(string const& name)
+{
+    if (!name.empty() && name[0] == '/')
+        return name;
+    return "/" + name;
+}
+
+/** True if the segment is a statistics page whose owner does not exist
+ * anymore, i.e. which got left over by a process that crashed
+ */
+static bool isStalePage(string const& name)
+{
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd == -1)
+        return errno == ENOENT;
+    FileGuard guard(fd);
+
+    // Pages without the magic are either not statistics pages, or being
+    // initialized right now
+    Header header;
+    if (pread(fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)))
+        return false;
+    if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) || header.pid <= 0)
+        return false;
+    return kill(header.pid, 0) == -1 && errno == ESRCH;
+}
+
+static void summarize(HistogramSummary& summary, Histogram const& histogram)
+{
+    summary.count = histogram.getCount();
+    summary.min = histogram.getMin();
+    summary.max = histogram.getMax();
+    summary.mean = static_cast<uint64_t>(histogram.getMean() + 0.5);
+    summary.p50 = histogram.getPercentile(50);
+    summary.p90 = histogram.getPercentile(90);
+    summary.p99 = histogram.getPercentile(99);
+    summary.p999 = histogram.getPercentile(99.9);
+}
+
+StatsRegistry::StatsRegistry(string const& name, size_t slot_count, ros::Duration const& period)
+    : m_name(shmName(name))
+    , m_period(period)
+    , m_page(0)
+    , m_page_size(sizeof(Header) + slot_count * sizeof(Slot))
+    , m_slot_count(slot_count)
+    , m_drivers(slot_count)
+    , m_stop(false)
+{
+    int fd = shm_open(m_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd == -1 && errno == EEXIST)
+    {
+        if (!isStalePage(m_name))
+            throw UnixError("StatsRegistry: the shared memory segment " + m_name + " is in use", EEXIST);
+        shm_unlink(m_name.c_str());
+        fd = shm_open(m_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    }
+    if (fd == -1)
+        throw UnixError("StatsRegistry: cannot create the shared memory segment " + m_name);
+    FileGuard guard(fd);
+    if (ftruncate(fd, m_page_size) == -1)
+    {
+        shm_unlink(m_name.c_str());
+        throw UnixError("StatsRegistry: cannot resize the shared memory segment " + m_name);
+    }
+
+    void* map = mmap(NULL, m_page_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        shm_unlink(m_name.c_str());
+        throw UnixError("StatsRegistry: cannot map the shared memory segment " + m_name);
+    }
+    m_page = static_cast<uint8_t*>(map);
+
+    // The segment is zero-filled by ftruncate, so all slots are free. The
+    // magic is written last, readers check it to know the header is valid
+    Header* header = reinterpret_cast<Header*>(m_page);
+    header->version = VERSION;
+    header->header_size = sizeof(Header);
+    header->slot_size = sizeof(Slot);
+    header->slot_count = slot_count;
+    header->pid = getpid();
+    header->update_period = period.toNSec();
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(header->magic, MAGIC, sizeof(MAGIC));
+}
+
+StatsRegistry::~StatsRegistry()
+{
+    stop();
+    munmap(m_page, m_page_size);
+    shm_unlink(m_name.c_str());
+}
+
+string StatsRegistry::getName() const
+{
+    return m_name;
+}
+
+Slot& StatsRegistry::getSlot(size_t index)
+{
+    return reinterpret_cast<Slot*>(m_page + sizeof(Header))[index];
+}
+
+void StatsRegistry::add(Driver const& driver, string const& label)
+{
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    vector<Driver const*>::iterator it = std::find(m_drivers.begin(), m_drivers.end(), static_cast<Driver const*>(0));
+    if (it == m_drivers.end())
+        throw length_error("StatsRegistry: all slots are used");
+    *it = &driver;
+
+    size_t index = it - m_drivers.begin();
+    driver.getStatus(m_status);
+    Slot& slot = getSlot(index);
+    __atomic_store_n(&slot.sequence, slot.sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memset(slot.label, 0, LABEL_SIZE);
+    strncpy(slot.label, label.c_str(), LABEL_SIZE - 1);
+    __atomic_store_n(&slot.sequence, slot.sequence + 1, __ATOMIC_RELEASE);
+    writeSlot(index, m_status);
+}
+
+void StatsRegistry::remove(Driver const& driver)
+{
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    vector<Driver const*>::iterator it = std::find(m_drivers.begin(), m_drivers.end(), &driver);
+    if (it == m_drivers.end())
+        return;
+    *it = 0;
+
+    Slot& slot = getSlot(it - m_drivers.begin());
+    __atomic_store_n(&slot.sequence, slot.sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    slot.state = SLOT_FREE;
+    __atomic_store_n(&slot.sequence, slot.sequence + 1, __ATOMIC_RELEASE);
+}
+
+void StatsRegistry::writeSlot(size_t index, Status const& status)
+{
+    Slot& slot = getSlot(index);
+    __atomic_store_n(&slot.sequence, slot.sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    slot.state = SLOT_USED;
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    slot.update_time = static_cast<int64_t>(now.tv_sec) * 1000000000LL + now.tv_nsec;
+    slot.stamp = status.stamp.toNSec();
+    slot.tx = status.tx;
+    slot.good_rx = status.good_rx;
+    slot.bad_rx = status.bad_rx;
+    slot.queued_bytes = status.queued_bytes;
+    slot.read_calls = status.read_calls;
+    slot.empty_reads = status.empty_reads;
+    slot.write_calls = status.write_calls;
+    slot.partial_writes = status.partial_writes;
+    slot.wait_calls = status.wait_calls;
+    slot.spurious_wakeups = status.spurious_wakeups;
+    slot.extract_calls = status.extract_calls;
+    summarize(slot.packet_assembly_time, status.packet_assembly_time);
+    summarize(slot.read_wait_time, status.read_wait_time);
+    summarize(slot.write_time, status.write_time);
+    summarize(slot.packet_size, status.packet_size);
+
+    __atomic_store_n(&slot.sequence, slot.sequence + 1, __ATOMIC_RELEASE);
+}
+
+void StatsRegistry::update()
+{
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    for (size_t i = 0; i < m_slot_count; ++i)
+    {
+        if (!m_drivers[i])
+            continue;
+        m_drivers[i]->getStatus(m_status);
+        writeSlot(i, m_status);
+    }
+}
+
+void StatsRegistry::start()
+{
+    stop();
+    m_stop = false;
+    m_thread = boost::thread(&StatsRegistry::run, this);
+}
+
+void StatsRegistry::stop()
+{
+    {
+        boost::lock_guard<boost::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_stop_cond.notify_all();
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+void StatsRegistry::run()
+{
+    while (true)
+    {
+        update();
+
+        boost::unique_lock<boost::mutex> lock(m_mutex);
+        boost::system_time until = boost::get_system_time()
+            + boost::posix_time::microseconds(m_period.toNSec() / 1000);
+        while (!m_stop)
+        {
+            if (!m_stop_cond.timed_wait(lock, until))
+                break;
+        }
+        if (m_stop)
+            return;
+    }
+}
+
+StatsPageReader::StatsPageReader(string const& name)
+    : m_page(0)
+    , m_page_size(0)
+{
+    string shm_name = shmName(name);
+    int fd = shm_open(shm_name.c_str(), O_RDONLY, 0);
+    if (fd == -1)
+        throw UnixError("StatsPageReader: cannot open the shared memory segment " + shm_name);
+    FileGuard guard(fd);
+
+    struct stat info;
+    if (fstat(fd, &info) == -1)
+        throw UnixError("StatsPageReader: cannot stat the shared memory segment " + shm_name);
+    if (static_cast<size_t>(info.st_size) < sizeof(Header))
+        throw runtime_error("StatsPageReader: " + shm_name + " is not a statistics page");
+
+    void* map = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+        throw UnixError("StatsPageReader: cannot map the shared memory segment " + shm_name);
+    m_page = static_cast<uint8_t const*>(map);
+    m_page_size = info.st_size;
+
+    memcpy(&m_header, m_page, sizeof(Header));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (memcmp(m_header.magic, MAGIC, sizeof(MAGIC)) || m_header.version != VERSION
+            || m_header.slot_size < sizeof(Slot)
+            || m_header.header_size + static_cast<size_t>(m_header.slot_size) * m_header.slot_count > m_page_size)
+    {
+        munmap(const_cast<uint8_t*>(m_page), m_page_size);
+        throw runtime_error("StatsPageReader: " + shm_name + " is not a compatible statistics page");
+    }
+}
+
+StatsPageReader::~StatsPageReader()
+{
+    munmap(const_cast<uint8_t*>(m_page), m_page_size);
+}
+
+Header const& StatsPageReader::getHeader() const
+{
+    return m_header;
+}
+
+bool StatsPageReader::read(size_t index, Slot& slot) const
+{
+    if (index >= m_header.slot_count)
+        throw out_of_range("StatsPageReader: slot index out of range");
+
+    Slot const* shared = reinterpret_cast<Slot const*>(
+            m_page + m_header.header_size + index * m_header.slot_size);
+    // The owner process may have died in the middle of an update, do not
+    // wait forever for it
+    for (int attempt = 0; attempt < MAX_READ_ATTEMPTS; ++attempt)
+    {
+        uint32_t sequence = __atomic_load_n(&shared->sequence, __ATOMIC_ACQUIRE);
+        if (sequence & 1)
+            continue;
+        memcpy(&slot, shared, sizeof(Slot));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&shared->sequence, __ATOMIC_RELAXED) == sequence)
+            return slot.state == SLOT_USED;
+    }
+    throw runtime_error("StatsPageReader: slot is stuck in the middle of an update");
+}
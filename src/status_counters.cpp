@@ -0,0 +1,127 @@
+#include <ros_driver_base/status_counters.hpp>
+#include <ros_driver_base/clock.hpp>
+
+#include <algorithm>
+
+using namespace ros_driver_base;
+
+StatusCounters::Side::Side()
+    : sequence(0)
+    , depth(0)
+    , stamp(0)
+    , wait_calls(0)
+    , spurious_wakeups(0)
+{
+}
+
+StatusCounters::ReadSide::ReadSide()
+    : good_rx(0)
+    , bad_rx(0)
+    , queued_bytes(0)
+    , read_calls(0)
+    , empty_reads(0)
+    , extract_calls(0)
+{
+}
+
+StatusCounters::WriteSide::WriteSide()
+    : tx(0)
+    , write_calls(0)
+    , partial_writes(0)
+{
+}
+
+void StatusCounters::stamp(Side& side)
+{
+    side.stamp.store(Clock::wallTime().toNSec(), boost::memory_order_relaxed);
+}
+
+uint32_t StatusCounters::beginLoad(Side const& side)
+{
+    while (true)
+    {
+        uint32_t sequence = side.sequence.load(boost::memory_order_acquire);
+        if (!(sequence & 1))
+            return sequence;
+    }
+}
+
+bool StatusCounters::endLoad(Side const& side, uint32_t sequence)
+{
+    boost::atomic_thread_fence(boost::memory_order_acquire);
+    return side.sequence.load(boost::memory_order_relaxed) == sequence;
+}
+
+void StatusCounters::load(Status& status) const
+{
+    int64_t read_stamp, write_stamp;
+    uint64_t read_wait_calls, read_spurious_wakeups;
+    while (true)
+    {
+        uint32_t sequence = beginLoad(read);
+        read_stamp = read.stamp.load(boost::memory_order_relaxed);
+        read_wait_calls = read.wait_calls.load(boost::memory_order_relaxed);
+        read_spurious_wakeups = read.spurious_wakeups.load(boost::memory_order_relaxed);
+        status.good_rx = read.good_rx.load(boost::memory_order_relaxed);
+        status.bad_rx = read.bad_rx.load(boost::memory_order_relaxed);
+        status.queued_bytes = read.queued_bytes.load(boost::memory_order_relaxed);
+        status.read_calls = read.read_calls.load(boost::memory_order_relaxed);
+        status.empty_reads = read.empty_reads.load(boost::memory_order_relaxed);
+        status.extract_calls = read.extract_calls.load(boost::memory_order_relaxed);
+        status.packet_assembly_time.load(read.packet_assembly_time);
+        status.read_wait_time.load(read.read_wait_time);
+        status.packet_size.load(read.packet_size);
+        if (endLoad(read, sequence))
+            break;
+    }
+
+    while (true)
+    {
+        uint32_t sequence = beginLoad(write);
+        write_stamp = write.stamp.load(boost::memory_order_relaxed);
+        status.wait_calls = write.wait_calls.load(boost::memory_order_relaxed);
+        status.spurious_wakeups = write.spurious_wakeups.load(boost::memory_order_relaxed);
+        status.tx = write.tx.load(boost::memory_order_relaxed);
+        status.write_calls = write.write_calls.load(boost::memory_order_relaxed);
+        status.partial_writes = write.partial_writes.load(boost::memory_order_relaxed);
+        status.write_time.load(write.write_time);
+        if (endLoad(write, sequence))
+            break;
+    }
+
+    status.wait_calls += read_wait_calls;
+    status.spurious_wakeups += read_spurious_wakeups;
+    int64_t stamp = std::max(read_stamp, write_stamp);
+    status.stamp = stamp ? ros::Time().fromNSec(stamp) : ros::Time();
+}
+
+namespace
+{
+    void resetSide(StatusCounters::Side& side)
+    {
+        side.stamp.store(0);
+        side.wait_calls.store(0);
+        side.spurious_wakeups.store(0);
+    }
+}
+
+void StatusCounters::reset()
+{
+    Update read_update(read);
+    resetSide(read);
+    read.good_rx.store(0);
+    read.bad_rx.store(0);
+    read.read_calls.store(0);
+    read.empty_reads.store(0);
+    read.extract_calls.store(0);
+    read.packet_assembly_time.reset();
+    read.read_wait_time.reset();
+    read.packet_size.reset();
+
+    Update write_update(write);
+    resetSide(write);
+    write.tx.store(0);
+    write.write_calls.store(0);
+    write.partial_writes.store(0);
+    write.write_time.reset();
+}
@@ -3,14 +3,154 @@
 #include <cstring>
 #include <sstream>
 #include <iomanip>
+#include <algorithm>
+#include <stdexcept>
+#include <limits>
+#include <boost/random/uniform_int_distribution.hpp>
+#include <boost/random/uniform_real_distribution.hpp>
 
 using namespace std;
 using namespace ros_driver_base;
 
+size_t TestStream::Chunk::getArrivedSize(int64_t time) const
+{
+    if (time < first_byte_time)
+        return 0;
+    else if (!byte_time)
+        return data.size();
+    return min<int64_t>(data.size(), (time - first_byte_time) / byte_time + 1);
+}
+
+int64_t TestStream::getByteTime() const
+{
+    if (!link_enabled || !link.baud_rate)
+        return 0;
+    return 10000000000LL / link.baud_rate;
+}
+
+void TestStream::queueData(vector<uint8_t>& data, int64_t send_time)
+{
+    if (link_enabled && (link.drop_rate > 0 || link.corruption_rate > 0))
+    {
+        boost::random::uniform_real_distribution<double> draw(0, 1);
+        boost::random::uniform_int_distribution<int> bit(0, 7);
+        size_t kept = 0;
+        for (size_t i = 0; i < data.size(); ++i)
+        {
+            if (draw(link_generator) < link.drop_rate)
+                continue;
+            uint8_t byte = data[i];
+            if (draw(link_generator) < link.corruption_rate)
+                byte ^= 1 << bit(link_generator);
+            data[kept++] = byte;
+        }
+        data.resize(kept);
+    }
+    if (data.empty())
+        return;
+
+    to_driver.push_back(Chunk());
+    Chunk& chunk = to_driver.back();
+    chunk.data.swap(data);
+    chunk.first_byte_time = std::numeric_limits<int64_t>::min();
+    chunk.byte_time = 0;
+    to_driver_size += chunk.data.size();
+    if (!link_enabled)
+        return;
+
+    int64_t start = send_time + link.latency.toNSec();
+    if (link.jitter.toNSec() > 0)
+        start += boost::random::uniform_int_distribution<int64_t>(0, link.jitter.toNSec())(link_generator);
+    // The link transfers one chunk at a time
+    start = max(start, rx_end);
+    chunk.byte_time = getByteTime();
+    chunk.first_byte_time = start + chunk.byte_time;
+    rx_end = start + chunk.byte_time * chunk.data.size();
+}
+
 /** Push data to the driver */
 void TestStream::pushDataToDriver(vector<uint8_t> const& data)
 {
-    to_driver.insert(to_driver.end(), data.begin(), data.end());
+    vector<uint8_t> copy(data);
+    queueData(copy, clock.now());
+}
+
+void TestStream::pushDataToDriver(uint8_t const* data, size_t size)
+{
+    vector<uint8_t> copy(data, data + size);
+    queueData(copy, clock.now());
+}
+
+void TestStream::swapDataToDriver(vector<uint8_t>& data)
+{
+    queueData(data, clock.now());
+    data.clear();
+}
+
+size_t TestStream::getPendingDataSize() const
+{
+    return to_driver_size;
+}
+
+size_t TestStream::getAvailableDataSize() const
+{
+    int64_t now = clock.now();
+    size_t offset = to_driver_offset;
+    size_t result = 0;
+    for (deque<Chunk>::const_iterator it = to_driver.begin(); it != to_driver.end(); ++it)
+    {
+        size_t arrived = it->getArrivedSize(now);
+        result += arrived - offset;
+        if (arrived < it->data.size())
+            break;
+        offset = 0;
+    }
+    return result;
+}
+
+void TestStream::setLinkModel(LinkModel const& model)
+{
+    link_enabled = true;
+    link = model;
+    link_generator.seed(model.seed);
+}
+
+void TestStream::disableLinkModel()
+{
+    link_enabled = false;
+    for (deque<Chunk>::iterator it = to_driver.begin(); it != to_driver.end(); ++it)
+    {
+        it->first_byte_time = std::numeric_limits<int64_t>::min();
+        it->byte_time = 0;
+    }
+    rx_end = tx_end = clock.now();
+}
+
+VirtualClock& TestStream::getClock()
+{
+    return clock;
+}
+
+void TestStream::setFragmentation(Fragmentation mode, size_t max_size, uint32_t seed)
+{
+    if (mode != NO_FRAGMENTATION && !max_size)
+        throw std::invalid_argument("TestStream::setFragmentation: the maximum fragment size must be strictly positive");
+    fragmentation = mode;
+    max_fragment_size = max_size;
+    fragment_generator.seed(seed);
+}
+
+size_t TestStream::getNextFragmentSize()
+{
+    switch (fragmentation)
+    {
+    case FIXED_FRAGMENTS:
+        return max_fragment_size;
+    case RANDOM_FRAGMENTS:
+        return boost::random::uniform_int_distribution<size_t>(1, max_fragment_size)(fragment_generator);
+    default:
+        return to_driver_size;
+    }
 }
 
 /** Read all data that the device driver has written since the last
@@ -25,71 +165,301 @@ vector<uint8_t> TestStream::readDataFromDriver()
 
 void TestStream::waitRead(ros::Duration const& timeout)
 {
-    if (to_driver.empty())
-        throw TimeoutError(TimeoutError::NONE, "no data in to_device");
+    if (!link_enabled)
+    {
+        if (!to_driver_size)
+        {
+            clock.advance(timeout);
+            throw TimeoutError(TimeoutError::NONE, "no data in to_device");
+        }
+        return;
+    }
+
+    int64_t deadline = clock.now() + timeout.toNSec();
+    if (to_driver_size)
+    {
+        Chunk const& chunk = to_driver.front();
+        int64_t next_byte = chunk.first_byte_time + chunk.byte_time * to_driver_offset;
+        if (next_byte <= deadline)
+        {
+            clock.advanceTo(next_byte);
+            return;
+        }
+    }
+    clock.advanceTo(deadline);
+    throw TimeoutError(TimeoutError::NONE, "no data arrived on the simulated link");
 }
 void TestStream::waitWrite(ros::Duration const& timeout)
 {
 }
 
-void TestStream::EXPECT_REPLY(std::vector<uint8_t> const& expectation, std::vector<uint8_t> const& reply)
+static void printBytes(ostream& out, vector<uint8_t> const& bytes, vector<uint8_t> const& mask = vector<uint8_t>())
+{
+    for (size_t i = 0; i < bytes.size(); ++i)
+    {
+        uint8_t byte_mask = mask.empty() ? 0xFF : mask[i];
+        if (!byte_mask)
+            out << " ??";
+        else
+        {
+            out << " " << setfill('0') << setw(2) << hex << static_cast<int>(bytes[i]);
+            if (byte_mask != 0xFF)
+                out << "&" << setfill('0') << setw(2) << hex << static_cast<int>(byte_mask);
+        }
+    }
+}
+
+bool TestStream::Expectation::matches(size_t position, uint8_t byte) const
+{
+    if (position >= bytes.size())
+        return false;
+    uint8_t byte_mask = mask.empty() ? 0xFF : mask[position];
+    return ((byte ^ bytes[position]) & byte_mask) == 0;
+}
+
+void TestStream::addExpectation(vector<uint8_t> const& expectation, vector<uint8_t> const& mask,
+        vector<uint8_t> const& reply, bool ordered)
 {
     if(!mock_mode)
         throw MockContextException();
-    expectations.push_back(expectation);
-    replies.push_back(reply);
+    if (expectation.empty())
+        throw std::invalid_argument("ROS_DRIVER_BASE_MOCK: empty expectation");
+    if (!mask.empty() && mask.size() != expectation.size())
+        throw std::invalid_argument("ROS_DRIVER_BASE_MOCK: the mask and the expectation have different sizes");
+
+    if (ordered || expectations.empty() || expectations.back().ordered)
+    {
+        expectations.push_back(ExpectationSet());
+        expectations.back().ordered = ordered;
+        expectations.back().size = 0;
+    }
+    ExpectationSet& set = expectations.back();
+
+    Expectation entry;
+    entry.bytes = expectation;
+    entry.reply = reply;
+    entry.index = expectation_count++;
+    if (std::count(mask.begin(), mask.end(), 0xFF) != static_cast<int>(mask.size()))
+        entry.mask = mask;
+
+    ExpectationNode* node = &set.root;
+    for (size_t i = 0; i < expectation.size() && (entry.mask.empty() || entry.mask[i] == 0xFF); ++i)
+    {
+        boost::shared_ptr<ExpectationNode>& child = node->children[expectation[i]];
+        if (!child)
+        {
+            child.reset(new ExpectationNode);
+            child->parent = node;
+            child->byte = expectation[i];
+        }
+        node = child.get();
+    }
+    node->expectations.push_back(entry);
+    ++set.size;
+}
+
+void TestStream::EXPECT_REPLY(std::vector<uint8_t> const& expectation, std::vector<uint8_t> const& reply)
+{
+    addExpectation(expectation, vector<uint8_t>(), reply, true);
 }
 
+void TestStream::EXPECT_REPLY(std::vector<uint8_t> const& expectation,
+        std::vector<uint8_t> const& mask,
+        std::vector<uint8_t> const& reply)
+{
+    addExpectation(expectation, mask, reply, true);
+}
 
-size_t TestStream::read(uint8_t* buffer, size_t buffer_size)
+void TestStream::EXPECT_UNORDERED_REPLY(std::vector<uint8_t> const& expectation, std::vector<uint8_t> const& reply)
 {
-    size_t read_size = min(to_driver.size(), buffer_size);
-    std::memcpy(buffer, to_driver.data(), read_size);
-    to_driver.erase(to_driver.begin(), to_driver.begin() + read_size);
-    return read_size;
+    addExpectation(expectation, vector<uint8_t>(), reply, false);
 }
 
-size_t TestStream::write(uint8_t const* buffer, size_t buffer_size)
+void TestStream::EXPECT_UNORDERED_REPLY(std::vector<uint8_t> const& expectation,
+        std::vector<uint8_t> const& mask,
+        std::vector<uint8_t> const& reply)
 {
-    if(mock_mode)
+    addExpectation(expectation, mask, reply, false);
+}
+
+void TestStream::matchByte(uint8_t byte)
+{
+    size_t position = from_driver.size();
+    from_driver.push_back(byte);
+    if(expectations.empty())
     {
-        from_driver.insert(from_driver.end(), buffer, buffer + buffer_size);
-        if(expectations.empty())
+        std::stringstream msg;
+        msg << "Message received, but there are no expectations left:\n";
+        printBytes(msg, from_driver);
+        throw std::runtime_error(msg.str());
+    }
+
+    ExpectationSet& set = expectations.front();
+    if (position == 0)
+    {
+        // The expectations of the root have a masked first byte
+        candidates.clear();
+        expectation_node = &set.root;
+        for (ExpectationList::iterator it = set.root.expectations.begin(); it != set.root.expectations.end(); ++it)
+            candidates.push_back(Candidate(&set.root, it));
+    }
+
+    ExpectationNode* next_node = 0;
+    if (expectation_node)
+    {
+        map< uint8_t, boost::shared_ptr<ExpectationNode> >::const_iterator child =
+            expectation_node->children.find(byte);
+        if (child != expectation_node->children.end())
+            next_node = child->second.get();
+    }
+
+    size_t kept = 0;
+    Candidate complete(0, ExpectationList::iterator());
+    for (size_t i = 0; i < candidates.size(); ++i)
+    {
+        Expectation const& candidate = *candidates[i].second;
+        if (!candidate.matches(position, byte))
+            continue;
+        if (candidate.bytes.size() == position + 1 &&
+                (!complete.first || candidate.index < complete.second->index))
+            complete = candidates[i];
+        if (i != kept)
+            candidates[kept] = candidates[i];
+        ++kept;
+    }
+    if (!kept && !next_node)
+        reportMismatch(position);
+    candidates.resize(kept);
+
+    // The expectations stored in the new node match all the received
+    // bytes. They are either complete, or get compared byte by byte from
+    // now on
+    expectation_node = next_node;
+    if (next_node)
+    {
+        for (ExpectationList::iterator it = next_node->expectations.begin(); it != next_node->expectations.end(); ++it)
         {
-            std::stringstream msg;
-            msg << "Message received, but there are no expectations left:\n";
-            for (std::vector<uint8_t>::const_iterator it = from_driver.begin(); it != from_driver.end(); ++it)
-                msg << " " << setfill('0') << setw(2) << hex << static_cast<int>(*it);
-            throw std::runtime_error(msg.str());
+            if (it->bytes.size() != position + 1)
+                candidates.push_back(Candidate(next_node, it));
+            else if (!complete.first || it->index < complete.second->index)
+                complete = Candidate(next_node, it);
         }
+    }
+    if (!complete.first)
+        return;
 
-        if(from_driver == expectations.front())
+    vector<uint8_t> reply;
+    reply.swap(complete.second->reply);
+    ExpectationNode* node = complete.first;
+    node->expectations.erase(complete.second);
+    while (node->parent && node->expectations.empty() && node->children.empty())
+    {
+        ExpectationNode* parent = node->parent;
+        parent->children.erase(node->byte);
+        node = parent;
+    }
+    if (!--set.size)
+        expectations.pop_front();
+
+    candidates.clear();
+    expectation_node = 0;
+    from_driver.clear();
+    queueData(reply, link_enabled ? tx_end : clock.now());
+}
+
+void TestStream::collectExpectations(ExpectationNode const& node, vector<Expectation const*>& result)
+{
+    for (ExpectationList::const_iterator it = node.expectations.begin(); it != node.expectations.end(); ++it)
+        result.push_back(&*it);
+    for (map< uint8_t, boost::shared_ptr<ExpectationNode> >::const_iterator it = node.children.begin(); it != node.children.end(); ++it)
+        collectExpectations(*it->second, result);
+}
+
+bool TestStream::isSetBefore(Expectation const* a, Expectation const* b)
+{
+    return a->index < b->index;
+}
+
+void TestStream::reportMismatch(size_t position)
+{
+    std::stringstream msg;
+    msg << "ROS_DRIVER_BASE_MOCK failure at byte " << position;
+
+    // Report the expectations that matched until the bad byte, i.e. the
+    // candidates and the expectations below the current node. Those of the
+    // node itself are already candidates
+    vector<Expectation const*> expected;
+    for (size_t i = 0; i < candidates.size(); ++i)
+        expected.push_back(&*candidates[i].second);
+    if (expectation_node)
+    {
+        for (map< uint8_t, boost::shared_ptr<ExpectationNode> >::const_iterator it = expectation_node->children.begin();
+                it != expectation_node->children.end(); ++it)
+            collectExpectations(*it->second, expected);
+    }
+    std::sort(expected.begin(), expected.end(), isSetBefore);
+
+    size_t const MAX_REPORTED = 10;
+    msg << (expected.size() > 1 ? "\nExpected one of" : "\nExpected");
+    for (size_t i = 0; i < min(expected.size(), MAX_REPORTED); ++i)
+    {
+        msg << "\n ";
+        printBytes(msg, expected[i]->bytes, expected[i]->mask);
+    }
+    if (expected.size() > MAX_REPORTED)
+        msg << "\n  ... and " << dec << expected.size() - MAX_REPORTED << " more";
+    msg << "\nBut got ";
+    printBytes(msg, from_driver);
+
+    clearExpectations();
+    from_driver.clear();
+    throw std::invalid_argument(msg.str());
+}
+
+size_t TestStream::read(uint8_t* buffer, size_t buffer_size)
+{
+    if (!to_driver_size || !buffer_size)
+        return 0;
+
+    int64_t now = clock.now();
+    size_t max_size = min(min(to_driver_size, buffer_size), getNextFragmentSize());
+    size_t copied = 0;
+    while (copied < max_size)
+    {
+        Chunk& chunk = to_driver.front();
+        size_t arrived = chunk.getArrivedSize(now);
+        size_t size = min(arrived - to_driver_offset, max_size - copied);
+        std::memcpy(buffer + copied, &chunk.data[to_driver_offset], size);
+        copied += size;
+        to_driver_offset += size;
+        if (to_driver_offset == chunk.data.size())
         {
-            to_driver.insert(to_driver.end(), replies.front().begin(), replies.front().end());
-            from_driver.clear();
-            expectations.pop_front();
-            replies.pop_front();
+            to_driver.pop_front();
+            to_driver_offset = 0;
         }
-        else
+        else if (to_driver_offset == arrived)
+            break;
+    }
+    to_driver_size -= copied;
+    return copied;
+}
+
+size_t TestStream::write(uint8_t const* buffer, size_t buffer_size)
+{
+    int64_t byte_time = getByteTime();
+    tx_end = max(tx_end, clock.now());
+    if(mock_mode)
+    {
+        for (size_t i = 0; i < buffer_size; ++i)
         {
-            std::vector<uint8_t> const& expected = expectations.front();
-            std::stringstream msg;
-            msg << "ROS_DRIVER_BASE_MOCK failure";
-            msg << "\nExpected";
-            for (std::vector<uint8_t>::const_iterator it = expected.begin(); it != expected.end(); ++it)
-                msg << " " << setfill('0') << setw(2) << hex << static_cast<int>(*it);
-            msg << "\nBut got ";
-            for (std::vector<uint8_t>::const_iterator it = from_driver.begin(); it != from_driver.end(); ++it)
-                msg << " " << setfill('0') << setw(2) << hex << static_cast<int>(*it);
-
-            expectations.clear();
-            replies.clear();
-            throw std::invalid_argument(msg.str());
+            tx_end += byte_time;
+            matchByte(buffer[i]);
         }
         return buffer_size;
     }
     else
     {
+        tx_end += byte_time * buffer_size;
         from_driver.insert(from_driver.end(), buffer, buffer + buffer_size);
         return buffer_size;
     }
@@ -98,12 +468,16 @@ size_t TestStream::write(uint8_t const* buffer, size_t buffer_size)
 void TestStream::clear()
 {
     to_driver.clear();
+    to_driver_offset = 0;
+    to_driver_size = 0;
+    rx_end = clock.now();
 }
 
 void TestStream::clearExpectations()
 {
     expectations.clear();
-    replies.clear();
+    candidates.clear();
+    expectation_node = 0;
 }
 
 
@@ -1,14 +1,49 @@
 #include <ros_driver_base/timeout.hpp>
+#include <ros_driver_base/clock.hpp>
+#include <time.h>
 
 using namespace ros_driver_base;
 
+int64_t Deadline::now()
+{
+    Clock* clock = Clock::getCurrent();
+    if (clock)
+        return clock->now();
+
+    timespec current_time;
+    clock_gettime(CLOCK_MONOTONIC, &current_time);
+    return static_cast<int64_t>(current_time.tv_sec) * 1000000000LL
+        + current_time.tv_nsec;
+}
+
+Deadline::Deadline(ros::Duration const& timeout)
+    : deadline(now() + timeout.toNSec()) {}
+
+bool Deadline::elapsed() const
+{
+    return now() >= deadline;
+}
+
+ros::Duration Deadline::timeLeft() const
+{
+    ros::Duration left;
+    int64_t remaining = deadline - now();
+    if (remaining > 0)
+        left.fromNSec(remaining);
+    return left;
+}
+
+int64_t Deadline::toNSec() const
+{
+    return deadline;
+}
+
 Timeout::Timeout(unsigned int timeout)
-    : timeout(timeout) {
-    gettimeofday(&start_time, 0);
+    : timeout(timeout), start_time(Deadline::now()) {
 }
 
 void Timeout::restart() {
-    gettimeofday(&start_time, 0);
+    start_time = Deadline::now();
 }
 
 bool Timeout::elapsed() const
@@ -18,12 +53,7 @@ bool Timeout::elapsed() const
 
 bool Timeout::elapsed(unsigned int timeout) const
 {
-    timeval current_time;
-    gettimeofday(&current_time, 0);
-    unsigned int elapsed =
-	(current_time.tv_sec - start_time.tv_sec) * 1000
-	+ (static_cast<int>(current_time.tv_usec) -
-	   static_cast<int>(start_time.tv_usec)) / 1000;
+    int64_t elapsed = (Deadline::now() - start_time) / 1000000;
     return timeout < elapsed;
 }
 
@@ -34,16 +64,8 @@ unsigned int Timeout::timeLeft() const
 
 unsigned int Timeout::timeLeft(unsigned int timeout) const
 {
-    timeval current_time;
-    gettimeofday(&current_time, 0);
-    int elapsed =
-	(current_time.tv_sec - start_time.tv_sec) * 1000
-	+ (static_cast<int>(current_time.tv_usec) -
-	   static_cast<int>(start_time.tv_usec)) / 1000;
-    if ((int)timeout < elapsed)
+    int64_t elapsed = (Deadline::now() - start_time) / 1000000;
+    if (timeout < elapsed)
 	return 0;
     return timeout - elapsed;
 }
-
-
-
@@ -0,0 +1,36 @@
+#include <ros_driver_base/virtual_clock.hpp>
+
+using namespace ros_driver_base;
+
+VirtualClock::VirtualClock(int64_t time)
+    : m_time(time) {}
+
+int64_t VirtualClock::now() const
+{
+    return m_time.load(boost::memory_order_acquire);
+}
+
+ros::Time VirtualClock::getWallTime() const
+{
+    ros::Time time;
+    time.fromNSec(now());
+    return time;
+}
+
+void VirtualClock::sleepUntil(int64_t time)
+{
+    advanceTo(time);
+}
+
+void VirtualClock::advance(ros::Duration const& duration)
+{
+    if (duration.toNSec() > 0)
+        m_time.fetch_add(duration.toNSec(), boost::memory_order_acq_rel);
+}
+
+void VirtualClock::advanceTo(int64_t time)
+{
+    int64_t current = m_time.load(boost::memory_order_acquire);
+    while (current < time &&
+            !m_time.compare_exchange_weak(current, time, boost::memory_order_acq_rel));
+}
@@ -0,0 +1,141 @@
+#include <boost/test/unit_test.hpp>
+
+#include <ros_driver_base/async_listener.hpp>
+#include <ros_driver_base/driver.hpp>
+#include "test_helpers.hpp"
+#include <ros_driver_base/test_stream.hpp>
+#include <unistd.h>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+using namespace std;
+using namespace ros_driver_base;
+
+BOOST_AUTO_TEST_SUITE(AsyncListenerSuite)
+
+BOOST_AUTO_TEST_CASE(it_dispatches_the_data_according_to_the_direction_filters)
+{
+    // The listeners must outlive the driver, which deletes the AsyncListener
+    BufferListener both, write_only;
+    RawDriver driver;
+    driver.openTestMode();
+    TestStream* stream = dynamic_cast<TestStream*>(driver.getMainStream());
+
+    AsyncListener* async = new AsyncListener(16, 4);
+    async->addListener(&both);
+    async->addListener(&write_only, AsyncListener::WRITE);
+    async->start();
+    driver.addListener(async);
+
+    uint8_t packet[10] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+    driver.writePacket(packet, 10);
+    stream->pushDataToDriver(vector<uint8_t>(packet, packet + 3));
+    uint8_t buffer[100];
+    driver.readPacket(buffer, 100);
+
+    BOOST_REQUIRE(async->flush(ros::Duration(1)));
+    BOOST_REQUIRE(both.flushWrite() == vector<uint8_t>(packet, packet + 10));
+    BOOST_REQUIRE(both.flushRead() == vector<uint8_t>(packet, packet + 3));
+    BOOST_REQUIRE(write_only.flushWrite() == vector<uint8_t>(packet, packet + 10));
+    BOOST_REQUIRE(write_only.flushRead().empty());
+    BOOST_REQUIRE_EQUAL(10, async->getListenerStatistics(&write_only).received_bytes);
+}
+
+/** A listener that blocks in writeData until it is released */
+struct BlockingListener : public BufferListener
+{
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    bool entered;
+    bool released;
+
+    BlockingListener() : entered(false), released(false) {}
+    void writeData(boost::uint8_t const* data, size_t size)
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        entered = true;
+        cond.notify_all();
+        while (!released)
+            cond.wait(lock);
+        BufferListener::writeData(data, size);
+    }
+    void waitEntered()
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        while (!entered)
+            cond.timed_wait(lock, boost::posix_time::seconds(1));
+    }
+    void release()
+    {
+        boost::lock_guard<boost::mutex> lock(mutex);
+        released = true;
+        cond.notify_all();
+    }
+};
+
+bool waitReceived(AsyncListener& async, IOListener* listener, uint64_t bytes)
+{
+    for (int i = 0; i < 1000; ++i)
+    {
+        if (async.getListenerStatistics(listener).received_bytes >= bytes)
+            return true;
+        usleep(1000);
+    }
+    return false;
+}
+
+BOOST_AUTO_TEST_CASE(a_slow_listener_does_not_hold_back_the_others)
+{
+    BlockingListener slow;
+    BufferListener fast;
+    AsyncListener async(4, 4);
+    async.addListener(&slow);
+    async.addListener(&fast);
+    async.start();
+
+    uint8_t data[16] = { 0 };
+    async.writeData(data, 4);
+    slow.waitEntered();
+    BOOST_REQUIRE(waitReceived(async, &fast, 4));
+
+    // The slow listener still holds one chunk, so only three of these four
+    // fit in its queue. The fast one gets them all
+    async.writeData(data, 16);
+    BOOST_REQUIRE(waitReceived(async, &fast, 20));
+    BOOST_REQUIRE_EQUAL(0, async.getListenerStatistics(&fast).dropped_bytes);
+    BOOST_REQUIRE_EQUAL(4, async.getListenerStatistics(&slow).dropped_bytes);
+    BOOST_REQUIRE_EQUAL(0, async.getListenerStatistics(&slow).received_bytes);
+
+    slow.release();
+    BOOST_REQUIRE(async.flush(ros::Duration(1)));
+    BOOST_REQUIRE_EQUAL(16, slow.flushWrite().size());
+    BOOST_REQUIRE_EQUAL(20, fast.flushWrite().size());
+
+    AsyncListener::Statistics stats = async.getStatistics();
+    BOOST_REQUIRE_EQUAL(1, stats.dropped_chunks);
+    BOOST_REQUIRE_EQUAL(4, stats.dropped_bytes);
+}
+
+BOOST_AUTO_TEST_CASE(it_drops_and_accounts_the_data_that_does_not_fit)
+{
+    AsyncListener async(2, 4);
+    BufferListener read_only, write_only;
+    async.addListener(&read_only, AsyncListener::READ);
+    async.addListener(&write_only, AsyncListener::WRITE);
+
+    uint8_t data[20] = { 0 };
+    async.writeData(data, 20);
+    AsyncListener::Statistics stats = async.getStatistics();
+    BOOST_REQUIRE_EQUAL(2, stats.queued_chunks);
+    BOOST_REQUIRE_EQUAL(3, stats.dropped_chunks);
+    BOOST_REQUIRE_EQUAL(12, stats.dropped_bytes);
+    BOOST_REQUIRE_EQUAL(12, async.getListenerStatistics(&write_only).dropped_bytes);
+    BOOST_REQUIRE_EQUAL(0, async.getListenerStatistics(&read_only).dropped_bytes);
+
+    async.start();
+    BOOST_REQUIRE(async.flush(ros::Duration(1)));
+    BOOST_REQUIRE_EQUAL(8, write_only.flushWrite().size());
+    BOOST_REQUIRE_EQUAL(12, async.getListenerStatistics(&write_only).dropped_bytes);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,129 @@
+#include <boost/test/unit_test.hpp>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdexcept>
+#include <ros_driver_base/driver.hpp>
+#include "test_helpers.hpp"
+#include <ros_driver_base/async_reader.hpp>
+
+using namespace std;
+using namespace ros_driver_base;
+
+BOOST_AUTO_TEST_SUITE(AsyncReaderSuite)
+
+struct PipeFixture : ReadPipeFixture<FourBytesDriver>
+{
+    void writePackets(int count)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            uint8_t packet[4] = { static_cast<uint8_t>(i), 0, 0, 0 };
+            BOOST_REQUIRE_EQUAL(4, write(tx, packet, 4));
+            // Make sure each packet is read on its own
+            usleep(2000);
+        }
+    }
+
+    void waitProcessed(AsyncReader& reader, uint64_t count)
+    {
+        for (int i = 0; i < 1000; ++i)
+        {
+            if (reader.getReceivedPackets() + reader.getDroppedPackets() >= count)
+                return;
+            usleep(1000);
+        }
+        BOOST_FAIL("timed out waiting for the reader thread");
+    }
+};
+
+BOOST_FIXTURE_TEST_CASE(it_queues_packets_read_in_the_background, PipeFixture)
+{
+    AsyncReader reader(driver, 4);
+    reader.setPollPeriod(ros::Duration(0.01));
+    reader.start();
+    writePackets(3);
+    waitProcessed(reader, 3);
+    BOOST_REQUIRE_EQUAL(3, reader.getQueueSize());
+
+    uint8_t buffer[100];
+    ros::Time stamp;
+    for (int i = 0; i < 3; ++i)
+    {
+        BOOST_REQUIRE_EQUAL(4, reader.readPacket(buffer, 100, &stamp));
+        BOOST_REQUIRE_EQUAL(i, buffer[0]);
+        BOOST_REQUIRE(!stamp.isZero());
+    }
+    BOOST_REQUIRE_EQUAL(0, reader.readPacket(buffer, 100));
+    reader.stop();
+    BOOST_REQUIRE(!reader.isRunning());
+}
+
+BOOST_FIXTURE_TEST_CASE(it_drops_the_newest_packets_on_overflow, PipeFixture)
+{
+    AsyncReader reader(driver, 2, AsyncReader::DROP_NEWEST);
+    reader.setPollPeriod(ros::Duration(0.01));
+    reader.start();
+    writePackets(4);
+    waitProcessed(reader, 4);
+    BOOST_REQUIRE_EQUAL(2, reader.getDroppedPackets());
+
+    uint8_t buffer[100];
+    BOOST_REQUIRE_EQUAL(4, reader.readPacket(buffer, 100));
+    BOOST_REQUIRE_EQUAL(0, buffer[0]);
+    BOOST_REQUIRE_EQUAL(4, reader.readPacket(buffer, 100));
+    BOOST_REQUIRE_EQUAL(1, buffer[0]);
+    BOOST_REQUIRE_EQUAL(0, reader.readPacket(buffer, 100));
+}
+
+BOOST_FIXTURE_TEST_CASE(it_drops_the_oldest_packets_on_overflow, PipeFixture)
+{
+    AsyncReader reader(driver, 2, AsyncReader::DROP_OLDEST);
+    reader.setPollPeriod(ros::Duration(0.01));
+    reader.start();
+    writePackets(4);
+    waitProcessed(reader, 6);
+    BOOST_REQUIRE_EQUAL(2, reader.getDroppedPackets());
+
+    uint8_t buffer[100];
+    BOOST_REQUIRE_EQUAL(4, reader.readPacket(buffer, 100));
+    BOOST_REQUIRE_EQUAL(2, buffer[0]);
+    BOOST_REQUIRE_EQUAL(4, reader.readPacket(buffer, 100));
+    BOOST_REQUIRE_EQUAL(3, buffer[0]);
+    BOOST_REQUIRE_EQUAL(0, reader.readPacket(buffer, 100));
+}
+
+BOOST_FIXTURE_TEST_CASE(it_can_be_restarted_after_a_failure, PipeFixture)
+{
+    AsyncReader reader(driver, 4);
+    reader.setPollPeriod(ros::Duration(0.01));
+    reader.start();
+    driver.fail_next = true;
+    writePackets(1);
+    for (int i = 0; i < 1000 && reader.isRunning(); ++i)
+        usleep(1000);
+    BOOST_REQUIRE(!reader.isRunning());
+
+    uint8_t buffer[100];
+    BOOST_REQUIRE_THROW(reader.readPacket(buffer, 100), std::runtime_error);
+
+    reader.start();
+    BOOST_REQUIRE(reader.isRunning());
+    writePackets(1);
+    waitProcessed(reader, 1);
+    BOOST_REQUIRE_EQUAL(4, reader.readPacket(buffer, 100));
+    reader.stop();
+}
+
+BOOST_FIXTURE_TEST_CASE(it_rejects_buffers_smaller_than_the_max_packet_size, PipeFixture)
+{
+    AsyncReader reader(driver, 4);
+    reader.setPollPeriod(ros::Duration(0.01));
+    reader.start();
+    uint8_t buffer[2];
+    BOOST_REQUIRE_THROW(reader.readPacket(buffer, 2), std::length_error);
+    reader.stop();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,139 @@
+#include <boost/test/unit_test.hpp>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <ros_driver_base/driver.hpp>
+#include "test_helpers.hpp"
+#include <ros_driver_base/async_writer.hpp>
+#include <ros_driver_base/io_stream.hpp>
+#include <stdexcept>
+
+using namespace std;
+using namespace ros_driver_base;
+
+BOOST_AUTO_TEST_SUITE(AsyncWriterSuite)
+
+struct WriteOnlyDriver : public Driver
+{
+    WriteOnlyDriver() : Driver(100) {}
+    int extractPacket(uint8_t const* buffer, size_t buffer_size) const
+    {
+        return -buffer_size;
+    }
+};
+
+struct PipeFixture : WritePipeFixture<WriteOnlyDriver>
+{
+    string readFromDevice(size_t size)
+    {
+        string result;
+        for (int i = 0; i < 1000 && result.size() < size; ++i)
+        {
+            char buffer[100];
+            int c = read(rx, buffer, size - result.size());
+            if (c > 0)
+                result += string(buffer, c);
+            else
+                usleep(1000);
+        }
+        return result;
+    }
+};
+
+bool queue(AsyncWriter& writer, string const& packet,
+        AsyncWriter::Priority priority = AsyncWriter::NORMAL)
+{
+    return writer.writePacket(reinterpret_cast<uint8_t const*>(packet.c_str()),
+            packet.size(), priority);
+}
+
+BOOST_FIXTURE_TEST_CASE(it_writes_queued_packets_in_order, PipeFixture)
+{
+    AsyncWriter writer(driver, 8);
+    writer.start();
+    BOOST_REQUIRE(queue(writer, "abc"));
+    BOOST_REQUIRE(queue(writer, "def"));
+    BOOST_REQUIRE_EQUAL("abcdef", readFromDevice(6));
+    writer.stop();
+
+    AsyncWriter::Statistics stats = writer.getStatistics();
+    BOOST_REQUIRE_EQUAL(2, stats.written_packets);
+    BOOST_REQUIRE_EQUAL(0, stats.queued_packets);
+    BOOST_REQUIRE(stats.max_latency >= stats.mean_latency);
+    BOOST_REQUIRE_EQUAL(6, driver.getStatus().tx);
+}
+
+BOOST_FIXTURE_TEST_CASE(it_coalesces_packets_and_sends_urgent_ones_first, PipeFixture)
+{
+    AsyncWriter writer(driver, 8);
+    BOOST_REQUIRE(queue(writer, "abc"));
+    BOOST_REQUIRE(queue(writer, "def"));
+    BOOST_REQUIRE(queue(writer, "!", AsyncWriter::URGENT));
+    writer.start();
+    BOOST_REQUIRE_EQUAL("!abcdef", readFromDevice(7));
+    writer.stop();
+
+    AsyncWriter::Statistics stats = writer.getStatistics();
+    BOOST_REQUIRE_EQUAL(3, stats.written_packets);
+    BOOST_REQUIRE_EQUAL(1, stats.write_calls);
+}
+
+BOOST_FIXTURE_TEST_CASE(it_drops_packets_when_the_queue_is_full, PipeFixture)
+{
+    AsyncWriter writer(driver, 2);
+    BOOST_REQUIRE(queue(writer, "a"));
+    BOOST_REQUIRE(queue(writer, "b"));
+    BOOST_REQUIRE(!queue(writer, "c"));
+    BOOST_REQUIRE_EQUAL(1, writer.getStatistics().dropped_packets);
+    BOOST_REQUIRE_THROW(queue(writer, string(101, 'x')), std::length_error);
+}
+
+/** A pipe whose next write fails */
+struct FailingStream : public FDStream
+{
+    bool fail_next;
+
+    FailingStream(int fd) : FDStream(fd, true), fail_next(false) {}
+    size_t writev(struct iovec const* iov, int iovcnt)
+    {
+        if (fail_next)
+        {
+            fail_next = false;
+            throw std::runtime_error("write failed");
+        }
+        return FDStream::writev(iov, iovcnt);
+    }
+};
+
+BOOST_FIXTURE_TEST_CASE(it_can_be_restarted_after_a_failure, PipeFixture)
+{
+    // The pipe's O_NONBLOCK flag is shared with the duplicate
+    FailingStream* stream = new FailingStream(dup(driver.getFileDescriptor()));
+    driver.setMainStream(stream);
+
+    // More packets than a batch holds, so that some are still queued when
+    // the first batch fails
+    AsyncWriter writer(driver, 100);
+    for (int i = 0; i < 70; ++i)
+        BOOST_REQUIRE(queue(writer, "a"));
+    stream->fail_next = true;
+    writer.start();
+    for (int i = 0; i < 1000 && writer.isRunning(); ++i)
+        usleep(1000);
+    BOOST_REQUIRE(!writer.isRunning());
+    BOOST_REQUIRE_THROW(queue(writer, "b"), std::runtime_error);
+
+    writer.start();
+    BOOST_REQUIRE(writer.isRunning());
+    BOOST_REQUIRE(queue(writer, "cd"));
+    BOOST_REQUIRE_EQUAL("cd", readFromDevice(2));
+    writer.stop();
+
+    AsyncWriter::Statistics stats = writer.getStatistics();
+    BOOST_REQUIRE_EQUAL(70, stats.failed_packets);
+    BOOST_REQUIRE_EQUAL(1, stats.written_packets);
+    BOOST_REQUIRE_EQUAL(0, stats.queued_packets);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
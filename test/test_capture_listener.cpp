@@ -0,0 +1,156 @@
+#include <boost/test/unit_test.hpp>
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <fstream>
+#include <iterator>
+#include <ros_driver_base/capture_listener.hpp>
+#include <ros_driver_base/driver.hpp>
+#include <boost/scoped_ptr.hpp>
+#include "test_helpers.hpp"
+
+using namespace std;
+using namespace ros_driver_base;
+
+BOOST_AUTO_TEST_SUITE(CaptureListenerSuite)
+
+struct TempDir
+{
+    string path;
+    TempDir()
+    {
+        char tmpl[] = "/tmp/ros_driver_base_capture.XXXXXX";
+        BOOST_REQUIRE(mkdtemp(tmpl));
+        path = tmpl;
+    }
+    ~TempDir()
+    {
+        BOOST_CHECK(system(("rm -rf " + path).c_str()) == 0);
+    }
+
+    bool exists(string const& name)
+    {
+        return access((path + "/" + name).c_str(), F_OK) == 0;
+    }
+
+    /** Waits for the helper thread to create or delete a file */
+    bool waitExists(string const& name, bool expected)
+    {
+        for (int i = 0; i < 1000; ++i)
+        {
+            if (exists(name) == expected)
+                return true;
+            usleep(1000);
+        }
+        return false;
+    }
+
+    vector<uint8_t> readFile(string const& name)
+    {
+        ifstream file((path + "/" + name).c_str(), ios::binary);
+        return vector<uint8_t>(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+    }
+};
+
+uint32_t get32(vector<uint8_t> const& data, size_t offset)
+{
+    uint32_t value;
+    memcpy(&value, &data[offset], 4);
+    return value;
+}
+
+BOOST_FIXTURE_TEST_CASE(it_writes_the_chunks_as_pcapng_packet_blocks, TempDir)
+{
+    CaptureListener capture(path + "/capture", 1 << 20, 2);
+    uint8_t data[5] = { 1, 2, 3, 4, 5 };
+    capture.writeData(data, 5);
+    boost::scoped_ptr<IOListener> stream(capture.getStream(1));
+    stream->readData(data, 3);
+    capture.close();
+
+    vector<uint8_t> file = readFile("capture.0.pcapng");
+    // section header, two interfaces, a 5-byte and a 3-byte chunk
+    BOOST_REQUIRE_EQUAL(28 + 2 * 32 + (44 + 8) + (44 + 4), file.size());
+    BOOST_REQUIRE_EQUAL(0x0A0D0D0A, get32(file, 0));
+    BOOST_REQUIRE_EQUAL(1, get32(file, 28));
+
+    size_t block = 28 + 2 * 32;
+    BOOST_REQUIRE_EQUAL(6, get32(file, block));
+    BOOST_REQUIRE_EQUAL(0, get32(file, block + 8));
+    BOOST_REQUIRE_EQUAL(5, get32(file, block + 20));
+    BOOST_REQUIRE( !memcmp(data, &file[block + 28], 5) );
+    BOOST_REQUIRE_EQUAL(2, get32(file, block + 40)); // outbound
+
+    block += 52;
+    BOOST_REQUIRE_EQUAL(1, get32(file, block + 8));
+    BOOST_REQUIRE_EQUAL(3, get32(file, block + 20));
+    BOOST_REQUIRE_EQUAL(1, get32(file, block + 36)); // inbound
+}
+
+BOOST_FIXTURE_TEST_CASE(the_drivers_own_the_listener_and_its_streams, TempDir)
+{
+    CaptureListener* capture = new CaptureListener(path + "/capture", 1 << 20, 2);
+    BOOST_REQUIRE_THROW(capture->getStream(2), std::out_of_range);
+
+    uint8_t data[5] = { 1, 2, 3, 4, 5 };
+    {
+        RawDriver driver1;
+        driver1.openTestMode();
+        {
+            RawDriver driver0;
+            driver0.openTestMode();
+            driver0.addListener(capture);
+            driver1.addListener(capture->getStream(1));
+            driver0.writePacket(data, 5);
+        }
+        // driver0 deleted the listener, the stream keeps recording
+        driver1.writePacket(data, 3);
+        BOOST_REQUIRE(exists("capture.0.pcapng"));
+    }
+
+    // The last owner closed the files
+    BOOST_REQUIRE(!exists("capture.1.pcapng"));
+    vector<uint8_t> file = readFile("capture.0.pcapng");
+    BOOST_REQUIRE_EQUAL(28 + 2 * 32 + (44 + 8) + (44 + 4), file.size());
+    size_t block = 28 + 2 * 32;
+    BOOST_REQUIRE_EQUAL(0, get32(file, block + 8));
+    BOOST_REQUIRE_EQUAL(1, get32(file, block + 52 + 8));
+    BOOST_REQUIRE_EQUAL(3, get32(file, block + 52 + 20));
+}
+
+BOOST_FIXTURE_TEST_CASE(it_rolls_over_to_new_files, TempDir)
+{
+    CaptureListener capture(path + "/capture", 200, 1, CaptureListener::LINKTYPE_USER0, 64);
+    capture.setMaxFiles(2);
+    uint8_t data[64] = { 0 };
+    for (int i = 0; i < 4; ++i)
+        capture.readData(data, 64);
+
+    BOOST_REQUIRE_EQUAL(4, capture.getFileCount());
+    BOOST_REQUIRE_EQUAL(4, capture.getRecordedChunks());
+    BOOST_REQUIRE_EQUAL(path + "/capture.3.pcapng", capture.getCurrentPath());
+    BOOST_REQUIRE(waitExists("capture.1.pcapng", false));
+    BOOST_REQUIRE(exists("capture.2.pcapng"));
+}
+
+BOOST_FIXTURE_TEST_CASE(it_prepares_the_next_file_in_the_background, TempDir)
+{
+    CaptureListener capture(path + "/capture", 200, 1, CaptureListener::LINKTYPE_USER0, 64);
+    BOOST_REQUIRE(waitExists("capture.1.pcapng", true));
+    BOOST_REQUIRE_EQUAL(1, capture.getFileCount());
+
+    uint8_t data[64] = { 0 };
+    capture.readData(data, 64);
+    capture.readData(data, 64);
+    BOOST_REQUIRE_EQUAL(2, capture.getFileCount());
+    BOOST_REQUIRE(waitExists("capture.2.pcapng", true));
+    capture.close();
+
+    // The full file is truncated, and the unused one deleted
+    BOOST_REQUIRE_EQUAL(28 + 32 + 44 + 64, readFile("capture.0.pcapng").size());
+    BOOST_REQUIRE_EQUAL(28 + 32 + 44 + 64, readFile("capture.1.pcapng").size());
+    BOOST_REQUIRE(!exists("capture.2.pcapng"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
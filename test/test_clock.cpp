@@ -0,0 +1,80 @@
+#include <boost/test/unit_test.hpp>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <ros_driver_base/driver.hpp>
+#include "test_helpers.hpp"
+#include <ros_driver_base/timeout.hpp>
+#include <ros_driver_base/virtual_clock.hpp>
+#include <ros_driver_base/fixture_boost_test.hpp>
+
+using namespace std;
+using namespace ros_driver_base;
+
+BOOST_AUTO_TEST_SUITE(ClockSuite)
+
+BOOST_AUTO_TEST_CASE(test_timeouts_follow_the_installed_clock)
+{
+    VirtualClock clock(1000000000);
+    {
+        ScopedClock scoped(clock);
+        BOOST_REQUIRE_EQUAL(1000000000, Deadline::now());
+
+        Deadline deadline(ros::Duration(0.01));
+        Timeout timeout(10);
+        BOOST_REQUIRE(!deadline.elapsed());
+        clock.advance(ros::Duration(0.005));
+        BOOST_REQUIRE_EQUAL(5000000, deadline.timeLeft().toNSec());
+        BOOST_REQUIRE_EQUAL(5, timeout.timeLeft());
+        clock.advanceTo(1000000000);
+        BOOST_REQUIRE_EQUAL(1005000000, Deadline::now());
+        clock.advance(ros::Duration(0.006));
+        BOOST_REQUIRE(deadline.elapsed());
+        BOOST_REQUIRE(timeout.elapsed());
+        BOOST_REQUIRE_EQUAL(1011000000, Clock::wallTime().toNSec());
+    }
+    BOOST_REQUIRE(!Clock::getCurrent());
+}
+
+BOOST_FIXTURE_TEST_CASE(test_packet_timeout_on_a_slow_link, Fixture<ZeroHeaderDriver>)
+{
+    useVirtualClock();
+    LinkModel link;
+    link.baud_rate = 1000;
+    getStream()->setLinkModel(link);
+    int64_t start = getClock().now();
+
+    uint8_t packet[] = { 0, 1, 2, 3 };
+    pushDataToDriver(packet, packet + 4);
+    try
+    {
+        driver.readPacket(&packetBuffer[0], packetBuffer.size(), ros::Duration(0.025), ros::Duration(0.1));
+        BOOST_FAIL("readPacket did not time out");
+    }
+    catch(TimeoutError const& e)
+    {
+        BOOST_REQUIRE_EQUAL(TimeoutError::PACKET, e.type);
+    }
+    BOOST_REQUIRE_EQUAL(25000000, getClock().now() - start);
+
+    BOOST_REQUIRE_EQUAL(4, driver.readPacket(&packetBuffer[0], packetBuffer.size(), ros::Duration(0.025)));
+    BOOST_REQUIRE_EQUAL(40000000, getClock().now() - start);
+    BOOST_REQUIRE_EQUAL(getClock().now(), driver.getStatus().stamp.toNSec());
+}
+
+BOOST_AUTO_TEST_CASE(test_file_descriptor_timeouts_advance_the_installed_clock)
+{
+    int pair[2];
+    BOOST_REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0);
+    FileGuard peer(pair[1]);
+    ZeroHeaderDriver driver;
+    driver.setFileDescriptor(pair[0]);
+
+    VirtualClock clock;
+    ScopedClock scoped(clock);
+    uint8_t buffer[100];
+    BOOST_REQUIRE_THROW(driver.readPacket(buffer, 100, ros::Duration(0.01)), TimeoutError);
+    BOOST_REQUIRE_GE(clock.now(), 10000000);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,136 @@
+#include <boost/test/unit_test.hpp>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <ros_driver_base/driver.hpp>
+#include "test_helpers.hpp"
+#include <ros_driver_base/io_scheduler.hpp>
+#include <ros_driver_base/coroutine.hpp>
+#include <ros_driver_base/timeout.hpp>
+
+// This file is only part of the test_Coroutine target, which is compiled
+// as C++20
+#if !defined(__cpp_impl_coroutine)
+#error "test_coroutine.cpp must be compiled with coroutine support"
+#endif
+
+using namespace std;
+using namespace ros_driver_base;
+
+BOOST_AUTO_TEST_SUITE(CoroutineSuite)
+
+struct DetachedTask
+{
+    struct promise_type
+    {
+        DetachedTask get_return_object() { return DetachedTask(); }
+        std::suspend_never initial_suspend() { return std::suspend_never(); }
+        std::suspend_never final_suspend() noexcept { return std::suspend_never(); }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+typedef ReadPipeFixture<ZeroTerminatedDriver> ReadFixture;
+
+DetachedTask readTwoPackets(Driver& driver, IOScheduler& scheduler, vector<int>& sizes)
+{
+    uint8_t buffer[100];
+    sizes.push_back(co_await co_readPacket(driver, scheduler, buffer, 100, ros::Duration(1)));
+    sizes.push_back(co_await co_readPacket(driver, scheduler, buffer, 100, ros::Duration(1)));
+    try { co_await co_readPacket(driver, scheduler, buffer, 100, ros::Duration(0.01)); }
+    catch(TimeoutError const&) { sizes.push_back(-1); }
+}
+
+BOOST_FIXTURE_TEST_CASE(co_readPacket_resumes_once_a_packet_is_extracted, ReadFixture)
+{
+    EpollScheduler scheduler;
+    vector<int> sizes;
+    readTwoPackets(driver, scheduler, sizes);
+    BOOST_REQUIRE(sizes.empty());
+
+    BOOST_REQUIRE_EQUAL(2, write(tx, "ab", 2));
+    scheduler.runOnce(ros::Duration(1));
+    BOOST_REQUIRE(sizes.empty());
+    BOOST_REQUIRE_EQUAL(4, write(tx, "c\0d\0", 4));
+    scheduler.run();
+
+    BOOST_REQUIRE_EQUAL(3, sizes.size());
+    BOOST_REQUIRE_EQUAL(4, sizes[0]);
+    BOOST_REQUIRE_EQUAL(2, sizes[1]);
+    BOOST_REQUIRE_EQUAL(-1, sizes[2]);
+}
+
+/** The driver writes in a pipe that is full until the test reads from it */
+struct WriteFixture : WritePipeFixture<ZeroTerminatedDriver>
+{
+    int filled;
+
+    WriteFixture()
+        : filled(0)
+    {
+        // The driver made its end non-blocking
+        char block[1024];
+        memset(block, 'x', sizeof(block));
+        int c;
+        while ((c = write(driver.getFileDescriptor(), block, sizeof(block))) > 0)
+            filled += c;
+    }
+
+    /** Reads everything written in the pipe so far */
+    vector<uint8_t> drain()
+    {
+        fcntl(rx, F_SETFL, fcntl(rx, F_GETFL) | O_NONBLOCK);
+        vector<uint8_t> result;
+        uint8_t buffer[1024];
+        int c;
+        while ((c = read(rx, buffer, sizeof(buffer))) > 0)
+            result.insert(result.end(), buffer, buffer + c);
+        return result;
+    }
+};
+
+DetachedTask writePacket(Driver& driver, IOScheduler& scheduler,
+        uint8_t const* packet, int size, ros::Duration timeout, int& result)
+{
+    try
+    {
+        co_await co_writePacket(driver, scheduler, packet, size, timeout);
+        result = 1;
+    }
+    catch(TimeoutError const&) { result = -1; }
+}
+
+BOOST_FIXTURE_TEST_CASE(co_writePacket_resumes_once_the_packet_is_written, WriteFixture)
+{
+    EpollScheduler scheduler;
+    uint8_t packet[4] = { 'a', 'b', 'c', 0 };
+    int result = 0;
+    writePacket(driver, scheduler, packet, 4, ros::Duration(1), result);
+    BOOST_REQUIRE_EQUAL(0, result);
+    BOOST_REQUIRE_EQUAL(1, scheduler.getWaitCount());
+
+    uint8_t buffer[4096];
+    BOOST_REQUIRE_EQUAL(4096, read(rx, buffer, sizeof(buffer)));
+    scheduler.run();
+    BOOST_REQUIRE_EQUAL(1, result);
+
+    vector<uint8_t> written = drain();
+    BOOST_REQUIRE_EQUAL(filled - 4096 + 4, written.size());
+    BOOST_REQUIRE(vector<uint8_t>(packet, packet + 4) ==
+            vector<uint8_t>(written.end() - 4, written.end()));
+}
+
+BOOST_FIXTURE_TEST_CASE(co_writePacket_times_out_if_the_stream_stays_full, WriteFixture)
+{
+    EpollScheduler scheduler;
+    uint8_t packet[4] = { 'a', 'b', 'c', 0 };
+    int result = 0;
+    writePacket(driver, scheduler, packet, 4, ros::Duration(0.01), result);
+    scheduler.run();
+    BOOST_REQUIRE_EQUAL(-1, result);
+    BOOST_REQUIRE_EQUAL(filled, drain().size());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
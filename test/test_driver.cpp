@@ -6,8 +6,15 @@
 #include <errno.h>
 #include <string.h>
 #include <ros_driver_base/driver.hpp>
+#include <ros_driver_base/timeout.hpp>
+#include <ros_driver_base/test_stream.hpp>
+#include <ros_driver_base/bus.hpp>
+#include <ros_driver_base/pty_device.hpp>
+#include <ros_driver_base/virtual_clock.hpp>
 #include <iostream>
+#include <map>
 #include <ros/time.h>
+#include <boost/thread.hpp>
 
 using namespace std;
 using namespace ros_driver_base;
@@ -53,6 +60,12 @@ void writeToDriver(Driver& driver, int tx, uint8_t const* data, int size)
     write(tx, data, size);
 }
 
+void delayedWrite(int tx, uint8_t const* data, int size, int delay_us)
+{
+    usleep(delay_us);
+    write(tx, data, size);
+}
+
 BOOST_AUTO_TEST_SUITE(FileGuardSuite)
 
 BOOST_AUTO_TEST_CASE(test_FileGuard)
@@ -125,6 +138,210 @@ BOOST_AUTO_TEST_CASE(test_rx_first_byte_timeout)
     }
 }
 
+BOOST_AUTO_TEST_CASE(test_rx_sub_millisecond_timeout)
+{
+    DriverTest test;
+    int tx = setupDriver(test);
+    FileGuard tx_guard(tx);
+
+    uint8_t buffer[100];
+    int64_t start = Deadline::now();
+    try
+    {
+        test.readPacket(buffer, 100, ros::Duration(0.0002));
+        BOOST_REQUIRE(false);
+    }
+    catch(TimeoutError const& e)
+    {
+        BOOST_REQUIRE_EQUAL(TimeoutError::PACKET, e.type);
+    }
+    BOOST_REQUIRE(Deadline::now() - start >= 200000);
+}
+
+BOOST_AUTO_TEST_CASE(test_rx_with_busy_polling)
+{
+    DriverTest test;
+    int tx = setupDriver(test);
+    FileGuard tx_guard(tx);
+
+    PollingPolicy policy;
+    policy.max_spin = ros::Duration(0.001);
+    policy.min_spin = ros::Duration(0.0001);
+    test.setPollingPolicy(policy);
+    BOOST_REQUIRE(test.getSpinBudget() == ros::Duration(0.001));
+
+    common_rx_timeout(test, tx);
+    BOOST_REQUIRE(test.getSpinBudget() == ros::Duration(0.001));
+
+    // The packet arrives well after the spin limit, so the budget falls back
+    // to the minimum
+    uint8_t msg[4] = { 0, 'a', 'b', 0 };
+    boost::thread writer(delayedWrite, tx, msg, 4, 20000);
+    uint8_t buffer[100];
+    BOOST_REQUIRE_EQUAL(4, test.readPacket(buffer, 100, 500));
+    writer.join();
+    BOOST_REQUIRE(test.getSpinBudget() == ros::Duration(0.0001));
+}
+
+void periodicWrite(int tx, uint8_t const* data, int size, int count, int period_us)
+{
+    for (int i = 0; i < count; ++i)
+        delayedWrite(tx, data, size, period_us);
+}
+
+BOOST_AUTO_TEST_CASE(test_adaptive_polling_recovers_after_a_slow_packet)
+{
+    DriverTest test;
+    int tx = setupDriver(test);
+    FileGuard tx_guard(tx);
+
+    PollingPolicy policy;
+    policy.max_spin = ros::Duration(0.001);
+    test.setPollingPolicy(policy);
+
+    uint8_t msg[4] = { 0, 'a', 'b', 0 };
+    uint8_t buffer[100];
+    boost::thread slow_writer(delayedWrite, tx, msg, 4, 20000);
+    BOOST_REQUIRE_EQUAL(4, test.readPacket(buffer, 100, 500));
+    slow_writer.join();
+    BOOST_REQUIRE(test.getSpinBudget().isZero());
+
+    // Packets now come well within the spin limit
+    boost::thread writer(periodicWrite, tx, msg, 4, 20, 200);
+    for (int i = 0; i < 20; ++i)
+        BOOST_REQUIRE_EQUAL(4, test.readPacket(buffer, 100, 500));
+    writer.join();
+    BOOST_REQUIRE(!test.getSpinBudget().isZero());
+}
+
+BOOST_AUTO_TEST_CASE(test_adaptive_polling_spins_up_to_the_limit_for_waits_just_within_it)
+{
+    DriverTest test;
+    int tx = setupDriver(test);
+    FileGuard tx_guard(tx);
+
+    PollingPolicy policy;
+    policy.max_spin = ros::Duration(0.02);
+    policy.min_spin = ros::Duration(0.0001);
+    test.setPollingPolicy(policy);
+
+    // Packets come after about 0.6 max_spin, so twice the usual wait is
+    // above the limit
+    uint8_t msg[4] = { 0, 'a', 'b', 0 };
+    uint8_t buffer[100];
+    boost::thread writer(periodicWrite, tx, msg, 4, 10, 12000);
+    for (int i = 0; i < 10; ++i)
+        BOOST_REQUIRE_EQUAL(4, test.readPacket(buffer, 100, 500));
+    writer.join();
+    BOOST_REQUIRE(test.getSpinBudget() == ros::Duration(0.02));
+}
+
+BOOST_AUTO_TEST_CASE(test_rx_syscall_accounting)
+{
+    DriverTest test;
+    int tx = setupDriver(test);
+    FileGuard tx_guard(tx);
+
+    uint8_t msg[4] = { 0, 'a', 'b', 0 };
+    uint8_t buffer[100];
+    writeToDriver(test, tx, msg, 2);
+    BOOST_REQUIRE_THROW(test.readPacket(buffer, 100, 10), TimeoutError);
+    writeToDriver(test, tx, msg + 2, 2);
+    BOOST_REQUIRE_EQUAL(4, test.readPacket(buffer, 100, 10));
+
+    Status stats = test.getStatus();
+    BOOST_REQUIRE_EQUAL(3, stats.read_calls);
+    BOOST_REQUIRE_EQUAL(1, stats.empty_reads);
+    BOOST_REQUIRE_EQUAL(1, stats.wait_calls);
+    BOOST_REQUIRE_EQUAL(0, stats.spurious_wakeups);
+    BOOST_REQUIRE_EQUAL(3, stats.extract_calls);
+    BOOST_REQUIRE_EQUAL(0, stats.write_calls);
+}
+
+void pollStatus(Driver const* driver, boost::atomic<bool>* done, int* inconsistent)
+{
+    Status status;
+    while (!done->load())
+    {
+        driver->getStatus(status);
+        if (status.good_rx != 4 * status.packet_size.getCount())
+            ++*inconsistent;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_status_can_be_read_while_reading)
+{
+    DriverTest test;
+    int tx = setupDriver(test);
+    FileGuard tx_guard(tx);
+
+    boost::atomic<bool> done(false);
+    int inconsistent = 0;
+    boost::thread monitor(pollStatus, &test, &done, &inconsistent);
+
+    uint8_t msg[4] = { 0, 'a', 'b', 0 };
+    uint8_t buffer[100];
+    for (int i = 0; i < 10000; ++i)
+    {
+        writeToDriver(test, tx, msg, 4);
+        BOOST_REQUIRE_EQUAL(4, test.readPacket(buffer, 100, 100));
+    }
+    done.store(true);
+    monitor.join();
+
+    BOOST_REQUIRE_EQUAL(0, inconsistent);
+    BOOST_REQUIRE_EQUAL(40000, test.getStatus().good_rx);
+    test.resetStatus();
+    BOOST_REQUIRE_EQUAL(0, test.getStatus().good_rx);
+    BOOST_REQUIRE_EQUAL(0, test.getStatus().packet_size.getCount());
+}
+
+/** Gives access to the read side's seqlock sequence number */
+struct SequenceDriverTest : public DriverTest
+{
+    uint32_t getReadSequence() const
+    { return m_stats.read.sequence.load(); }
+};
+
+BOOST_AUTO_TEST_CASE(test_hasPacket_and_clear_update_the_status_in_a_single_write_section)
+{
+    SequenceDriverTest test;
+    int tx = setupDriver(test);
+    FileGuard tx_guard(tx);
+
+    // The second packet stays in the internal buffer, after some garbage
+    uint8_t msg[10] = { 0, 'a', 'b', 0, 1, 2, 0, 'c', 'd', 0 };
+    writeToDriver(test, tx, msg, 10);
+    uint8_t buffer[100];
+    BOOST_REQUIRE_EQUAL(4, test.readPacket(buffer, 100, 10));
+
+    uint32_t sequence = test.getReadSequence();
+    BOOST_REQUIRE(test.hasPacket());
+    BOOST_REQUIRE_EQUAL(sequence + 2, test.getReadSequence());
+
+    test.clear();
+    BOOST_REQUIRE_EQUAL(sequence + 4, test.getReadSequence());
+    BOOST_REQUIRE_EQUAL(0, test.getStatus().queued_bytes);
+}
+
+BOOST_AUTO_TEST_CASE(test_deadline)
+{
+    VirtualClock clock(1000000000);
+    ScopedClock scoped(clock);
+
+    Deadline deadline(ros::Duration(0.0005));
+    BOOST_REQUIRE(!deadline.elapsed());
+    BOOST_REQUIRE_EQUAL(500000, deadline.timeLeft().toNSec());
+    clock.advance(ros::Duration(0.0004));
+    BOOST_REQUIRE(!deadline.elapsed());
+    BOOST_REQUIRE_EQUAL(100000, deadline.timeLeft().toNSec());
+    clock.advance(ros::Duration(0.0001));
+    BOOST_REQUIRE(deadline.elapsed());
+    BOOST_REQUIRE(deadline.timeLeft().isZero());
+    clock.advance(ros::Duration(0.001));
+    BOOST_REQUIRE(deadline.timeLeft().isZero());
+}
+
 BOOST_AUTO_TEST_CASE(test_open_sets_nonblock)
 {
     DriverTest test;
@@ -316,6 +533,23 @@ BOOST_AUTO_TEST_CASE(test_hasPacket_returns_false_on_internal_buffer_with_garbag
     BOOST_REQUIRE(!test.hasPacket());
 }
 
+BOOST_AUTO_TEST_CASE(test_parseURIOptions)
+{
+    std::map<string, string> options = Driver::parseURIOptions("low_latency=1&vmin=4&&flag");
+    BOOST_REQUIRE_EQUAL(3, options.size());
+    BOOST_REQUIRE_EQUAL("1", options["low_latency"]);
+    BOOST_REQUIRE_EQUAL("4", options["vmin"]);
+    BOOST_REQUIRE_EQUAL("", options["flag"]);
+}
+
+BOOST_AUTO_TEST_CASE(test_openURI_rejects_unknown_serial_options)
+{
+    DriverTest test;
+    BOOST_REQUIRE_THROW(test.openURI("serial:///dev/null:115200?unknown=1"), std::runtime_error);
+    BOOST_REQUIRE_THROW(test.openURI("tcp://localhost:1234?low_latency=1"), std::runtime_error);
+    BOOST_REQUIRE(!test.isValid());
+}
+
 BOOST_AUTO_TEST_CASE(test_open_bidirectional_udp)
 {
     DriverTest test;
@@ -374,4 +608,297 @@ BOOST_AUTO_TEST_CASE(test_send_from_bidirectional_udp)
     BOOST_REQUIRE((count == 4) && (memcmp(buffer, msg, count) == 0));
 }
 
+BOOST_AUTO_TEST_CASE(test_write_packets_counts_each_datagram)
+{
+    DriverTest test;
+    DriverTest peer;
+    BOOST_REQUIRE_NO_THROW(peer.openURI("udpserver://4146"));
+    BOOST_REQUIRE_NO_THROW(test.openURI("udp://127.0.0.1:4146:5156"));
+
+    uint8_t msgs[3][4] = { { 0, 'a', 'b', 0 }, { 0, 'c', 'd', 0 }, { 0, 'e', 'f', 0 } };
+    struct iovec packets[4] = {
+        { msgs[0], 4 }, { msgs[1], 0 }, { msgs[1], 4 }, { msgs[2], 4 } };
+    test.writePackets(packets, 4, ros::Duration(1));
+
+    uint8_t buffer[100];
+    for (int i = 0; i < 3; ++i)
+    {
+        BOOST_REQUIRE_EQUAL(4, peer.readPacket(buffer, 100, 500));
+        BOOST_REQUIRE( !memcmp(msgs[i], buffer, 4) );
+    }
+    Status status = test.getStatus();
+    BOOST_REQUIRE_EQUAL(3, status.write_calls);
+    BOOST_REQUIRE_EQUAL(12, status.tx);
+    BOOST_REQUIRE_EQUAL(0, status.wait_calls);
+}
+
+BOOST_AUTO_TEST_CASE(test_write_packets_uses_a_single_call_on_streams)
+{
+    DriverTest test;
+    int pipes[2];
+    BOOST_REQUIRE(pipe(pipes) == 0);
+    FileGuard rx_guard(pipes[0]);
+    test.setFileDescriptor(pipes[1], true);
+
+    uint8_t msgs[2][4] = { { 0, 'a', 'b', 0 }, { 0, 'c', 'd', 0 } };
+    struct iovec packets[2] = { { msgs[0], 4 }, { msgs[1], 4 } };
+    test.writePackets(packets, 2, ros::Duration(1));
+
+    uint8_t buffer[8];
+    BOOST_REQUIRE_EQUAL(8, read(pipes[0], buffer, 8));
+    BOOST_REQUIRE_EQUAL(1, test.getStatus().write_calls);
+}
+
+bool isReply(uint8_t const* packet, size_t size)
+{
+    return packet[1] == 'r';
+}
+
+BOOST_AUTO_TEST_CASE(test_transaction_gets_its_reply_and_other_packets_are_delivered)
+{
+    DriverTest test;
+    test.openTestMode();
+    TestStream* stream = dynamic_cast<TestStream*>(test.getMainStream());
+
+    uint8_t request[4] = { 0, 'q', 0, 0 };
+    boost::unique_future< vector<uint8_t> > reply =
+        test.startTransaction(request, 4, isReply, ros::Duration(1));
+    BOOST_REQUIRE(stream->readDataFromDriver() == vector<uint8_t>(request, request + 4));
+    BOOST_REQUIRE_EQUAL(1, test.getPendingTransactionCount());
+
+    uint8_t data[8] = { 0, 'x', 'y', 0, 0, 'r', '1', 0 };
+    stream->pushDataToDriver(vector<uint8_t>(data, data + 8));
+    uint8_t buffer[100];
+    BOOST_REQUIRE_EQUAL(4, test.readPacket(buffer, 100, 10));
+    BOOST_REQUIRE( !memcmp(data, buffer, 4) );
+    BOOST_REQUIRE_THROW(test.readPacket(buffer, 100, 10), TimeoutError);
+
+    BOOST_REQUIRE(reply.is_ready());
+    BOOST_REQUIRE(reply.get() == vector<uint8_t>(data + 4, data + 8));
+    BOOST_REQUIRE_EQUAL(0, test.getPendingTransactionCount());
+}
+
+BOOST_AUTO_TEST_CASE(test_transaction_times_out)
+{
+    DriverTest test;
+    test.openTestMode();
+    TestStream* stream = dynamic_cast<TestStream*>(test.getMainStream());
+    ScopedClock scoped(stream->getClock());
+
+    uint8_t request[4] = { 0, 'q', 0, 0 };
+    boost::unique_future< vector<uint8_t> > reply =
+        test.startTransaction(request, 4, isReply, ros::Duration(0.001));
+    stream->getClock().advance(ros::Duration(0.0005));
+    test.processTransactionTimeouts();
+    BOOST_REQUIRE(!reply.is_ready());
+    stream->getClock().advance(ros::Duration(0.0005));
+
+    uint8_t buffer[100];
+    BOOST_REQUIRE_THROW(test.readPacket(buffer, 100, 10), TimeoutError);
+    BOOST_REQUIRE(reply.is_ready());
+    BOOST_REQUIRE_THROW(reply.get(), TimeoutError);
+    BOOST_REQUIRE_EQUAL(0, test.getPendingTransactionCount());
+}
+
+BOOST_AUTO_TEST_CASE(test_try_read_packet_rejects_buffers_smaller_than_the_max_packet_size)
+{
+    DriverTest test;
+    test.openTestMode();
+    TestStream* stream = dynamic_cast<TestStream*>(test.getMainStream());
+
+    uint8_t msg[4] = { 0, 'a', 'b', 0 };
+    stream->pushDataToDriver(vector<uint8_t>(msg, msg + 4));
+    uint8_t buffer[100];
+    BOOST_REQUIRE_THROW(test.tryReadPacket(buffer, 10), length_error);
+    BOOST_REQUIRE_EQUAL(4, test.tryReadPacket(buffer, 100));
+    BOOST_REQUIRE( !memcmp(msg, buffer, 4) );
+}
+
+void ignoreReply(uint8_t const* packet, size_t size)
+{
+}
+
+void startTransactions(Driver* driver, uint8_t thread_id, int count, vector<uint64_t>* ids)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        uint8_t request[4] = { 0, 'q', thread_id, static_cast<uint8_t>(i) };
+        ids->push_back(driver->startTransaction(request, 4, isReply, ignoreReply,
+                    ros::Duration(10)));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_concurrent_transactions_are_written_in_registration_order)
+{
+    DriverTest test;
+    test.openTestMode();
+    TestStream* stream = dynamic_cast<TestStream*>(test.getMainStream());
+
+    vector<uint64_t> ids[4];
+    boost::thread_group threads;
+    for (int i = 0; i < 4; ++i)
+        threads.create_thread(boost::bind(startTransactions, &test, i, 100, &ids[i]));
+    threads.join_all();
+
+    vector<uint8_t> written = stream->readDataFromDriver();
+    BOOST_REQUIRE_EQUAL(1600, written.size());
+    BOOST_REQUIRE_EQUAL(1600, test.getStatus().tx);
+    BOOST_REQUIRE_EQUAL(400, test.getPendingTransactionCount());
+
+    // IDs are allocated in registration order
+    map< uint64_t, pair<int, int> > requests;
+    for (int thread_id = 0; thread_id < 4; ++thread_id)
+        for (int i = 0; i < 100; ++i)
+            requests[ids[thread_id][i]] = make_pair(thread_id, i);
+
+    map< uint64_t, pair<int, int> >::const_iterator it = requests.begin();
+    for (size_t i = 0; i < written.size(); i += 4, ++it)
+    {
+        BOOST_REQUIRE_EQUAL('q', written[i + 1]);
+        BOOST_REQUIRE_EQUAL(it->second.first, written[i + 2]);
+        BOOST_REQUIRE_EQUAL(it->second.second, written[i + 3]);
+    }
+}
+
+class AddressedParser : public Parser
+{
+public:
+    uint8_t address;
+    AddressedParser(Bus* bus, uint8_t address)
+        : Parser(bus), address(address) {}
+    int extractPacket(uint8_t const* buffer, size_t buffer_size) const
+    {
+        if (buffer[0] != 0)
+            return -1;
+        else if (buffer_size < 2)
+            return 0;
+        else if (buffer[1] != address)
+            return -1;
+        else if (buffer_size < 4)
+            return 0;
+        else
+            return 4;
+    }
+};
+
+BOOST_AUTO_TEST_CASE(test_pipelined_bus_routes_replies_to_their_parser)
+{
+    Bus bus(100);
+    bus.openTestMode();
+    bus.setPipelined(true);
+    TestStream* stream = dynamic_cast<TestStream*>(bus.getMainStream());
+    AddressedParser a(&bus, 'a'), b(&bus, 'b');
+    bus.addParser(&a);
+    bus.addParser(&b);
+
+    uint8_t data[8] = { 0, 'b', '1', 0, 0, 'a', '2', 0 };
+    stream->pushDataToDriver(vector<uint8_t>(data, data + 8));
+
+    uint8_t buffer[100];
+    BOOST_REQUIRE_EQUAL(4, a.readPacket(buffer, 100, 10));
+    BOOST_REQUIRE( !memcmp(data + 4, buffer, 4) );
+    BOOST_REQUIRE_EQUAL(4, b.readPacket(buffer, 100, 10));
+    BOOST_REQUIRE( !memcmp(data, buffer, 4) );
+    BOOST_REQUIRE_THROW(b.readPacket(buffer, 100, 10), TimeoutError);
+}
+
+BOOST_AUTO_TEST_CASE(test_pipelined_bus_does_not_route_through_the_last_caller)
+{
+    Bus bus(100);
+    bus.openTestMode();
+    TestStream* stream = dynamic_cast<TestStream*>(bus.getMainStream());
+    AddressedParser a(&bus, 'a'), b(&bus, 'b');
+    bus.addParser(&a);
+    bus.addParser(&b);
+
+    uint8_t reply[4] = { 0, 'a', '0', 0 };
+    stream->pushDataToDriver(vector<uint8_t>(reply, reply + 4));
+    uint8_t buffer[100];
+    BOOST_REQUIRE_EQUAL(4, a.readPacket(buffer, 100, 10));
+
+    bus.setPipelined(true);
+    uint8_t data[4] = { 0, 'b', '1', 0 };
+    stream->pushDataToDriver(vector<uint8_t>(data, data + 4));
+    BOOST_REQUIRE_EQUAL(4, b.readPacket(buffer, 100, 10));
+    BOOST_REQUIRE( !memcmp(data, buffer, 4) );
+}
+
+BOOST_AUTO_TEST_CASE(test_pipelined_bus_counts_the_packets_dropped_from_full_mailboxes)
+{
+    Bus bus(100);
+    bus.openTestMode();
+    bus.setPipelined(true);
+    bus.setMailboxSize(2);
+    TestStream* stream = dynamic_cast<TestStream*>(bus.getMainStream());
+    AddressedParser a(&bus, 'a'), b(&bus, 'b');
+    bus.addParser(&a);
+    bus.addParser(&b);
+
+    uint8_t data[16] = { 0, 'b', '1', 0, 0, 'b', '2', 0, 0, 'b', '3', 0, 0, 'a', '4', 0 };
+    stream->pushDataToDriver(vector<uint8_t>(data, data + 16));
+
+    uint8_t buffer[100];
+    BOOST_REQUIRE_EQUAL(4, a.readPacket(buffer, 100, 10));
+    BOOST_REQUIRE_EQUAL(1, bus.getDroppedRoutedPacketCount());
+    BOOST_REQUIRE_EQUAL(4, b.readPacket(buffer, 100, 10));
+    BOOST_REQUIRE( !memcmp(data + 4, buffer, 4) );
+    BOOST_REQUIRE_EQUAL(4, b.readPacket(buffer, 100, 10));
+    BOOST_REQUIRE( !memcmp(data + 8, buffer, 4) );
+    BOOST_REQUIRE_THROW(bus.setMailboxSize(0), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(test_bus_transmit_duration_follows_the_baud_rate)
+{
+    PtyDevice device;
+    Bus bus(100);
+    bus.openURI(device.getURI(9600));
+    RS485Configuration config;
+    bus.setRS485(config);
+    // 10 bits per byte at 9600 bauds
+    BOOST_REQUIRE_EQUAL(10416666, bus.getTransmitDuration(10).toNSec());
+
+    config.bits_per_byte = 11;
+    bus.setRS485(config);
+    BOOST_REQUIRE_EQUAL(11458333, bus.getTransmitDuration(10).toNSec());
+    BOOST_REQUIRE_EQUAL(0, bus.getTransmitDuration(0).toNSec());
+}
+
+/** Records the RTS changes instead of setting the line, which
+ * pseudo-terminals do not have
+ */
+struct RTSRecordingBus : public Bus
+{
+    std::vector< std::pair<bool, int64_t> > changes;
+    RTSRecordingBus() : Bus(100) {}
+    void setRTS(bool level)
+    {
+        changes.push_back(std::make_pair(level, Deadline::now()));
+    }
+};
+
+BOOST_AUTO_TEST_CASE(test_bus_holds_rts_for_the_transmit_duration)
+{
+    PtyDevice device;
+    device.start();
+    RTSRecordingBus bus;
+    bus.openURI(device.getURI(9600));
+
+    VirtualClock clock(1000000000);
+    ScopedClock scoped(clock);
+    RS485Configuration config;
+    config.direction_control = RS485Configuration::DIRECTION_RTS;
+    config.delay_before_send = ros::Duration(0.001);
+    config.delay_after_send = ros::Duration(0.002);
+    bus.setRS485(config);
+
+    uint8_t data[10] = { 0 };
+    bus.writePacket(data, 10, ros::Duration(1));
+    BOOST_REQUIRE_EQUAL(3, bus.changes.size());
+    BOOST_REQUIRE(!bus.changes[0].first);
+    BOOST_REQUIRE(bus.changes[1].first);
+    BOOST_REQUIRE_EQUAL(1000000000, bus.changes[1].second);
+    BOOST_REQUIRE(!bus.changes[2].first);
+    BOOST_REQUIRE_EQUAL(1000000000 + 1000000 + 10416666 + 2000000, bus.changes[2].second);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,107 @@
+#ifndef ROS_DRIVER_BASE_TEST_HELPERS_HPP
+#define ROS_DRIVER_BASE_TEST_HELPERS_HPP
+
+/** Drivers and fixtures shared by the Boost.Test suites */
+
+#include <boost/test/unit_test.hpp>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdexcept>
+#include <ros_driver_base/driver.hpp>
+
+/** Packets are any four bytes */
+struct FourBytesDriver : public ros_driver_base::Driver
+{
+    /** If set, the next extractPacket call throws std::runtime_error */
+    mutable bool fail_next;
+
+    FourBytesDriver() : ros_driver_base::Driver(100), fail_next(false) {}
+    int extractPacket(uint8_t const*, size_t buffer_size) const
+    {
+        if (fail_next)
+        {
+            fail_next = false;
+            throw std::runtime_error("extraction failed");
+        }
+        return buffer_size >= 4 ? 4 : 0;
+    }
+};
+
+/** Packets are four bytes starting with a zero. Other bytes are skipped */
+struct ZeroHeaderDriver : public ros_driver_base::Driver
+{
+    ZeroHeaderDriver() : ros_driver_base::Driver(100) {}
+    int extractPacket(uint8_t const* buffer, size_t buffer_size) const
+    {
+        if (buffer[0] != 0)
+            return -1;
+        else if (buffer_size < 4)
+            return 0;
+        return 4;
+    }
+};
+
+/** Packets end with a zero */
+struct ZeroTerminatedDriver : public ros_driver_base::Driver
+{
+    ZeroTerminatedDriver() : ros_driver_base::Driver(100) {}
+    int extractPacket(uint8_t const* buffer, size_t buffer_size) const
+    {
+        uint8_t const* end = static_cast<uint8_t const*>(memchr(buffer, 0, buffer_size));
+        return end ? end - buffer + 1 : 0;
+    }
+};
+
+/** Every chunk of data read is a packet */
+struct RawDriver : public ros_driver_base::Driver
+{
+    RawDriver() : ros_driver_base::Driver(100) {}
+    int extractPacket(uint8_t const*, size_t buffer_size) const
+    {
+        return buffer_size;
+    }
+};
+
+/** A driver reading from a pipe, the test writing on \c tx */
+template<typename DriverT>
+struct ReadPipeFixture
+{
+    DriverT driver;
+    int tx;
+
+    ReadPipeFixture()
+    {
+        int pipes[2];
+        BOOST_REQUIRE(pipe(pipes) == 0);
+        driver.setFileDescriptor(pipes[0], true);
+        tx = pipes[1];
+    }
+    ~ReadPipeFixture()
+    {
+        ::close(tx);
+    }
+};
+
+/** A driver writing in a pipe, the test reading from \c rx */
+template<typename DriverT>
+struct WritePipeFixture
+{
+    DriverT driver;
+    int rx;
+
+    WritePipeFixture()
+    {
+        int pipes[2];
+        BOOST_REQUIRE(pipe(pipes) == 0);
+        driver.setFileDescriptor(pipes[1], true);
+        rx = pipes[0];
+    }
+    ~WritePipeFixture()
+    {
+        ::close(rx);
+    }
+};
+
+#endif
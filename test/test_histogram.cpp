@@ -0,0 +1,109 @@
+#include <boost/test/unit_test.hpp>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <ros_driver_base/driver.hpp>
+#include "test_helpers.hpp"
+#include <ros_driver_base/histogram.hpp>
+#include <ros_driver_base/timeout.hpp>
+
+using namespace std;
+using namespace ros_driver_base;
+
+BOOST_AUTO_TEST_SUITE(HistogramSuite)
+
+BOOST_AUTO_TEST_CASE(test_empty_histogram)
+{
+    Histogram histogram;
+    BOOST_REQUIRE_EQUAL(0, histogram.getCount());
+    BOOST_REQUIRE_EQUAL(0, histogram.getMin());
+    BOOST_REQUIRE_EQUAL(0, histogram.getMax());
+    BOOST_REQUIRE_EQUAL(0, histogram.getPercentile(50));
+}
+
+BOOST_AUTO_TEST_CASE(test_small_values_are_exact)
+{
+    Histogram histogram;
+    for (int i = 1; i <= 20; ++i)
+        histogram.record(i);
+    BOOST_REQUIRE_EQUAL(20, histogram.getCount());
+    BOOST_REQUIRE_EQUAL(1, histogram.getMin());
+    BOOST_REQUIRE_EQUAL(20, histogram.getMax());
+    BOOST_REQUIRE_EQUAL(10, histogram.getPercentile(50));
+    BOOST_REQUIRE_EQUAL(19, histogram.getPercentile(95));
+    BOOST_REQUIRE_EQUAL(20, histogram.getPercentile(100));
+    BOOST_REQUIRE_CLOSE(10.5, histogram.getMean(), 1e-6);
+}
+
+BOOST_AUTO_TEST_CASE(test_percentiles_are_within_the_relative_error)
+{
+    Histogram histogram;
+    for (uint64_t i = 1; i <= 100000; ++i)
+        histogram.record(i * 1000);
+
+    double const percentiles[] = { 1, 10, 50, 90, 99, 99.9 };
+    for (int i = 0; i < 6; ++i)
+    {
+        double expected = percentiles[i] * 1000 * 1000;
+        double actual = histogram.getPercentile(percentiles[i]);
+        BOOST_REQUIRE_GE(actual, expected);
+        BOOST_REQUIRE_LE(actual, expected * (1 + 1.0 / 32));
+    }
+    BOOST_REQUIRE_EQUAL(100000000, histogram.getPercentile(100));
+}
+
+BOOST_AUTO_TEST_CASE(test_values_above_the_range_are_clamped)
+{
+    Histogram histogram(5, 10);
+    histogram.record(5000);
+    BOOST_REQUIRE_EQUAL(1023, histogram.getMax());
+    BOOST_REQUIRE_EQUAL(1023, histogram.getPercentile(100));
+}
+
+BOOST_AUTO_TEST_CASE(test_merge_and_reset)
+{
+    Histogram a, b;
+    a.record(10);
+    b.record(1000);
+    a.merge(b);
+    BOOST_REQUIRE_EQUAL(2, a.getCount());
+    BOOST_REQUIRE_EQUAL(10, a.getMin());
+    BOOST_REQUIRE_EQUAL(1000, a.getMax());
+
+    BOOST_REQUIRE_THROW(a.merge(Histogram(4)), std::invalid_argument);
+
+    a.reset();
+    BOOST_REQUIRE_EQUAL(0, a.getCount());
+    BOOST_REQUIRE_EQUAL(0, a.getPercentile(100));
+}
+
+BOOST_AUTO_TEST_CASE(test_driver_records_packet_timings)
+{
+    FourBytesDriver driver;
+    int pipes[2];
+    BOOST_REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, pipes) == 0);
+    fcntl(pipes[0], F_SETFL, fcntl(pipes[0], F_GETFL) | O_NONBLOCK);
+    driver.setFileDescriptor(pipes[0], true);
+    FileGuard tx_guard(pipes[1]);
+
+    uint8_t msg[6] = { 1, 2, 3, 4, 5, 6 };
+    BOOST_REQUIRE_EQUAL(2, write(pipes[1], msg, 2));
+    uint8_t buffer[100];
+    BOOST_REQUIRE_THROW(driver.readPacket(buffer, 100, 10), TimeoutError);
+    usleep(20000);
+    BOOST_REQUIRE_EQUAL(4, write(pipes[1], msg + 2, 4));
+    BOOST_REQUIRE_EQUAL(4, driver.readPacket(buffer, 100, 10));
+
+    Status const& stats = driver.getStats();
+    BOOST_REQUIRE_EQUAL(1, stats.packet_size.getCount());
+    BOOST_REQUIRE_EQUAL(4, stats.packet_size.getMax());
+    BOOST_REQUIRE_EQUAL(1, stats.read_wait_time.getCount());
+    BOOST_REQUIRE_EQUAL(1, stats.packet_assembly_time.getCount());
+    BOOST_REQUIRE_GE(stats.packet_assembly_time.getMax(), 30000000);
+
+    BOOST_REQUIRE(driver.writePacket(msg, 4, 100));
+    BOOST_REQUIRE_EQUAL(1, driver.getStats().write_time.getCount());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
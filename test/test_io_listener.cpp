@@ -0,0 +1,101 @@
+#include <boost/test/unit_test.hpp>
+
+#include <string.h>
+#include <ros_driver_base/io_listener.hpp>
+#include <ros_driver_base/virtual_clock.hpp>
+
+using namespace std;
+using namespace ros_driver_base;
+
+BOOST_AUTO_TEST_SUITE(RingBufferListenerSuite)
+
+string toString(RingBufferListener::View const& view)
+{
+    return string(reinterpret_cast<char const*>(view.data), view.size);
+}
+
+void push(RingBufferListener& listener, char const* data)
+{
+    listener.readData(reinterpret_cast<uint8_t const*>(data), strlen(data));
+}
+
+BOOST_AUTO_TEST_CASE(it_overwrites_the_oldest_data_and_keeps_the_view_contiguous)
+{
+    RingBufferListener listener(8);
+    push(listener, "abcde");
+    BOOST_REQUIRE_EQUAL("abcde", toString(listener.readView()));
+    push(listener, "fghij");
+    BOOST_REQUIRE_EQUAL("cdefghij", toString(listener.readView()));
+    BOOST_REQUIRE_EQUAL(2, listener.getDroppedRead());
+    push(listener, "0123456789");
+    BOOST_REQUIRE_EQUAL("23456789", toString(listener.readView()));
+    BOOST_REQUIRE_EQUAL(12, listener.getDroppedRead());
+    BOOST_REQUIRE_EQUAL(0, listener.writeView().size);
+}
+
+BOOST_AUTO_TEST_CASE(it_drops_the_newest_data_if_configured_to)
+{
+    RingBufferListener listener(8, RingBufferListener::DROP_NEWEST);
+    push(listener, "abcde");
+    push(listener, "fghij");
+    BOOST_REQUIRE_EQUAL("abcdefgh", toString(listener.readView()));
+    BOOST_REQUIRE_EQUAL(2, listener.getDroppedRead());
+    listener.clear();
+    push(listener, "k");
+    BOOST_REQUIRE_EQUAL("k", toString(listener.readView()));
+}
+
+BOOST_AUTO_TEST_CASE(it_discards_the_data_older_than_the_max_age)
+{
+    VirtualClock clock(1000000000);
+    ScopedClock scoped(clock);
+    RingBufferListener listener(8);
+    listener.setMaxAge(ros::Duration(1));
+
+    push(listener, "abc");
+    clock.advance(ros::Duration(0.6));
+    push(listener, "de");
+    BOOST_REQUIRE_EQUAL("abcde", toString(listener.readView()));
+    clock.advance(ros::Duration(0.6));
+    BOOST_REQUIRE_EQUAL("de", toString(listener.readView()));
+    push(listener, "f");
+    BOOST_REQUIRE_EQUAL("def", toString(listener.readView()));
+    clock.advance(ros::Duration(1.1));
+    BOOST_REQUIRE_EQUAL("", toString(listener.readView()));
+    BOOST_REQUIRE_EQUAL(0, listener.getDroppedRead());
+}
+
+BOOST_AUTO_TEST_CASE(expired_data_makes_room_for_new_data)
+{
+    VirtualClock clock(1000000000);
+    ScopedClock scoped(clock);
+    RingBufferListener listener(4, RingBufferListener::DROP_NEWEST);
+    listener.setMaxAge(ros::Duration(1));
+
+    push(listener, "abcd");
+    clock.advance(ros::Duration(2));
+    push(listener, "ef");
+    BOOST_REQUIRE_EQUAL("ef", toString(listener.readView()));
+    BOOST_REQUIRE_EQUAL(0, listener.getDroppedRead());
+}
+
+BOOST_AUTO_TEST_CASE(it_merges_the_oldest_stamps_when_they_do_not_fit)
+{
+    VirtualClock clock(1000000000);
+    ScopedClock scoped(clock);
+    RingBufferListener listener(8);
+    listener.setMaxAge(ros::Duration(1), 2);
+
+    push(listener, "a");
+    clock.advance(ros::Duration(0.5));
+    push(listener, "b");
+    clock.advance(ros::Duration(0.5));
+    push(listener, "c");
+    // "a" now has the time of "b"
+    clock.advance(ros::Duration(0.1));
+    BOOST_REQUIRE_EQUAL("abc", toString(listener.readView()));
+    clock.advance(ros::Duration(0.5));
+    BOOST_REQUIRE_EQUAL("c", toString(listener.readView()));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
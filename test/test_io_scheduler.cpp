@@ -0,0 +1,90 @@
+#include <boost/test/unit_test.hpp>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <ros_driver_base/driver.hpp>
+#include "test_helpers.hpp"
+#include <ros_driver_base/io_scheduler.hpp>
+#include <ros_driver_base/timeout.hpp>
+
+using namespace std;
+using namespace ros_driver_base;
+
+BOOST_AUTO_TEST_SUITE(IOSchedulerSuite)
+
+typedef ReadPipeFixture<ZeroTerminatedDriver> PipeFixture;
+
+struct RecordCall
+{
+    int* calls;
+    bool* timed_out;
+    void operator()(bool timeout) { ++*calls; *timed_out = timeout; }
+};
+
+BOOST_FIXTURE_TEST_CASE(it_calls_back_when_the_fd_is_readable, PipeFixture)
+{
+    EpollScheduler scheduler;
+    int calls = 0;
+    bool timed_out = true;
+    RecordCall callback = { &calls, &timed_out };
+    scheduler.waitFD(driver.getFileDescriptor(), IOScheduler::READ,
+            Deadline(ros::Duration(1)).toNSec(), callback);
+
+    BOOST_REQUIRE_EQUAL(0, scheduler.runOnce(ros::Duration(0)));
+    BOOST_REQUIRE_EQUAL(1, write(tx, "a", 1));
+    BOOST_REQUIRE_EQUAL(1, scheduler.runOnce(ros::Duration(1)));
+    BOOST_REQUIRE_EQUAL(1, calls);
+    BOOST_REQUIRE(!timed_out);
+    BOOST_REQUIRE_EQUAL(0, scheduler.getWaitCount());
+}
+
+BOOST_FIXTURE_TEST_CASE(it_calls_back_on_timeout, PipeFixture)
+{
+    EpollScheduler scheduler;
+    int calls = 0;
+    bool timed_out = false;
+    RecordCall callback = { &calls, &timed_out };
+    scheduler.waitFD(driver.getFileDescriptor(), IOScheduler::READ,
+            Deadline(ros::Duration(0.01)).toNSec(), callback);
+
+    scheduler.run();
+    BOOST_REQUIRE_EQUAL(1, calls);
+    BOOST_REQUIRE(timed_out);
+}
+
+struct Rearm
+{
+    EpollScheduler* scheduler;
+    int fd;
+    int* calls;
+    void operator()(bool timeout)
+    {
+        if (++*calls < 3)
+            scheduler->waitFD(fd, IOScheduler::READ, Deadline(ros::Duration(1)).toNSec(), *this);
+    }
+};
+
+BOOST_FIXTURE_TEST_CASE(it_lets_the_callback_register_the_next_wait, PipeFixture)
+{
+    EpollScheduler scheduler;
+    int calls = 0;
+    Rearm callback = { &scheduler, driver.getFileDescriptor(), &calls };
+    scheduler.waitFD(driver.getFileDescriptor(), IOScheduler::READ,
+            Deadline(ros::Duration(1)).toNSec(), callback);
+
+    BOOST_REQUIRE_EQUAL(1, write(tx, "a", 1));
+    scheduler.run();
+    BOOST_REQUIRE_EQUAL(3, calls);
+    BOOST_REQUIRE_EQUAL(0, scheduler.getWaitCount());
+
+    // The file descriptor must have left the epoll set
+    calls = 0;
+    scheduler.waitFD(driver.getFileDescriptor(), IOScheduler::READ,
+            Deadline(ros::Duration(1)).toNSec(), callback);
+    BOOST_REQUIRE_EQUAL(1, scheduler.runOnce(ros::Duration(0)));
+    BOOST_REQUIRE_EQUAL(1, calls);
+    BOOST_REQUIRE(scheduler.cancel(driver.getFileDescriptor(), IOScheduler::READ));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
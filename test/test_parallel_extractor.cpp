@@ -0,0 +1,147 @@
+#include <boost/test/unit_test.hpp>
+
+#include <stdlib.h>
+#include <ros_driver_base/driver.hpp>
+#include <ros_driver_base/exceptions.hpp>
+#include <ros_driver_base/test_stream.hpp>
+#include <ros_driver_base/capture_listener.hpp>
+#include <ros_driver_base/replay_stream.hpp>
+#include <ros_driver_base/parallel_extractor.hpp>
+
+using namespace std;
+using namespace ros_driver_base;
+
+BOOST_AUTO_TEST_SUITE(ParallelExtractorSuite)
+
+/** Packets are 0xAA, a length byte and the payload. The length byte can
+ * itself be 0xAA, which makes resynchronization non-trivial
+ */
+struct LengthPrefixedDriver : public Driver
+{
+    LengthPrefixedDriver() : Driver(64) {}
+    int extractPacket(uint8_t const* buffer, size_t buffer_size) const
+    {
+        if (buffer[0] != 0xAA)
+            return -1;
+        else if (buffer_size < 2)
+            return 0;
+        size_t packet_size = 2 + buffer[1] % 32;
+        if (buffer_size < packet_size)
+            return 0;
+        return packet_size;
+    }
+};
+
+/** Packets mixed with garbage, ending with an incomplete packet */
+static vector<uint8_t> makeData(size_t size)
+{
+    srand(42);
+    vector<uint8_t> data;
+    while (data.size() < size)
+    {
+        if (rand() % 4 == 0)
+            data.push_back(rand() % 2 ? 0xAA : rand());
+        else
+        {
+            uint8_t length = rand() % 2 ? 0xAA : rand();
+            data.push_back(0xAA);
+            data.push_back(length);
+            for (int i = 0; i < length % 32; ++i)
+                data.push_back(rand() % 3 ? 0xAA : rand());
+        }
+    }
+    data.push_back(0xAA);
+    return data;
+}
+
+/** Reads packets from the driver until it times out */
+static vector< vector<uint8_t> > readAllPackets(Driver& driver)
+{
+    vector< vector<uint8_t> > packets;
+    uint8_t buffer[64];
+    while (true)
+    {
+        try
+        {
+            int size = driver.readPacket(buffer, 64, ros::Duration(0.01));
+            packets.push_back(vector<uint8_t>(buffer, buffer + size));
+        }
+        catch (TimeoutError&) { return packets; }
+    }
+}
+
+static vector< vector<uint8_t> > getPacketData(vector<uint8_t> const& data,
+        vector<ParallelExtractor::Packet> const& packets)
+{
+    vector< vector<uint8_t> > result;
+    for (size_t i = 0; i < packets.size(); ++i)
+    {
+        uint8_t const* packet = &data[packets[i].offset];
+        result.push_back(vector<uint8_t>(packet, packet + packets[i].size));
+    }
+    return result;
+}
+
+BOOST_AUTO_TEST_CASE(it_gives_the_same_result_as_the_sequential_extraction)
+{
+    vector<uint8_t> data = makeData(100000);
+    LengthPrefixedDriver driver;
+    for (size_t threads = 1; threads < 8; ++threads)
+    {
+        ParallelExtractor extractor(driver, threads);
+        vector<ParallelExtractor::Packet> sequential =
+            extractor.extractSequential(&data[0], data.size());
+        BOOST_REQUIRE(sequential.size() > 1000);
+        BOOST_REQUIRE(sequential == extractor.extract(&data[0], data.size()));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(it_gives_the_same_packets_as_readPacket)
+{
+    vector<uint8_t> data = makeData(20000);
+    LengthPrefixedDriver driver;
+    driver.openTestMode();
+    dynamic_cast<TestStream*>(driver.getMainStream())->pushDataToDriver(data);
+    vector< vector<uint8_t> > expected = readAllPackets(driver);
+    BOOST_REQUIRE(expected.size() > 100);
+
+    ParallelExtractor extractor(driver, 4);
+    BOOST_REQUIRE(expected == getPacketData(data, extractor.extract(&data[0], data.size())));
+}
+
+BOOST_AUTO_TEST_CASE(it_extracts_the_packets_of_a_replayed_capture_in_place)
+{
+    char tmpl[] = "/tmp/ros_driver_base_extractor.XXXXXX";
+    BOOST_REQUIRE(mkdtemp(tmpl));
+    string dir = tmpl;
+
+    // Record the data in chunks of random sizes, so that packets span
+    // several chunks
+    vector<uint8_t> data = makeData(20000);
+    {
+        CaptureListener capture(dir + "/capture", 1 << 20);
+        for (size_t offset = 0; offset < data.size(); )
+        {
+            size_t size = std::min<size_t>(data.size() - offset, 1 + rand() % 100);
+            capture.readData(&data[offset], size);
+            offset += size;
+        }
+    }
+
+    LengthPrefixedDriver driver;
+    driver.openURI("replay://" + dir + "/capture.0.pcapng?speed=0");
+    vector< vector<uint8_t> > expected = readAllPackets(driver);
+    BOOST_REQUIRE(expected.size() > 100);
+
+    ReplayStream replay(dir + "/capture.0.pcapng", 0);
+    vector<struct iovec> buffers = replay.getBuffers();
+    BOOST_REQUIRE(buffers.size() > 100);
+    ParallelExtractor extractor(driver, 4);
+    vector<ParallelExtractor::Packet> packets = extractor.extract(buffers);
+    BOOST_REQUIRE(packets == extractor.extractSequential(buffers));
+    BOOST_REQUIRE(expected == getPacketData(data, packets));
+
+    BOOST_CHECK(system(("rm -rf " + dir).c_str()) == 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,55 @@
+#include <boost/test/unit_test.hpp>
+
+#include <string.h>
+#include <ros_driver_base/driver.hpp>
+#include "test_helpers.hpp"
+#include <ros_driver_base/pty_device.hpp>
+
+using namespace std;
+using namespace ros_driver_base;
+
+BOOST_AUTO_TEST_SUITE(PtyDeviceSuite)
+
+BOOST_AUTO_TEST_CASE(test_driver_receives_the_streamed_pattern)
+{
+    PtyDevice device;
+    uint8_t pattern[8] = { 0, 'a', 'b', 'c', 0, 'd', 'e', 'f' };
+    device.setStreaming(vector<uint8_t>(pattern, pattern + 8), 8000, 2);
+    device.start();
+
+    ZeroHeaderDriver driver;
+    driver.openURI(device.getURI());
+    uint8_t buffer[100];
+    for (int i = 0; i < 10; ++i)
+    {
+        BOOST_REQUIRE_EQUAL(4, driver.readPacket(buffer, 100, 1000));
+        BOOST_REQUIRE(!memcmp(buffer, pattern, 4) || !memcmp(buffer, pattern + 4, 4));
+    }
+    // The device counts the bytes after writing them, stop it to read the
+    // final count
+    device.stop();
+    BOOST_REQUIRE_GE(device.getSentBytes(), 40);
+}
+
+BOOST_AUTO_TEST_CASE(test_device_answers_requests)
+{
+    PtyDevice device;
+    uint8_t request[4] = { 0, 'q', '?', 0 };
+    uint8_t reply[4] = { 0, 'r', '!', 0 };
+    device.addReply(vector<uint8_t>(request, request + 4), vector<uint8_t>(reply, reply + 4));
+    device.start();
+
+    ZeroHeaderDriver driver;
+    driver.openURI(device.getURI());
+    uint8_t buffer[100];
+    for (int i = 0; i < 3; ++i)
+    {
+        driver.writePacket(request, 4, 1000);
+        BOOST_REQUIRE_EQUAL(4, driver.readPacket(buffer, 100, 1000));
+        BOOST_REQUIRE(!memcmp(buffer, reply, 4));
+    }
+    BOOST_REQUIRE_EQUAL(3, device.getReplyCount());
+    BOOST_REQUIRE_EQUAL(12, device.getReceivedBytes());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
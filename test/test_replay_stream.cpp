@@ -0,0 +1,101 @@
+#include <boost/test/unit_test.hpp>
+
+#include <stdlib.h>
+#include <string.h>
+#include <ros_driver_base/driver.hpp>
+#include "test_helpers.hpp"
+#include <ros_driver_base/capture_listener.hpp>
+#include <ros_driver_base/replay_stream.hpp>
+#include <ros_driver_base/timeout.hpp>
+
+using namespace std;
+using namespace ros_driver_base;
+
+BOOST_AUTO_TEST_SUITE(ReplayStreamSuite)
+
+struct CaptureFixture
+{
+    string dir;
+    string path;
+
+    CaptureFixture()
+    {
+        char tmpl[] = "/tmp/ros_driver_base_replay.XXXXXX";
+        BOOST_REQUIRE(mkdtemp(tmpl));
+        dir = tmpl;
+        path = dir + "/capture.0.pcapng";
+
+        CaptureListener capture(dir + "/capture", 1 << 20);
+        uint8_t data[3] = { 1, 2, 3 };
+        capture.readData(data, 2);
+        capture.writeData(data, 3);
+        usleep(50000);
+        capture.readData(data + 2, 1);
+    }
+    ~CaptureFixture()
+    {
+        BOOST_CHECK(system(("rm -rf " + dir).c_str()) == 0);
+    }
+};
+
+BOOST_FIXTURE_TEST_CASE(it_replays_the_read_chunks_through_a_driver, CaptureFixture)
+{
+    RawDriver driver;
+    driver.openURI("replay://" + path + "?speed=0");
+    ReplayStream* stream = dynamic_cast<ReplayStream*>(driver.getMainStream());
+    BOOST_REQUIRE(stream);
+    BOOST_REQUIRE_EQUAL(2, stream->getChunkCount());
+
+    uint8_t buffer[100];
+    BOOST_REQUIRE_EQUAL(2, driver.tryReadPacket(buffer, 100));
+    BOOST_REQUIRE_EQUAL(1, buffer[0]);
+    BOOST_REQUIRE_EQUAL(1, driver.tryReadPacket(buffer, 100));
+    BOOST_REQUIRE_EQUAL(3, buffer[0]);
+    BOOST_REQUIRE(stream->isFinished());
+    BOOST_REQUIRE_THROW(driver.readPacket(buffer, 100, ros::Duration(0.01)), TimeoutError);
+}
+
+BOOST_AUTO_TEST_CASE(it_replays_a_capture_that_was_not_closed)
+{
+    char tmpl[] = "/tmp/ros_driver_base_replay.XXXXXX";
+    BOOST_REQUIRE(mkdtemp(tmpl));
+    string dir = tmpl;
+
+    // Simulate a crash of the recording process: the file keeps its
+    // preallocated size, and the end is zeroes
+    CaptureListener capture(dir + "/capture", 1 << 20);
+    uint8_t data[3] = { 1, 2, 3 };
+    capture.readData(data, 2);
+    capture.readData(data + 2, 1);
+
+    ReplayStream stream(dir + "/capture.0.pcapng", 0);
+    BOOST_REQUIRE_EQUAL(2, stream.getChunkCount());
+
+    capture.close();
+    BOOST_CHECK(system(("rm -rf " + dir).c_str()) == 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(it_reproduces_the_capture_timing, CaptureFixture)
+{
+    RawDriver driver;
+    driver.openReplay(path, 2);
+    uint8_t buffer[100];
+    BOOST_REQUIRE_EQUAL(2, driver.readPacket(buffer, 100, ros::Duration(0.1)));
+
+    Deadline too_early(ros::Duration(0.02));
+    BOOST_REQUIRE_EQUAL(1, driver.readPacket(buffer, 100, ros::Duration(0.1)));
+    BOOST_REQUIRE(too_early.elapsed());
+}
+
+BOOST_FIXTURE_TEST_CASE(it_seeks_by_time, CaptureFixture)
+{
+    ReplayStream stream(path, 0);
+    stream.seek(stream.getEndTime());
+    BOOST_REQUIRE_EQUAL(1, stream.getPosition());
+    stream.seek(stream.getStartTime());
+    BOOST_REQUIRE_EQUAL(0, stream.getPosition());
+    stream.seek(stream.getEndTime() + ros::Duration(1));
+    BOOST_REQUIRE(stream.isFinished());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
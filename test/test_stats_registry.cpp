@@ -0,0 +1,128 @@
+#include <boost/test/unit_test.hpp>
+
+#include <unistd.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <ros_driver_base/driver.hpp>
+#include "test_helpers.hpp"
+#include <ros_driver_base/stats_registry.hpp>
+#include <ros_driver_base/test_stream.hpp>
+#include <ros_driver_base/exceptions.hpp>
+#include <boost/lexical_cast.hpp>
+
+using namespace std;
+using namespace ros_driver_base;
+
+BOOST_AUTO_TEST_SUITE(StatsRegistrySuite)
+
+static string registryName()
+{
+    return "ros_driver_base_test_" + boost::lexical_cast<string>(getpid());
+}
+
+BOOST_AUTO_TEST_CASE(test_registry_publishes_the_driver_statistics)
+{
+    RawDriver driver;
+    driver.openURI("test://");
+    TestStream* stream = dynamic_cast<TestStream*>(driver.getMainStream());
+    uint8_t data[5] = { 1, 2, 3, 4, 5 };
+    stream->pushDataToDriver(vector<uint8_t>(data, data + 5));
+    uint8_t buffer[100];
+    BOOST_REQUIRE_EQUAL(5, driver.readPacket(buffer, 100));
+
+    StatsRegistry registry(registryName(), 4);
+    registry.add(driver, "test_driver");
+
+    StatsPageReader reader(registryName());
+    BOOST_REQUIRE_EQUAL(4, reader.getHeader().slot_count);
+    BOOST_REQUIRE_EQUAL(getpid(), reader.getHeader().pid);
+    stats_page::Slot slot;
+    BOOST_REQUIRE(reader.read(0, slot));
+    BOOST_REQUIRE_EQUAL(string("test_driver"), slot.label);
+    BOOST_REQUIRE_EQUAL(5, slot.good_rx);
+    BOOST_REQUIRE_EQUAL(1, slot.packet_size.count);
+    BOOST_REQUIRE_EQUAL(5, slot.packet_size.p50);
+    BOOST_REQUIRE(!reader.read(1, slot));
+
+    stream->pushDataToDriver(vector<uint8_t>(data, data + 3));
+    BOOST_REQUIRE_EQUAL(3, driver.readPacket(buffer, 100));
+    registry.update();
+    BOOST_REQUIRE(reader.read(0, slot));
+    BOOST_REQUIRE_EQUAL(8, slot.good_rx);
+
+    registry.remove(driver);
+    BOOST_REQUIRE(!reader.read(0, slot));
+}
+
+BOOST_AUTO_TEST_CASE(test_registry_updates_the_page_periodically)
+{
+    RawDriver driver;
+    driver.openURI("test://");
+    TestStream* stream = dynamic_cast<TestStream*>(driver.getMainStream());
+
+    StatsRegistry registry(registryName(), 4, ros::Duration(0.001));
+    registry.add(driver, "test_driver");
+    registry.start();
+
+    uint8_t data[5] = { 1, 2, 3, 4, 5 };
+    stream->pushDataToDriver(vector<uint8_t>(data, data + 5));
+    uint8_t buffer[100];
+    BOOST_REQUIRE_EQUAL(5, driver.readPacket(buffer, 100));
+
+    StatsPageReader reader(registryName());
+    stats_page::Slot slot;
+    for (int i = 0; i < 1000; ++i)
+    {
+        BOOST_REQUIRE(reader.read(0, slot));
+        if (slot.good_rx == 5)
+            break;
+        usleep(1000);
+    }
+    BOOST_REQUIRE_EQUAL(5, slot.good_rx);
+    registry.stop();
+    registry.remove(driver);
+}
+
+BOOST_AUTO_TEST_CASE(test_registry_rejects_drivers_when_full)
+{
+    RawDriver a, b;
+    StatsRegistry registry(registryName(), 1);
+    registry.add(a, "a");
+    BOOST_REQUIRE_THROW(registry.add(b, "b"), std::length_error);
+}
+
+BOOST_AUTO_TEST_CASE(test_registry_does_not_take_over_a_page_in_use)
+{
+    StatsRegistry registry(registryName(), 1);
+    BOOST_REQUIRE_THROW(StatsRegistry(registryName(), 1), UnixError);
+    StatsPageReader reader(registryName());
+    BOOST_REQUIRE_EQUAL(getpid(), reader.getHeader().pid);
+}
+
+BOOST_AUTO_TEST_CASE(test_registry_replaces_the_page_of_a_dead_process)
+{
+    pid_t child = fork();
+    BOOST_REQUIRE(child != -1);
+    if (!child)
+        _exit(0);
+    BOOST_REQUIRE_EQUAL(child, waitpid(child, 0, 0));
+
+    string name = "/" + registryName();
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    BOOST_REQUIRE(fd != -1);
+    FileGuard guard(fd);
+    stats_page::Header header = stats_page::Header();
+    memcpy(header.magic, stats_page::MAGIC, sizeof(stats_page::MAGIC));
+    header.version = stats_page::VERSION;
+    header.pid = child;
+    BOOST_REQUIRE_EQUAL(sizeof(header), pwrite(fd, &header, sizeof(header), 0));
+
+    StatsRegistry registry(registryName(), 2);
+    StatsPageReader reader(registryName());
+    BOOST_REQUIRE_EQUAL(getpid(), reader.getHeader().pid);
+    BOOST_REQUIRE_EQUAL(2, reader.getHeader().slot_count);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
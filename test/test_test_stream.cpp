@@ -81,6 +81,115 @@ BOOST_FIXTURE_TEST_CASE(it_does_not_repeat_data_already_read_by_the_Driver, Fixt
     BOOST_REQUIRE(buffer == vector<uint8_t>(data + 2, data + 4));
 }
 
+BOOST_FIXTURE_TEST_CASE(it_takes_ownership_of_swapped_data, Fixture)
+{
+    uint8_t data[] = { 0, 1, 2, 3 };
+    vector<uint8_t> pushed(data, data + 4);
+    swapDataToDriver(pushed);
+    BOOST_REQUIRE(pushed.empty());
+    BOOST_REQUIRE(readPacket() == vector<uint8_t>(data, data + 4));
+}
+
+BOOST_FIXTURE_TEST_CASE(it_splits_the_data_in_fixed_fragments, Fixture)
+{
+    uint8_t data[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+    setFragmentation(TestStream::FIXED_FRAGMENTS, 3);
+    pushDataToDriver(data, data + 2);
+    pushDataToDriver(data + 2, data + 10);
+    BOOST_REQUIRE(readPacket() == vector<uint8_t>(data, data + 3));
+    BOOST_REQUIRE(readPacket() == vector<uint8_t>(data + 3, data + 6));
+    BOOST_REQUIRE(readPacket() == vector<uint8_t>(data + 6, data + 9));
+    BOOST_REQUIRE(readPacket() == vector<uint8_t>(data + 9, data + 10));
+    BOOST_REQUIRE_THROW(readPacket(), TimeoutError);
+}
+
+BOOST_FIXTURE_TEST_CASE(it_splits_the_data_in_random_fragments, Fixture)
+{
+    vector<uint8_t> data;
+    for (int i = 0; i < 1000; ++i)
+        data.push_back(i);
+    setFragmentation(TestStream::RANDOM_FRAGMENTS, 7, 42);
+    pushDataToDriver(data);
+
+    vector<uint8_t> received;
+    while (getStream()->getPendingDataSize())
+    {
+        vector<uint8_t> fragment = readPacket();
+        BOOST_REQUIRE(!fragment.empty() && fragment.size() <= 7);
+        received.insert(received.end(), fragment.begin(), fragment.end());
+    }
+    BOOST_REQUIRE(received == data);
+}
+
+BOOST_FIXTURE_TEST_CASE(it_releases_the_bytes_at_the_link_rate, Fixture)
+{
+    LinkModel link;
+    link.baud_rate = 10000;
+    link.latency = ros::Duration(0.005);
+    getStream()->setLinkModel(link);
+    VirtualClock& clock = getStream()->getClock();
+    int64_t start = clock.now();
+
+    uint8_t data[] = { 0, 1, 2, 3 };
+    pushDataToDriver(data, data + 4);
+    BOOST_REQUIRE_EQUAL(0, getStream()->getAvailableDataSize());
+    BOOST_REQUIRE_THROW(getStream()->waitRead(ros::Duration(0.001)), TimeoutError);
+    BOOST_REQUIRE_EQUAL(1000000, clock.now() - start);
+
+    getStream()->waitRead(ros::Duration(1));
+    BOOST_REQUIRE_EQUAL(6000000, clock.now() - start);
+    BOOST_REQUIRE(readPacket() == vector<uint8_t>(data, data + 1));
+    clock.advance(ros::Duration(0.002));
+    BOOST_REQUIRE(readPacket() == vector<uint8_t>(data + 1, data + 3));
+}
+
+BOOST_FIXTURE_TEST_CASE(it_times_out_on_the_first_byte_of_a_slow_link, Fixture)
+{
+    LinkModel link;
+    link.latency = ros::Duration(0.02);
+    getStream()->setLinkModel(link);
+    uint8_t data[] = { 0, 1, 2, 3 };
+    pushDataToDriver(data, data + 4);
+
+    uint8_t buffer[100];
+    try
+    {
+        driver.readPacket(buffer, 100, ros::Duration(1), ros::Duration(0.01));
+        BOOST_FAIL("readPacket did not time out");
+    }
+    catch(TimeoutError const& e)
+    {
+        BOOST_REQUIRE_EQUAL(TimeoutError::FIRST_BYTE, e.type);
+    }
+    BOOST_REQUIRE_EQUAL(4, driver.readPacket(buffer, 100, ros::Duration(1), ros::Duration(0.02)));
+}
+
+BOOST_FIXTURE_TEST_CASE(it_drops_and_corrupts_bytes_deterministically, Fixture)
+{
+    LinkModel link;
+    link.drop_rate = 0.5;
+    link.seed = 42;
+    getStream()->setLinkModel(link);
+    pushDataToDriver(vector<uint8_t>(1000, 0));
+    size_t kept = getStream()->getPendingDataSize();
+    BOOST_REQUIRE(kept > 400 && kept < 600);
+
+    getStream()->clear();
+    getStream()->setLinkModel(link);
+    pushDataToDriver(vector<uint8_t>(1000, 0));
+    BOOST_REQUIRE_EQUAL(kept, getStream()->getPendingDataSize());
+
+    getStream()->clear();
+    link.drop_rate = 0;
+    link.corruption_rate = 1;
+    getStream()->setLinkModel(link);
+    pushDataToDriver(vector<uint8_t>(10, 0));
+    vector<uint8_t> received = readPacket();
+    BOOST_REQUIRE_EQUAL(10, received.size());
+    for (size_t i = 0; i < received.size(); ++i)
+        BOOST_REQUIRE_EQUAL(1, __builtin_popcount(received[i]));
+}
+
 BOOST_FIXTURE_TEST_CASE(it_times_out_instantly, Fixture)
 {
     BOOST_REQUIRE_THROW(readPacket(), TimeoutError);
@@ -135,6 +244,123 @@ BOOST_FIXTURE_TEST_CASE(it_fails_expecation_with_data_sent_to_device, Fixture)
 
 }
 
+BOOST_FIXTURE_TEST_CASE(it_reports_the_first_bad_byte, Fixture)
+{
+    ROS_DRIVER_BASE_MOCK();
+    uint8_t exp[] = { 0, 1, 2, 3 };
+    uint8_t msg[] = { 0, 1, 4 };
+    uint8_t rep[] = { 3, 2, 1, 0 };
+    EXPECT_REPLY(vector<uint8_t>(exp, exp + 4),vector<uint8_t>(rep, rep + 4));
+    try
+    {
+        writePacket(msg, 3);
+        BOOST_FAIL("the mismatch was not reported");
+    }
+    catch(invalid_argument const& e)
+    {
+        BOOST_REQUIRE(string(e.what()).find("at byte 2") != string::npos);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(it_matches_expectations_written_in_pieces, Fixture)
+{
+    ROS_DRIVER_BASE_MOCK();
+    uint8_t exp[] = { 0, 1, 2, 3 };
+    uint8_t rep[] = { 3, 2, 1, 0 };
+    EXPECT_REPLY(vector<uint8_t>(exp, exp + 4),vector<uint8_t>(rep, rep + 4));
+    writePacket(exp, 1);
+    writePacket(exp + 1, 3);
+    BOOST_REQUIRE(readPacket() == vector<uint8_t>(rep, rep + 4));
+}
+
+BOOST_FIXTURE_TEST_CASE(it_matches_masked_expectations, Fixture)
+{
+    ROS_DRIVER_BASE_MOCK();
+    uint8_t exp[] = { 0, 1, 2, 0x30 };
+    uint8_t mask[] = { 0xFF, 0, 0xFF, 0xF0 };
+    uint8_t msg[] = { 0, 42, 2, 0x3F };
+    uint8_t rep[] = { 3, 2, 1, 0 };
+    EXPECT_REPLY(vector<uint8_t>(exp, exp + 4), vector<uint8_t>(mask, mask + 4), vector<uint8_t>(rep, rep + 4));
+    writePacket(msg, 4);
+    BOOST_REQUIRE(readPacket() == vector<uint8_t>(rep, rep + 4));
+}
+
+BOOST_FIXTURE_TEST_CASE(it_matches_unordered_expectations_in_any_order, Fixture)
+{
+    ROS_DRIVER_BASE_MOCK();
+    uint8_t exp1[] = { 1, 1 };
+    uint8_t exp2[] = { 2, 2 };
+    uint8_t exp3[] = { 1, 2 };
+    uint8_t rep[] = { 0 };
+    EXPECT_UNORDERED_REPLY(vector<uint8_t>(exp1, exp1 + 2), vector<uint8_t>(rep, rep + 1));
+    EXPECT_UNORDERED_REPLY(vector<uint8_t>(exp2, exp2 + 2), vector<uint8_t>(rep, rep + 1));
+    EXPECT_REPLY(vector<uint8_t>(exp3, exp3 + 2), vector<uint8_t>(rep, rep + 1));
+    writePacket(exp2, 2);
+    // exp3 cannot be matched before the unordered set is exhausted
+    BOOST_REQUIRE_THROW(writePacket(exp3, 2), invalid_argument);
+
+    EXPECT_UNORDERED_REPLY(vector<uint8_t>(exp1, exp1 + 2), vector<uint8_t>(rep, rep + 1));
+    EXPECT_UNORDERED_REPLY(vector<uint8_t>(exp2, exp2 + 2), vector<uint8_t>(rep, rep + 1));
+    writePacket(exp2, 2);
+    writePacket(exp1, 2);
+    BOOST_REQUIRE(getStream()->expectationsAreEmpty());
+}
+
+BOOST_FIXTURE_TEST_CASE(it_matches_expectations_sharing_a_header, Fixture)
+{
+    ROS_DRIVER_BASE_MOCK();
+    uint8_t exp_a[] = { 0xAA, 0x55, 1, 2 };
+    uint8_t exp_b[] = { 0xAA, 0x55, 0, 3 };
+    uint8_t mask_b[] = { 0xFF, 0xFF, 0, 0xFF };
+    uint8_t exp_c[] = { 0xAA, 0x55, 1 };
+    uint8_t msg_b[] = { 0xAA, 0x55, 7, 3 };
+    EXPECT_UNORDERED_REPLY(vector<uint8_t>(exp_a, exp_a + 4), vector<uint8_t>(1, 'a'));
+    EXPECT_UNORDERED_REPLY(vector<uint8_t>(exp_b, exp_b + 4), vector<uint8_t>(mask_b, mask_b + 4),
+            vector<uint8_t>(1, 'b'));
+    EXPECT_UNORDERED_REPLY(vector<uint8_t>(exp_c, exp_c + 3), vector<uint8_t>(1, 'c'));
+
+    writePacket(msg_b, 4);
+    BOOST_REQUIRE(readPacket() == vector<uint8_t>(1, 'b'));
+    writePacket(exp_c, 3);
+    BOOST_REQUIRE(readPacket() == vector<uint8_t>(1, 'c'));
+    writePacket(exp_a, 4);
+    BOOST_REQUIRE(readPacket() == vector<uint8_t>(1, 'a'));
+    BOOST_REQUIRE(getStream()->expectationsAreEmpty());
+
+    EXPECT_UNORDERED_REPLY(vector<uint8_t>(exp_a, exp_a + 4), vector<uint8_t>(1, 'a'));
+    EXPECT_UNORDERED_REPLY(vector<uint8_t>(exp_b, exp_b + 4), vector<uint8_t>(mask_b, mask_b + 4),
+            vector<uint8_t>(1, 'b'));
+    uint8_t bad[] = { 0xAA, 0x55, 1, 4 };
+    try
+    {
+        writePacket(bad, 4);
+        BOOST_FAIL("the mismatch was not reported");
+    }
+    catch(invalid_argument const& e)
+    {
+        string msg(e.what());
+        BOOST_REQUIRE(msg.find("at byte 3") != string::npos);
+        BOOST_REQUIRE(msg.find("Expected one of") != string::npos);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(it_matches_many_unordered_expectations_sharing_a_header, Fixture)
+{
+    ROS_DRIVER_BASE_MOCK();
+    int const count = 20000;
+    for (int i = 0; i < count; ++i)
+    {
+        uint8_t exp[] = { 0xAA, 0x55, static_cast<uint8_t>(i >> 8), static_cast<uint8_t>(i) };
+        EXPECT_UNORDERED_REPLY(vector<uint8_t>(exp, exp + 4), vector<uint8_t>(1, 0));
+    }
+    for (int i = count - 1; i >= 0; --i)
+    {
+        uint8_t msg[] = { 0xAA, 0x55, static_cast<uint8_t>(i >> 8), static_cast<uint8_t>(i) };
+        writePacket(msg, 4);
+    }
+    BOOST_REQUIRE(getStream()->expectationsAreEmpty());
+}
+
 BOOST_FIXTURE_TEST_CASE(it_tries_to_set_expectation_without_calling_mock_context, Fixture)
 {
     uint8_t exp[] = { 0, 1, 2, 3 };
@@ -0,0 +1,114 @@
+#include <ros_driver_base/pty_device.hpp>
+#include <iostream>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+using namespace ros_driver_base;
+using std::string;
+using std::vector;
+
+static volatile sig_atomic_t interrupted = 0;
+
+static void handleSignal(int)
+{
+    interrupted = 1;
+}
+
+static void usage()
+{
+    std::cerr << "usage: ros_driver_pty_device [--rate BYTES_PER_SECOND] [--pattern HEX]\n"
+        << "           [--chunk SIZE] [--reply REQUEST_HEX:REPLY_HEX]...\n"
+        << "  emulates a serial device on a pseudo-terminal, whose path is\n"
+        << "  printed on startup. The device streams PATTERN at the given rate,\n"
+        << "  SIZE bytes at a time, and answers each REQUEST with REPLY. Stops\n"
+        << "  on Ctrl-C" << std::endl;
+}
+
+static bool parseHex(string const& hex, vector<uint8_t>& result)
+{
+    if (hex.size() % 2)
+        return false;
+    result.clear();
+    for (size_t i = 0; i < hex.size(); i += 2)
+    {
+        char* end;
+        string byte = hex.substr(i, 2);
+        result.push_back(strtoul(byte.c_str(), &end, 16));
+        if (*end)
+            return false;
+    }
+    return true;
+}
+
+int main(int argc, char const* const* argv)
+{
+    double rate = 0;
+    size_t chunk_size = 0;
+    vector<uint8_t> pattern;
+    vector< std::pair< vector<uint8_t>, vector<uint8_t> > > replies;
+    for (int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if (arg == "--help" || i + 1 == argc)
+        {
+            usage();
+            return 1;
+        }
+
+        string value = argv[++i];
+        if (arg == "--rate")
+            rate = atof(value.c_str());
+        else if (arg == "--chunk")
+            chunk_size = atoi(value.c_str());
+        else if (arg == "--pattern" && parseHex(value, pattern))
+            ;
+        else if (arg == "--reply")
+        {
+            size_t separator = value.find(':');
+            vector<uint8_t> request, reply;
+            if (separator == string::npos || separator == 0
+                    || !parseHex(value.substr(0, separator), request)
+                    || !parseHex(value.substr(separator + 1), reply))
+            {
+                usage();
+                return 1;
+            }
+            replies.push_back(std::make_pair(request, reply));
+        }
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    try
+    {
+        PtyDevice device;
+        device.setStreaming(pattern, rate, chunk_size);
+        for (size_t i = 0; i < replies.size(); ++i)
+            device.addReply(replies[i].first, replies[i].second);
+
+        signal(SIGINT, handleSignal);
+        signal(SIGTERM, handleSignal);
+        device.start();
+        std::cout << device.getSlavePath() << "\n"
+            << device.getURI() << std::endl;
+        while (!interrupted)
+            usleep(100000);
+        device.stop();
+
+        std::cout << device.getSentBytes() << " bytes sent ("
+            << device.getDroppedBytes() << " dropped), "
+            << device.getReceivedBytes() << " bytes received, "
+            << device.getReplyCount() << " replies" << std::endl;
+    }
+    catch(std::exception const& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,120 @@
+#include <ros_driver_base/stats_registry.hpp>
+#include <iostream>
+#include <iomanip>
+#include <map>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+using namespace ros_driver_base;
+using namespace ros_driver_base::stats_page;
+using std::string;
+
+static void usage()
+{
+    std::cerr << "usage: ros_driver_stats NAME [PERIOD]\n"
+        << "  shows the statistics published by a StatsRegistry called NAME,\n"
+        << "  refreshed every PERIOD seconds (1 by default). With a PERIOD of\n"
+        << "  zero, prints the totals once" << std::endl;
+}
+
+static double rate(uint64_t current, uint64_t last, double elapsed)
+{
+    return elapsed > 0 ? (current - last) / elapsed : 0;
+}
+
+static void printTotals(Slot const& slot)
+{
+    std::cout << slot.label << "\n"
+        << "  rx " << slot.good_rx << " bytes (" << slot.bad_rx << " rejected), tx "
+        << slot.tx << " bytes, " << slot.queued_bytes << " bytes queued\n"
+        << "  " << slot.read_calls << " reads (" << slot.empty_reads << " empty), "
+        << slot.write_calls << " writes (" << slot.partial_writes << " partial), "
+        << slot.wait_calls << " waits (" << slot.spurious_wakeups << " spurious), "
+        << slot.extract_calls << " extractPacket calls\n"
+        << "  packet size p50/p99/max " << slot.packet_size.p50 << "/"
+        << slot.packet_size.p99 << "/" << slot.packet_size.max << " bytes\n"
+        << "  assembly p50/p99/max " << slot.packet_assembly_time.p50 / 1000 << "/"
+        << slot.packet_assembly_time.p99 / 1000 << "/" << slot.packet_assembly_time.max / 1000 << " us\n"
+        << "  read wait p50/p99/max " << slot.read_wait_time.p50 / 1000 << "/"
+        << slot.read_wait_time.p99 / 1000 << "/" << slot.read_wait_time.max / 1000 << " us\n"
+        << "  write p50/p99/max " << slot.write_time.p50 / 1000 << "/"
+        << slot.write_time.p99 / 1000 << "/" << slot.write_time.max / 1000 << " us\n";
+}
+
+static void printRates(Slot const& slot, Slot const& last)
+{
+    double elapsed = (slot.update_time - last.update_time) / 1e9;
+    double reads = rate(slot.read_calls, last.read_calls, elapsed);
+    double empty = rate(slot.empty_reads, last.empty_reads, elapsed);
+    std::cout << std::left << std::setw(20) << slot.label << std::right << std::fixed << std::setprecision(0)
+        << std::setw(12) << rate(slot.good_rx, last.good_rx, elapsed)
+        << std::setw(12) << rate(slot.bad_rx, last.bad_rx, elapsed)
+        << std::setw(12) << rate(slot.tx, last.tx, elapsed)
+        << std::setw(10) << reads
+        << std::setw(8) << (reads > 0 ? 100 * empty / reads : 0)
+        << std::setw(10) << rate(slot.wait_calls, last.wait_calls, elapsed)
+        << std::setw(10) << rate(slot.spurious_wakeups, last.spurious_wakeups, elapsed)
+        << std::setw(10) << slot.packet_assembly_time.p99 / 1000
+        << std::setw(10) << slot.read_wait_time.p99 / 1000
+        << "\n";
+}
+
+int main(int argc, char const* const* argv)
+{
+    if (argc < 2 || argc > 3 || !strcmp(argv[1], "--help"))
+    {
+        usage();
+        return 1;
+    }
+    double period = argc == 3 ? atof(argv[2]) : 1;
+
+    try
+    {
+        StatsPageReader reader(argv[1]);
+        size_t slot_count = reader.getHeader().slot_count;
+        std::cout << "process " << reader.getHeader().pid << ", "
+            << slot_count << " slots" << std::endl;
+
+        Slot slot;
+        if (period <= 0)
+        {
+            for (size_t i = 0; i < slot_count; ++i)
+            {
+                if (reader.read(i, slot))
+                    printTotals(slot);
+            }
+            return 0;
+        }
+
+        std::map<size_t, Slot> last;
+        while (true)
+        {
+            std::cout << "\n" << std::left << std::setw(20) << "driver" << std::right
+                << std::setw(12) << "rx B/s" << std::setw(12) << "bad B/s"
+                << std::setw(12) << "tx B/s" << std::setw(10) << "reads/s"
+                << std::setw(8) << "empty%" << std::setw(10) << "waits/s"
+                << std::setw(10) << "spur./s" << std::setw(10) << "asm p99"
+                << std::setw(10) << "wait p99" << "\n";
+            for (size_t i = 0; i < slot_count; ++i)
+            {
+                if (!reader.read(i, slot))
+                {
+                    last.erase(i);
+                    continue;
+                }
+                std::map<size_t, Slot>::iterator it = last.find(i);
+                if (it != last.end() && !strcmp(it->second.label, slot.label))
+                    printRates(slot, it->second);
+                last[i] = slot;
+            }
+            std::cout << std::flush;
+            usleep(period * 1e6);
+        }
+    }
+    catch(std::exception const& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+}